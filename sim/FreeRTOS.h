@@ -0,0 +1,29 @@
+/***
+ * Minimal FreeRTOS stand-in for the host simulator build.
+ * Only what the soft I2C core and ports touch is provided.
+ */
+#ifndef _SIM_FREERTOS_H_
+#define _SIM_FREERTOS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE              ((BaseType_t)1)
+#define pdFALSE             ((BaseType_t)0)
+#define pdPASS              pdTRUE
+#define pdFAIL              pdFALSE
+#define portMAX_DELAY       ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ  1000
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+
+void sim_enter_critical(void);
+void sim_exit_critical(void);
+
+#define portENTER_CRITICAL()    sim_enter_critical()
+#define portEXIT_CRITICAL()     sim_exit_critical()
+
+#endif /* _SIM_FREERTOS_H_ */
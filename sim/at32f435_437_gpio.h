@@ -0,0 +1,58 @@
+/***
+ * Host stand-in for the Artery GPIO header. The register layout follows
+ * AT32F435/437 so port descriptors look the same as on target; nothing is
+ * memory mapped, the simulator owns one instance per bus.
+ */
+#ifndef _SIM_AT32_GPIO_H_
+#define _SIM_AT32_GPIO_H_
+
+#include <stdint.h>
+
+typedef struct
+{
+    volatile uint32_t cfgr;
+    volatile uint32_t omode;
+    volatile uint32_t odrvr;
+    volatile uint32_t pull;
+    volatile uint32_t idt;
+    volatile uint32_t odt;
+    volatile uint32_t scr;
+    volatile uint32_t wpr;
+    volatile uint32_t muxl;
+    volatile uint32_t muxh;
+    volatile uint32_t clr;
+    volatile uint32_t reserved1[4];
+    volatile uint32_t hdrv;
+} gpio_type;
+
+#define GPIO_PINS_0     0x0001
+#define GPIO_PINS_1     0x0002
+#define GPIO_PINS_2     0x0004
+#define GPIO_PINS_3     0x0008
+#define GPIO_PINS_4     0x0010
+#define GPIO_PINS_5     0x0020
+#define GPIO_PINS_6     0x0040
+#define GPIO_PINS_7     0x0080
+#define GPIO_PINS_8     0x0100
+#define GPIO_PINS_9     0x0200
+#define GPIO_PINS_10    0x0400
+#define GPIO_PINS_11    0x0800
+#define GPIO_PINS_12    0x1000
+#define GPIO_PINS_13    0x2000
+#define GPIO_PINS_14    0x4000
+#define GPIO_PINS_15    0x8000
+
+/* Route the core's fast path register accesses through the simulator */
+#ifdef __cplusplus
+extern "C" {
+#endif
+void sim_reg_write(volatile uint32_t *reg, uint32_t val);
+uint32_t sim_reg_read(volatile uint32_t *reg);
+#ifdef __cplusplus
+}
+#endif
+
+#define SW_I2C_REG_WRITE(reg, val)  sim_reg_write((reg), (val))
+#define SW_I2C_REG_READ(reg)        sim_reg_read(reg)
+
+#endif /* _SIM_AT32_GPIO_H_ */
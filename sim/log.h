@@ -0,0 +1,15 @@
+/***
+ * Host logger matching the logE/logW/logI/logD macros used on target.
+ * Define TAG before including.
+ */
+#ifndef _SIM_LOG_H_
+#define _SIM_LOG_H_
+
+#include <stdio.h>
+
+#define logE(fmt, ...)  fprintf(stderr, "E [" TAG "] " fmt "\n", ##__VA_ARGS__)
+#define logW(fmt, ...)  fprintf(stderr, "W [" TAG "] " fmt "\n", ##__VA_ARGS__)
+#define logI(fmt, ...)  fprintf(stderr, "I [" TAG "] " fmt "\n", ##__VA_ARGS__)
+#define logD(fmt, ...)  do { } while (0)
+
+#endif /* _SIM_LOG_H_ */
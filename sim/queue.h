@@ -0,0 +1,18 @@
+/***
+ * Host stand-in for FreeRTOS queues: fixed-size copy-in/copy-out ring.
+ * Nothing blocks, a full or empty queue fails immediately.
+ */
+#ifndef _SIM_QUEUE_H_
+#define _SIM_QUEUE_H_
+
+#include "FreeRTOS.h"
+
+typedef struct sim_queue_s * QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t q);
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q);
+
+#endif /* _SIM_QUEUE_H_ */
@@ -0,0 +1,18 @@
+/***
+ * Host stand-in for FreeRTOS semaphores. The simulator is single threaded,
+ * so a take on a held semaphore fails immediately instead of blocking.
+ */
+#ifndef _SIM_SEMPHR_H_
+#define _SIM_SEMPHR_H_
+
+#include "FreeRTOS.h"
+
+typedef struct sim_sem_s * SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+
+#endif /* _SIM_SEMPHR_H_ */
@@ -0,0 +1,272 @@
+/***
+ * Soft I2C benchmark on the simulated bus.
+ *
+ * Runs every public transfer API over a range of payload sizes and reports,
+ * per call: achieved SCL frequency, effective payload bit rate, hal_io_ctl
+ * calls, fast path register accesses, requested delay time and
+ * critical sections per payload byte. Times are virtual and use the cost
+ * model in sim_bus_t.cost. Each table is run once per edge mode and speed.
+ *
+ * With "target" the controller instead talks to the core in target mode
+ * (sw_i2c_slave.c) on a sim_device_t, over a grid of bus clocks and edge
+ * interrupt latencies, and the handler's timing is reported.
+ *
+ * Usage: sw_i2c_bench [csv|target]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "sw_i2c_sim.h"
+#include "sw_i2c_prog.h"
+#include "sw_i2c_slave.h"
+
+#define BENCH_REG_ADDR      0x40
+#define BENCH_EE_ADDR       0x50
+#define BENCH_DS_ADDR       0x18
+#define BENCH_SLAVE_ADDR    0x30
+#define BENCH_SLAVE_LEN     16
+
+typedef uint8_t (*bench_fn_t)(sw_i2c_t *d, uint8_t len);
+
+static sim_bus_t bus;
+static sim_regfile_t regfile;
+static sim_eeprom_t eeprom;
+static sim_ds2482_t ds2482;
+static uint8_t ee_mem[32768];
+static uint8_t buf[256];
+static uint8_t prog_ops[SW_I2C_PROG_OPS(256, 2)];
+
+static uint8_t bench_read_8addr(sw_i2c_t *d, uint8_t len)
+{
+    return SW_I2C_Read_8addr(d, BENCH_REG_ADDR << 1, 0x00, buf, len);
+}
+
+static uint8_t bench_read_16addr(sw_i2c_t *d, uint8_t len)
+{
+    return SW_I2C_Read_16addr(d, BENCH_EE_ADDR << 1, 0x0000, buf, len);
+}
+
+static uint8_t bench_write_8addr(sw_i2c_t *d, uint8_t len)
+{
+    return SW_I2C_Write_8addr(d, BENCH_REG_ADDR << 1, 0x00, buf, len);
+}
+
+static uint8_t bench_write_16addr(sw_i2c_t *d, uint8_t len)
+{
+    uint8_t ret = SW_I2C_Write_16addr(d, BENCH_EE_ADDR << 1, 0x0000, buf, len);
+    eeprom.busy_until = 0; // measure the bus, not the write cycle
+    return ret;
+}
+
+static uint8_t bench_read_noaddr(sw_i2c_t *d, uint8_t len)
+{
+    return SW_I2C_Read_Noaddr(d, BENCH_DS_ADDR << 1, buf, len);
+}
+
+static uint8_t bench_check_addr(sw_i2c_t *d, uint8_t len)
+{
+    (void)len;
+    return SW_I2C_Check_SlaveAddr(d, BENCH_REG_ADDR << 1);
+}
+
+/* write config, read status, read data: three calls vs. one combined transfer */
+static uint8_t bench_seq_3calls(sw_i2c_t *d, uint8_t len)
+{
+    uint8_t cfg = 0x01, status;
+    return SW_I2C_Write_8addr(d, BENCH_REG_ADDR << 1, 0x20, &cfg, 1)
+        && SW_I2C_Read_8addr(d, BENCH_REG_ADDR << 1, 0x21, &status, 1)
+        && SW_I2C_Read_8addr(d, BENCH_REG_ADDR << 1, 0x00, buf, len);
+}
+
+static uint8_t bench_transfer_3seg(sw_i2c_t *d, uint8_t len)
+{
+    uint8_t cfg[2] = { 0x20, 0x01 }, st_reg = 0x21, status, data_reg = 0x00;
+    sw_i2c_msg_t msgs[] =
+    {
+        { BENCH_REG_ADDR << 1, 0, 2, cfg },
+        { BENCH_REG_ADDR << 1, SW_I2C_M_REG, 1, &st_reg },
+        { BENCH_REG_ADDR << 1, SW_I2C_M_RD, 1, &status },
+        { BENCH_REG_ADDR << 1, SW_I2C_M_REG, 1, &data_reg },
+        { BENCH_REG_ADDR << 1, SW_I2C_M_RD, len, buf },
+    };
+    return SW_I2C_Transfer(d, msgs, 5) == SW_I2C_OK;
+}
+
+/* prepared once per call; preparing costs no bus time */
+static uint8_t bench_prog_read_8addr(sw_i2c_t *d, uint8_t len)
+{
+    sw_i2c_prog_t p = { .ops = prog_ops, .cap = sizeof(prog_ops) };
+
+    if (SW_I2C_Prog_Prepare_Reg_Read(&p, d, BENCH_REG_ADDR << 1, 0x00, 1, len) != SW_I2C_OK)
+        return 0;
+    return SW_I2C_Prog_Replay(d, &p, buf) == SW_I2C_OK;
+}
+
+typedef struct
+{
+    const char *name;
+    bench_fn_t fn;
+    uint8_t sized;          /* 0: payload size does not apply */
+    uint8_t open_drain;     /* runs only with SW_I2C_FLAG_OPEN_DRAIN and the fast path */
+} bench_case_t;
+
+static const bench_case_t cases[] =
+{
+    { "Read_8addr",      bench_read_8addr,   1, 0 },
+    { "Read_16addr",     bench_read_16addr,  1, 0 },
+    { "Write_8addr",     bench_write_8addr,  1, 0 },
+    { "Write_16addr",    bench_write_16addr, 1, 0 },
+    { "Read_Noaddr",     bench_read_noaddr,  1, 0 },
+    { "Check_SlaveAddr", bench_check_addr,   0, 0 },
+    { "Seq_3calls",      bench_seq_3calls,   1, 0 },
+    { "Transfer_3seg",   bench_transfer_3seg, 1, 0 },
+    { "Prog_Read_8addr", bench_prog_read_8addr, 1, 1 },
+};
+
+static const uint8_t sizes[] = { 1, 2, 4, 8, 16, 32, 64, 128, 255 };
+
+static void bench_setup(void)
+{
+    sim_bus_init(&bus);
+    sim_regfile_init(&regfile, BENCH_REG_ADDR);
+    sim_eeprom_init(&eeprom, BENCH_EE_ADDR, ee_mem, sizeof(ee_mem), 64, 2, 5000000);
+    sim_ds2482_init(&ds2482, BENCH_DS_ADDR);
+    sim_bus_attach(&bus, &regfile.base);
+    sim_bus_attach(&bus, &eeprom.base);
+    sim_bus_attach(&bus, &ds2482.base);
+    SW_I2C_initial(&bus.i2c);
+    for (unsigned i = 0; i < sizeof(buf); i++)
+        buf[i] = (uint8_t)(i * 7 + 1);
+}
+
+typedef struct
+{
+    const char *name;
+    int fast;
+    uint32_t flags;
+    uint32_t clock_hz;      /* 0: SW_I2C_CLOCK_HZ */
+} bench_mode_t;
+
+static const bench_mode_t modes[] =
+{
+    { "hal",  0, 0, 0 },
+    { "fast", 1, 0, 0 },
+    { "od",   1, SW_I2C_FLAG_OPEN_DRAIN, 0 },
+    { "fm",   1, SW_I2C_FLAG_OPEN_DRAIN, SW_I2C_SPEED_FAST },
+    { "fm+",  1, SW_I2C_FLAG_OPEN_DRAIN, SW_I2C_SPEED_FAST_PLUS },
+};
+
+static void bench_run(const bench_mode_t *m, const bench_case_t *c, uint8_t len, int csv)
+{
+    sim_stats_t before, s;
+    unsigned payload = c->sized ? len : 1;
+    double t_us, scl_khz, kbps;
+    uint8_t ok;
+
+    before = bus.stats;
+    ok = c->fn(&bus.i2c, len);
+    sim_stats_delta(&s, &bus.stats, &before);
+
+    t_us = s.time_ns / 1000.0;
+    scl_khz = s.time_ns ? (s.scl_edges / 2.0) / (s.time_ns / 1e6) : 0;
+    kbps = (c->sized && s.time_ns) ? (len * 8.0) / (s.time_ns / 1e6) : 0;
+
+    printf(csv ? "%s,%s,%u,%d,%.2f,%.1f,%.1f,%.2f,%.2f,%.2f,%.2f,%u,%u\n"
+               : "%-4s %-16s %4u %3d %10.2f %8.1f %8.1f %8.2f %8.2f %9.2f %7.2f %6u %6u\n",
+           m->name, c->name, c->sized ? len : 0, ok, t_us, scl_khz, kbps,
+           (double)s.io_calls / payload, (double)s.reg_ops / payload,
+           s.delay_ns / 1000.0 / payload,
+           (double)s.critical / payload, s.scl_edges, s.sda_edges);
+}
+
+/* Register write then read-back through a repeated START, per clock and IRQ latency */
+static void bench_target(void)
+{
+    static const uint32_t clocks[] = { SW_I2C_SPEED_STANDARD, SW_I2C_SPEED_FAST, SW_I2C_SPEED_FAST_PLUS };
+    static const uint32_t latencies[] = { 50, 100, 200, 400, 800, 1600 };
+    static sim_device_t dev;
+    static sw_i2c_slave_t slave;
+    static uint8_t regs[256];
+    uint8_t rd[BENCH_SLAVE_LEN];
+
+    sim_device_init(&dev, &bus, &slave);
+    slave.d = &dev.i2c;
+    slave.IICID = BENCH_SLAVE_ADDR << 1;
+    slave.alen = 1;
+    slave.regs = regs;
+    slave.size = sizeof(regs);
+    SW_I2C_Slave_Init(&slave);
+
+    printf("target mode: %u-byte register write + read-back, handler %u ns + %u ns per HAL call\n\n",
+           BENCH_SLAVE_LEN, dev.isr_ns, dev.io_ns);
+    printf("%8s %6s %3s %3s %6s %8s %8s %8s %6s %5s %5s\n",
+           "clock", "irq_ns", "wr", "rd", "irq/B", "entry", "resp", "resp_avg", "merged", "ovr", "late");
+    for (unsigned c = 0; c < sizeof(clocks) / sizeof(clocks[0]); c++)
+    {
+        SW_I2C_Set_Speed(&bus.i2c, clocks[c]);
+        for (unsigned l = 0; l < sizeof(latencies) / sizeof(latencies[0]); l++)
+        {
+            sw_i2c_status_e wr, rs;
+            uint32_t ovr = slave.overruns;
+
+            dev.irq_ns = latencies[l];
+            sim_device_reset_stats(&dev);
+            SW_I2C_Slave_Clear_Status(&slave);
+            memset(rd, 0, sizeof(rd));
+            wr = SW_I2C_Write_Mem(&bus.i2c, BENCH_SLAVE_ADDR << 1, 0x00, 1, buf, BENCH_SLAVE_LEN);
+            rs = SW_I2C_Read_Mem(&bus.i2c, BENCH_SLAVE_ADDR << 1, 0x00, 1, rd, BENCH_SLAVE_LEN);
+            printf("%8u %6u %3s %3s %6.1f %8llu %8llu %8.0f %6u %5u %5u\n",
+                   (unsigned)clocks[c], dev.irq_ns, wr == SW_I2C_OK ? "ok" : "err",
+                   rs == SW_I2C_OK && memcmp(rd, buf, sizeof(rd)) == 0 ? "ok" : "err",
+                   dev.irqs / (2.0 * BENCH_SLAVE_LEN), (unsigned long long)dev.entry_max_ns,
+                   (unsigned long long)dev.resp_max_ns, dev.irqs ? (double)dev.resp_sum_ns / dev.irqs : 0.0,
+                   dev.merged, slave.overruns - ovr, dev.late);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int csv = (argc > 1 && strcmp(argv[1], "csv") == 0);
+
+    bench_setup();
+    if (argc > 1 && strcmp(argv[1], "target") == 0)
+    {
+        bench_target();
+        return 0;
+    }
+
+    if (csv)
+    {
+        printf("mode,api,len,ok,time_us,scl_khz,payload_kbps,io_per_byte,reg_per_byte,delay_us_per_byte,crit_per_byte,scl_edges,sda_edges\n");
+    }
+    else
+    {
+        printf("default SCL %u Hz, cost io %u ns dir %u ns reg %u ns delay-call %u ns\n\n",
+               (unsigned)SW_I2C_CLOCK_HZ,
+               bus.cost.io_ns, bus.cost.dir_ns, bus.cost.reg_ns, bus.cost.call_ns);
+        printf("%-4s %-16s %4s %3s %10s %8s %8s %8s %8s %9s %7s %6s %6s\n",
+               "mode", "api", "len", "ok", "time_us", "scl_kHz", "kbps", "io/B", "reg/B",
+               "delay/B", "crit/B", "scl_e", "sda_e");
+    }
+
+    for (unsigned m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+    {
+        sim_bus_use_fast(&bus, modes[m].fast);
+        bus.i2c.flags = modes[m].flags;
+        SW_I2C_Set_Speed(&bus.i2c, modes[m].clock_hz);
+        SW_I2C_Calibrate(&bus.i2c);     // the edge path changed
+        for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        {
+            if (cases[i].open_drain && !(modes[m].fast && (modes[m].flags & SW_I2C_FLAG_OPEN_DRAIN)))
+                continue;       // Prepare refuses the mode, no rows of zeros
+            for (unsigned j = 0; j < sizeof(sizes) / sizeof(sizes[0]); j++)
+            {
+                bench_run(&modes[m], &cases[i], sizes[j], csv);
+                if (!cases[i].sized)
+                    break;
+            }
+        }
+    }
+    return 0;
+}
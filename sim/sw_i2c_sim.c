@@ -0,0 +1,1012 @@
+/***
+ * Simulated open-drain bus and HAL backend for the soft I2C core
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sw_i2c_sim.h"
+#include "sw_i2c_slave.h"
+#include "semphr.h"
+#include "task.h"
+#include "queue.h"
+
+/**
+ * Decoder states
+ */
+enum
+{
+    SIM_ST_IDLE = 0,
+    SIM_ST_ADDR,        /* shifting in the address byte */
+    SIM_ST_WRITE,       /* shifting in a data byte */
+    SIM_ST_READ,        /* shifting out a data byte */
+    SIM_ST_ACK_OUT,     /* target answers the 9th clock */
+    SIM_ST_ACK_IN,      /* controller answers the 9th clock */
+    SIM_ST_IGNORE,      /* not addressed, wait for START/STOP */
+};
+
+/* Rough AT32F437 @ 288 MHz figures: indirect call + switch + BSRR store,
+ * gpio_init(), and the DWT setup done on every sw_i2c_port_delay_us() */
+#define SIM_DEFAULT_IO_NS       35
+#define SIM_DEFAULT_DIR_NS      250
+#define SIM_DEFAULT_CALL_NS     140
+#define SIM_DEFAULT_REG_NS      10
+
+/* Target mode device: EXINT entry plus flag read/clear in the handler,
+ * and the handler's own bookkeeping per run; its HAL calls cost io_ns */
+#define SIM_DEFAULT_IRQ_NS      100
+#define SIM_DEFAULT_ISR_NS      60
+
+static uint64_t sim_time;
+static sim_bus_t *sim_current;
+static sim_bus_t *sim_buses;
+
+/**
+ * Host environment stubs
+ */
+
+struct sim_sem_s
+{
+    int count;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t sem = calloc(1, sizeof(*sem));
+    if (sem)
+        sem->count = 1;
+    return sem;
+}
+
+/* Created empty, like FreeRTOS */
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return calloc(1, sizeof(struct sim_sem_s));
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    free(sem);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    (void)ticks;
+    if (sem == NULL || sem->count == 0)
+        return pdFALSE;
+    sem->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    if (sem == NULL || sem->count != 0)
+        return pdFALSE;
+    sem->count++;
+    return pdTRUE;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    sim_advance_ns((uint64_t)ticks * (1000000000ULL / configTICK_RATE_HZ));
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(sim_time / (1000000000ULL / configTICK_RATE_HZ));
+}
+
+struct sim_task_s
+{
+    TaskFunction_t fn;
+    void *arg;
+    UBaseType_t prio;
+    uint32_t notified;
+};
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_words,
+                       void *arg, UBaseType_t prio, TaskHandle_t *handle)
+{
+    TaskHandle_t t = calloc(1, sizeof(*t));
+    (void)name;
+    (void)stack_words;
+    if (t == NULL)
+        return pdFAIL;
+    t->fn = fn;
+    t->arg = arg;
+    t->prio = prio;
+    if (handle)
+        *handle = t;
+    return pdPASS;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    if (task == NULL)
+        return pdFAIL;
+    switch (action)
+    {
+    case eSetBits:
+        task->notified |= value;
+        break;
+    case eIncrement:
+        task->notified++;
+        break;
+    case eSetValueWithOverwrite:
+    case eSetValueWithoutOverwrite:
+        task->notified = value;
+        break;
+    default:
+        break;
+    }
+    return pdPASS;
+}
+
+uint32_t sim_task_notified_value(TaskHandle_t task)
+{
+    return task ? task->notified : 0;
+}
+
+struct sim_queue_s
+{
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    uint8_t data[];
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    QueueHandle_t q = calloc(1, sizeof(*q) + length * item_size);
+    if (q)
+    {
+        q->length = length;
+        q->item_size = item_size;
+    }
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    free(q);
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    (void)ticks;
+    if (q == NULL || q->count == q->length)
+        return pdFALSE;
+    memcpy(&q->data[((q->head + q->count) % q->length) * q->item_size], item, q->item_size);
+    q->count++;
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    (void)ticks;
+    if (q == NULL || q->count == 0)
+        return pdFALSE;
+    memcpy(item, &q->data[q->head * q->item_size], q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    return q ? q->count : 0;
+}
+
+void sim_enter_critical(void)
+{
+    if (sim_current)
+        sim_current->stats.critical++;
+}
+
+void sim_exit_critical(void)
+{
+}
+
+/**
+ * Time
+ */
+
+uint64_t sim_now_ns(void)
+{
+    return sim_time;
+}
+
+static void sim_eval(sim_bus_t *b);
+
+static void sim_release_stretch(void)
+{
+    sim_bus_t *b;
+
+    for (b = sim_buses; b; b = b->next)
+    {
+        if (!b->t_scl && sim_time >= b->stretch_until)
+        {
+            b->t_scl = 1;
+            sim_eval(b);
+        }
+    }
+}
+
+/* Device whose edge handler is due first, by end at the latest */
+static sim_device_t * sim_next_irq(uint64_t end, uint64_t *at)
+{
+    sim_device_t *best = NULL;
+    sim_bus_t *b;
+    uint64_t t;
+
+    for (b = sim_buses; b; b = b->next)
+    {
+        if (b->dev == NULL || !b->dev->irq_on || !b->dev->pending)
+            continue;
+        t = b->dev->edge_at + b->dev->irq_ns;
+        if (t < b->dev->busy_until)
+            t = b->dev->busy_until;
+        if (t <= end && (best == NULL || t < *at))
+        {
+            best = b->dev;
+            *at = t;
+        }
+    }
+    return best;
+}
+
+/* One handler run: flags taken and cleared at entry, HAL calls cost time */
+static void sim_device_run(sim_device_t *v, uint64_t end)
+{
+    uint32_t pending = v->pending;
+    uint64_t edge = v->edge_at;
+
+    v->pending = 0;
+    if (sim_time - edge > v->entry_max_ns)
+        v->entry_max_ns = sim_time - edge;
+    sim_time += v->isr_ns;
+    SW_I2C_Slave_Irq(v->slave, pending);
+    v->busy_until = sim_time;
+    v->irqs++;
+    v->resp_sum_ns += sim_time - edge;
+    if (sim_time - edge > v->resp_max_ns)
+        v->resp_max_ns = sim_time - edge;
+    if (sim_time > end)
+        v->late++;
+}
+
+/**
+ * Move time on. Edge handlers of target mode devices that fall due on the
+ * way run at their own time; the caller's wait still ends at now + ns
+ * unless a handler run lasts past it.
+ */
+void sim_advance_ns(uint64_t ns)
+{
+    uint64_t end = sim_time + ns, at = 0;
+    sim_device_t *v;
+
+    if (sim_current)
+        sim_current->stats.time_ns += ns;
+    while ((v = sim_next_irq(end, &at)) != NULL)
+    {
+        if (at > sim_time)
+        {
+            sim_time = at;
+            sim_release_stretch();
+        }
+        sim_device_run(v, end);
+    }
+    if (sim_time < end)
+        sim_time = end;
+    sim_release_stretch();
+}
+
+/**
+ * Decoder
+ */
+
+static sim_target_t * sim_find_target(sim_bus_t *b, uint8_t addr7)
+{
+    sim_target_t *t;
+    for (t = b->targets; t; t = t->next)
+    {
+        if (t->addr == addr7)
+            return t;
+    }
+    return NULL;
+}
+
+void sim_stats_delta(sim_stats_t *out, const sim_stats_t *now, const sim_stats_t *mark)
+{
+    out->time_ns = now->time_ns - mark->time_ns;
+    out->delay_ns = now->delay_ns - mark->delay_ns;
+    out->delay_calls = now->delay_calls - mark->delay_calls;
+    out->io_calls = now->io_calls - mark->io_calls;
+    out->reg_ops = now->reg_ops - mark->reg_ops;
+    out->dir_switches = now->dir_switches - mark->dir_switches;
+    out->critical = now->critical - mark->critical;
+    out->scl_edges = now->scl_edges - mark->scl_edges;
+    out->sda_edges = now->sda_edges - mark->sda_edges;
+    out->starts = now->starts - mark->starts;
+    out->stops = now->stops - mark->stops;
+    out->bytes = now->bytes - mark->bytes;
+    out->acks = now->acks - mark->acks;
+    out->stretches = now->stretches - mark->stretches;
+}
+
+static void sim_load_tx(sim_bus_t *b)
+{
+    b->tx = b->active->ops->read(b->active);
+    b->active->rcount++;
+    b->bit = 0;
+    b->t_sda = (b->tx >> 7) & 1;
+    b->state = SIM_ST_READ;
+}
+
+/* Shortest phase times, fed from the line transitions */
+static void sim_timing_min(uint32_t *min, uint64_t from)
+{
+    uint64_t ns = sim_time - from;
+
+    if (from && ns < *min)
+        *min = (uint32_t)ns;
+}
+
+static void sim_timing_reset(sim_bus_t *b)
+{
+    memset(&b->tmin, 0xFF, sizeof(b->tmin));
+    b->scl_rise_at = b->scl_fall_at = b->start_at = b->stop_at = 0;
+    b->hd_sta_open = 0;
+}
+
+static void sim_on_start(sim_bus_t *b)
+{
+    b->stats.starts++;
+    if (b->in_xfer)
+        sim_timing_min(&b->tmin.su_sta_ns, b->scl_rise_at);
+    else
+        sim_timing_min(&b->tmin.buf_ns, b->stop_at);
+    b->start_at = sim_time;
+    b->hd_sta_open = 1;
+    if (!b->in_xfer)
+    {
+        b->xfer_mark = b->stats;
+        b->in_xfer = 1;
+    }
+    b->state = SIM_ST_ADDR;
+    b->bit = 0;
+    b->shift = 0;
+    b->t_sda = 1;
+}
+
+static void sim_on_stop(sim_bus_t *b)
+{
+    b->stats.stops++;
+    sim_timing_min(&b->tmin.su_sto_ns, b->scl_rise_at);
+    b->stop_at = sim_time;
+    if (b->active && b->active->ops->stop)
+        b->active->ops->stop(b->active);
+    b->active = NULL;
+    b->state = SIM_ST_IDLE;
+    b->t_sda = 1;
+    if (b->in_xfer)
+    {
+        sim_stats_delta(&b->last_xfer, &b->stats, &b->xfer_mark);
+        b->xfers++;
+        b->in_xfer = 0;
+    }
+}
+
+static void sim_on_scl_rise(sim_bus_t *b)
+{
+    sim_target_t *t;
+
+    switch (b->state)
+    {
+    case SIM_ST_ADDR:
+    case SIM_ST_WRITE:
+        b->shift = (uint8_t)((b->shift << 1) | b->sda);
+        if (++b->bit < 8)
+            break;
+        b->stats.bytes++;
+        b->ack = 0;
+        b->listen = 0;
+        if (b->state == SIM_ST_ADDR)
+        {
+            b->rw = b->shift & I2C_READ;
+            b->active = NULL;
+            t = sim_find_target(b, b->shift >> 1);
+            if (t && t->nack_addr > 0)
+            {
+                t->nack_addr--;
+            }
+            else if (t && t->ops->start(t, b->rw))
+            {
+                t->wcount = 0;
+                t->rcount = 0;
+                b->active = t;
+                b->ack = 1;
+            }
+        }
+        else if (b->active)
+        {
+            t = b->active;
+            if (t->nack_write_at < 0 || (uint32_t)t->nack_write_at != t->wcount)
+                b->ack = t->ops->write(t, b->shift) ? 1 : 0;
+            else
+                b->listen = 1;
+            t->wcount++;
+        }
+        b->state = SIM_ST_ACK_OUT;
+        b->phase = 0;
+        break;
+    case SIM_ST_ACK_OUT:
+        if (b->ack)
+            b->stats.acks++;
+        break;
+    case SIM_ST_READ:
+        b->bit++;
+        break;
+    case SIM_ST_ACK_IN:
+        b->ack = !b->sda;
+        b->stats.bytes++;
+        if (b->ack)
+            b->stats.acks++;
+        break;
+    default:
+        break;
+    }
+}
+
+/* The active target holds SCL low after the 9th clock if scripted to */
+static void sim_stretch(sim_bus_t *b)
+{
+    if (b->active == NULL || b->active->stretch_ns == 0)
+        return;
+    b->t_scl = 0;
+    b->stretch_until = sim_time + b->active->stretch_ns;
+    b->stats.stretches++;
+}
+
+static void sim_on_scl_fall(sim_bus_t *b)
+{
+    switch (b->state)
+    {
+    case SIM_ST_ACK_OUT:
+        if (b->phase == 0)
+        {
+            b->t_sda = b->ack ? 0 : 1;
+            b->phase = 1;
+            break;
+        }
+        b->t_sda = 1;
+        if ((!b->ack && !b->listen) || b->active == NULL)
+        {
+            b->state = SIM_ST_IGNORE;
+            break;
+        }
+        if (b->listen)
+        {
+            b->state = SIM_ST_WRITE;
+            b->bit = 0;
+            b->shift = 0;
+            break;
+        }
+        sim_stretch(b);
+        if (b->rw)
+        {
+            sim_load_tx(b);
+        }
+        else
+        {
+            b->state = SIM_ST_WRITE;
+            b->bit = 0;
+            b->shift = 0;
+        }
+        break;
+    case SIM_ST_READ:
+        if (b->bit < 8)
+        {
+            b->t_sda = (b->tx >> (7 - b->bit)) & 1;
+        }
+        else
+        {
+            b->t_sda = 1;
+            b->state = SIM_ST_ACK_IN;
+        }
+        break;
+    case SIM_ST_ACK_IN:
+        if (b->ack)
+        {
+            sim_stretch(b);
+            sim_load_tx(b);
+        }
+        else
+            b->state = SIM_ST_IGNORE;
+        break;
+    default:
+        break;
+    }
+}
+
+/* Mirror this bus' lines into its GPIO block so reads of idt/odt see them */
+static void sim_sync_regs(sim_bus_t *b)
+{
+    gpio_type *p = b->i2c.scl_port;
+    uint32_t pins = b->i2c.scl_pin | b->i2c.sda_pin;
+
+    p->idt = (p->idt & ~pins) | (b->scl ? b->i2c.scl_pin : 0) | (b->sda ? b->i2c.sda_pin : 0);
+    p->odt = (p->odt & ~pins) | (b->scl_latch ? b->i2c.scl_pin : 0) | (b->sda_latch ? b->i2c.sda_pin : 0);
+}
+
+/* EXINT flag of a line; an edge on a line still flagged is lost */
+static void sim_device_edge(sim_device_t *v, uint32_t pin)
+{
+    if (!v->irq_on)
+        return;
+    if (v->pending & pin)
+    {
+        v->merged++;
+        return;
+    }
+    if (!v->pending)
+        v->edge_at = sim_time;
+    v->pending |= pin;
+}
+
+/**
+ * Resolve wired-AND levels and feed every transition to the decoder until
+ * the lines settle (a target may answer an SCL edge by moving SDA).
+ */
+static void sim_eval(sim_bus_t *b)
+{
+    uint8_t scl, sda;
+
+    for (;;)
+    {
+        scl = (b->scl_output ? b->scl_latch : 1) & b->t_scl & (b->dev ? b->dev->scl_latch : 1);
+        if (scl != b->scl)
+        {
+            b->scl = scl;
+            b->stats.scl_edges++;
+            if (b->dev)
+                sim_device_edge(b->dev, b->i2c.scl_pin);
+            if (b->in_xfer && scl)
+                sim_timing_min(&b->tmin.low_ns, b->scl_fall_at);
+            else if (b->in_xfer)
+                sim_timing_min(&b->tmin.high_ns, b->scl_rise_at);
+            if (!scl && b->hd_sta_open)
+            {
+                sim_timing_min(&b->tmin.hd_sta_ns, b->start_at);
+                b->hd_sta_open = 0;
+            }
+            if (scl)
+                b->scl_rise_at = sim_time;
+            else
+                b->scl_fall_at = sim_time;
+            if (scl)
+                sim_on_scl_rise(b);
+            else
+                sim_on_scl_fall(b);
+            continue;
+        }
+        sda = (b->sda_output ? b->sda_latch : 1) & b->t_sda & (b->dev ? b->dev->sda_latch : 1);
+        if (sda != b->sda)
+        {
+            b->sda = sda;
+            b->stats.sda_edges++;
+            if (b->dev)
+                sim_device_edge(b->dev, b->i2c.sda_pin);
+            if (b->scl)
+            {
+                if (sda)
+                    sim_on_stop(b);
+                else
+                    sim_on_start(b);
+            }
+            continue;
+        }
+        break;
+    }
+    sim_sync_regs(b);
+}
+
+/**
+ * HAL backend
+ */
+
+static int sim_hal_init(void * slot)
+{
+    sim_bus_t *b = slot;
+    b->scl_latch = b->sda_latch = 1;
+    b->scl_output = b->sda_output = 1;
+    sim_eval(b);
+    if (b->i2c.i2c_sem == NULL)
+        b->i2c.i2c_sem = xSemaphoreCreateMutex();
+    xSemaphoreGive(b->i2c.i2c_sem);
+    return 0;
+}
+
+static int sim_hal_deinit(void * slot)
+{
+    sim_bus_t *b = slot;
+    b->scl_output = b->sda_output = 0;
+    sim_eval(b);
+    if (b->i2c.i2c_sem != NULL)
+        vSemaphoreDelete(b->i2c.i2c_sem);
+    b->i2c.i2c_sem = NULL;
+    return 0;
+}
+
+static int sim_hal_io_ctl(hal_io_opt_e opt, void * slot)
+{
+    sim_bus_t *b = slot;
+    uint32_t cost = b->cost.io_ns;
+    int ret = -1;
+
+    sim_current = b;
+    b->stats.io_calls++;
+    switch (opt)
+    {
+    case HAL_IO_OPT_SET_SDA_LOW:
+        b->sda_latch = 0;
+        break;
+    case HAL_IO_OPT_SET_SDA_HIGH:
+        b->sda_latch = 1;
+        break;
+    case HAL_IO_OPT_SET_SCL_LOW:
+        b->scl_latch = 0;
+        break;
+    case HAL_IO_OPT_SET_SCL_HIGH:
+        b->scl_latch = 1;
+        break;
+    case HAL_IO_OPT_SET_SDA_INPUT:
+        b->sda_output = 0;
+        b->stats.dir_switches++;
+        cost = b->cost.dir_ns;
+        break;
+    case HAL_IO_OPT_SET_SDA_OUTPUT:
+        b->sda_latch = 1; // same as the AT32 port: release before switching
+        b->sda_output = 1;
+        b->stats.dir_switches++;
+        cost = b->cost.dir_ns;
+        break;
+    case HAL_IO_OPT_SET_SCL_INPUT:
+        b->scl_output = 0;
+        b->stats.dir_switches++;
+        cost = b->cost.dir_ns;
+        break;
+    case HAL_IO_OPT_SET_SCL_OUTPUT:
+        b->scl_latch = 1;
+        b->scl_output = 1;
+        b->stats.dir_switches++;
+        cost = b->cost.dir_ns;
+        break;
+    case HAL_IO_OPT_GET_SDA_LEVEL:
+        ret = b->sda;
+        break;
+    case HAL_IO_OPT_GET_SCL_LEVEL:
+        ret = b->scl;
+        break;
+    case HAL_IO_OPT_IS_LINE_BUSY:
+        ret = !(b->scl && b->sda);
+        break;
+    default:
+        break;
+    }
+    sim_eval(b);
+    sim_advance_ns(cost);
+    return ret;
+}
+
+static void sim_hal_delay_ns(uint32_t ns)
+{
+    if (sim_current)
+    {
+        sim_current->stats.delay_ns += ns;
+        sim_current->stats.delay_calls++;
+        sim_advance_ns((uint64_t)ns + sim_current->cost.call_ns);
+    }
+    else
+    {
+        sim_advance_ns(ns);
+    }
+}
+
+static void sim_hal_delay_us(uint32_t us)
+{
+    sim_hal_delay_ns(us * 1000);
+}
+
+/* Statistics counter: virtual nanoseconds, wraps like CYCCNT */
+static uint32_t sim_hal_cycles(void)
+{
+    return (uint32_t)sim_time;
+}
+
+/**
+ * HAL of a target mode device: open-drain latches joined into the bus
+ */
+
+static int sim_dev_hal_init(void * slot)
+{
+    sim_device_t *v = slot;
+    v->scl_latch = v->sda_latch = 1;
+    sim_eval(v->bus);
+    return 0;
+}
+
+static int sim_dev_hal_deinit(void * slot)
+{
+    return sim_dev_hal_init(slot);
+}
+
+static int sim_dev_hal_io_ctl(hal_io_opt_e opt, void * slot)
+{
+    sim_device_t *v = slot;
+    int ret = -1;
+
+    switch (opt)
+    {
+    case HAL_IO_OPT_SET_SDA_LOW:
+        v->sda_latch = 0;
+        break;
+    case HAL_IO_OPT_SET_SDA_HIGH:
+    case HAL_IO_OPT_SET_SDA_INPUT:
+    case HAL_IO_OPT_SET_SDA_OUTPUT:
+        v->sda_latch = 1;
+        break;
+    case HAL_IO_OPT_SET_SCL_LOW:
+        v->scl_latch = 0;
+        break;
+    case HAL_IO_OPT_SET_SCL_HIGH:
+    case HAL_IO_OPT_SET_SCL_INPUT:
+    case HAL_IO_OPT_SET_SCL_OUTPUT:
+        v->scl_latch = 1;
+        break;
+    case HAL_IO_OPT_GET_SDA_LEVEL:
+        ret = v->bus->sda;
+        break;
+    case HAL_IO_OPT_GET_SCL_LEVEL:
+        ret = v->bus->scl;
+        break;
+    case HAL_IO_OPT_IS_LINE_BUSY:
+        ret = !(v->bus->scl && v->bus->sda);
+        break;
+    default:
+        break;
+    }
+    sim_eval(v->bus);
+    sim_time += v->io_ns;   // inside a handler run, see sim_device_run
+    return ret;
+}
+
+static int sim_dev_hal_edge_irq(void * slot, uint8_t on)
+{
+    sim_device_t *v = slot;
+    v->irq_on = on;
+    v->pending = 0;
+    return 0;
+}
+
+/**
+ * Register hooks behind SW_I2C_REG_WRITE/SW_I2C_REG_READ on the host build.
+ * A store to scr/clr/odt of a simulated GPIO block moves the latches of
+ * every bus with pins in the mask, so buses sharing a block stay coherent.
+ */
+
+void sim_reg_write(volatile uint32_t *reg, uint32_t val)
+{
+    sim_bus_t *b;
+    gpio_type *p;
+    uint32_t set, clr, pins;
+    int hit = 0;
+
+    for (b = sim_buses; b; b = b->next)
+    {
+        p = b->i2c.scl_port;
+        if (reg == &p->scr)
+        {
+            set = val & 0xFFFF;
+            clr = val >> 16;
+        }
+        else if (reg == &p->clr)
+        {
+            set = 0;
+            clr = val & 0xFFFF;
+        }
+        else if (reg == &p->odt)
+        {
+            set = val;
+            clr = ~val;
+        }
+        else
+        {
+            continue;
+        }
+        pins = b->i2c.scl_pin | b->i2c.sda_pin;
+        if (((set | clr) & pins) == 0)
+            continue;
+        if (set & b->i2c.scl_pin)
+            b->scl_latch = 1;
+        if (clr & b->i2c.scl_pin)
+            b->scl_latch = 0;
+        if (set & b->i2c.sda_pin)
+            b->sda_latch = 1;
+        if (clr & b->i2c.sda_pin)
+            b->sda_latch = 0;
+        sim_current = b;
+        b->stats.reg_ops++;
+        sim_eval(b);
+        hit = 1;
+    }
+    if (hit)
+        sim_advance_ns(sim_current->cost.reg_ns);
+    else
+        *reg = val;
+}
+
+uint32_t sim_reg_read(volatile uint32_t *reg)
+{
+    sim_bus_t *b;
+
+    for (b = sim_buses; b; b = b->next)
+    {
+        if (reg == &b->i2c.scl_port->idt || reg == &b->i2c.scl_port->odt)
+        {
+            if (sim_current == NULL || sim_current->i2c.scl_port != b->i2c.scl_port)
+                sim_current = b;
+            sim_current->stats.reg_ops++;
+            sim_advance_ns(sim_current->cost.reg_ns);
+            break;
+        }
+    }
+    return *reg;
+}
+
+/**
+ * Public
+ */
+
+/**
+ * @brief Prepare a simulated bus with idle lines and no targets.
+ *
+ * SCL sits on pin 0 and SDA on pin 1 of the bus' private GPIO block.
+ * Call SW_I2C_initial(&b->i2c) afterwards as on target.
+ */
+void sim_bus_init(sim_bus_t *b)
+{
+    sim_bus_t **pp;
+
+    for (pp = &sim_buses; *pp; pp = &(*pp)->next)
+    {
+        if (*pp == b)
+        {
+            *pp = b->next;
+            break;
+        }
+    }
+    memset(b, 0, sizeof(*b));
+    sim_timing_reset(b);
+    b->next = sim_buses;
+    sim_buses = b;
+    b->i2c.hal_init = sim_hal_init;
+    b->i2c.hal_deinit = sim_hal_deinit;
+    b->i2c.hal_io_ctl = sim_hal_io_ctl;
+    b->i2c.hal_delay_us = sim_hal_delay_us;
+    b->i2c.hal_delay_ns = sim_hal_delay_ns;
+    b->i2c.hal_cycles = sim_hal_cycles;
+    b->i2c.scl_port = &b->gpio;
+    b->i2c.sda_port = &b->gpio;
+    b->i2c.scl_pin = GPIO_PINS_0;
+    b->i2c.sda_pin = GPIO_PINS_1;
+    b->cost.io_ns = SIM_DEFAULT_IO_NS;
+    b->cost.dir_ns = SIM_DEFAULT_DIR_NS;
+    b->cost.call_ns = SIM_DEFAULT_CALL_NS;
+    b->cost.reg_ns = SIM_DEFAULT_REG_NS;
+    b->scl_latch = b->sda_latch = 1;
+    b->t_scl = b->t_sda = 1;
+    b->scl = b->sda = 1;
+    sim_eval(b);
+}
+
+/**
+ * @brief Switch the bus between hal_io_ctl edges and the register fast path.
+ */
+void sim_bus_use_fast(sim_bus_t *b, int on)
+{
+    gpio_type *scl = b->i2c.scl_port;
+    gpio_type *sda = b->i2c.sda_port;
+
+    memset(&b->i2c.fast, 0, sizeof(b->i2c.fast));
+    if (!on)
+        return;
+    b->i2c.fast.scl_set = &scl->scr;
+    b->i2c.fast.scl_clr = &scl->clr;
+    b->i2c.fast.scl_in = &scl->idt;
+    b->i2c.fast.sda_set = &sda->scr;
+    b->i2c.fast.sda_clr = &sda->clr;
+    b->i2c.fast.sda_in = &sda->idt;
+    b->i2c.fast.scl_mask = b->i2c.scl_pin;
+    b->i2c.fast.sda_mask = b->i2c.sda_pin;
+}
+
+/**
+ * @brief Move the bus' lines to other pins, e.g. onto a block shared with
+ * other buses. A pin used as SCL by several buses is one shared line.
+ */
+void sim_bus_place(sim_bus_t *b, gpio_type *port, uint32_t scl_pin, uint32_t sda_pin)
+{
+    int fast = b->i2c.fast.scl_set != NULL;
+
+    b->i2c.scl_port = port;
+    b->i2c.sda_port = port;
+    b->i2c.scl_pin = scl_pin;
+    b->i2c.sda_pin = sda_pin;
+    sim_bus_use_fast(b, fast);
+    sim_eval(b);
+}
+
+/**
+ * @brief Forget every bus, e.g. between independent tests. Virtual time
+ * keeps running.
+ */
+void sim_reset(void)
+{
+    sim_buses = NULL;
+    sim_current = NULL;
+}
+
+void sim_bus_attach(sim_bus_t *b, sim_target_t *t)
+{
+    t->next = b->targets;
+    b->targets = t;
+}
+
+/**
+ * @brief Put a target mode device on the bus' lines. Fill in the target
+ * with s->d = &v->i2c and call SW_I2C_Slave_Init as on target.
+ */
+void sim_device_init(sim_device_t *v, sim_bus_t *b, struct sw_i2c_slave_s *s)
+{
+    memset(v, 0, sizeof(*v));
+    v->bus = b;
+    v->slave = s;
+    v->i2c.hal_init = sim_dev_hal_init;
+    v->i2c.hal_deinit = sim_dev_hal_deinit;
+    v->i2c.hal_io_ctl = sim_dev_hal_io_ctl;
+    v->i2c.hal_delay_us = sim_hal_delay_us;
+    v->i2c.hal_delay_ns = sim_hal_delay_ns;
+    v->i2c.hal_cycles = sim_hal_cycles;
+    v->i2c.hal_edge_irq = sim_dev_hal_edge_irq;
+    v->i2c.scl_port = b->i2c.scl_port;
+    v->i2c.sda_port = b->i2c.sda_port;
+    v->i2c.scl_pin = b->i2c.scl_pin;
+    v->i2c.sda_pin = b->i2c.sda_pin;
+    v->i2c.flags = SW_I2C_FLAG_OPEN_DRAIN;
+    v->scl_latch = v->sda_latch = 1;
+    v->irq_ns = SIM_DEFAULT_IRQ_NS;
+    v->isr_ns = SIM_DEFAULT_ISR_NS;
+    v->io_ns = SIM_DEFAULT_IO_NS;
+    b->dev = v;
+    sim_eval(b);
+}
+
+void sim_device_reset_stats(sim_device_t *v)
+{
+    v->irqs = 0;
+    v->merged = 0;
+    v->late = 0;
+    v->entry_max_ns = 0;
+    v->resp_max_ns = 0;
+    v->resp_sum_ns = 0;
+}
+
+void sim_bus_reset_stats(sim_bus_t *b)
+{
+    memset(&b->stats, 0, sizeof(b->stats));
+    memset(&b->last_xfer, 0, sizeof(b->last_xfer));
+    b->xfer_mark = b->stats;
+    b->xfers = 0;
+    sim_timing_reset(b);
+}
@@ -0,0 +1,251 @@
+/***
+ * Host-side simulated bus for the soft I2C core.
+ *
+ * A sim_bus_t embeds a sw_i2c_t whose HAL callbacks drive a model of two
+ * open-drain lines. Each line is the wired-AND of the controller and every
+ * attached virtual target; targets are byte-level devices fed by a bit
+ * decoder that follows START/STOP, address, data and ACK phases.
+ *
+ * Time is virtual: the delay hooks and every HAL call advance a global clock,
+ * so edge counts and bus time per transaction are exact and reproducible.
+ */
+#ifndef _SW_I2C_SIM_H_
+#define _SW_I2C_SIM_H_
+
+#include <stdint.h>
+#include "sw_i2c.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sim_target_s sim_target_t;
+typedef struct sim_bus_s sim_bus_t;
+typedef struct sim_device_s sim_device_t;
+struct sw_i2c_slave_s;
+
+/**
+ * Byte-level target behaviour, called by the bus decoder.
+ * Return non-zero from start/write to acknowledge.
+ */
+typedef struct
+{
+    int (*start)(sim_target_t *t, uint8_t rw);
+    int (*write)(sim_target_t *t, uint8_t data);
+    uint8_t (*read)(sim_target_t *t);
+    void (*stop)(sim_target_t *t);
+} sim_target_ops_t;
+
+struct sim_target_s
+{
+    const sim_target_ops_t *ops;
+    uint8_t addr;           /* 7-bit address */
+    sim_target_t *next;
+
+    /* scripted faults */
+    int nack_addr;          /* NACK own address this many more times */
+    int nack_write_at;      /* NACK the n-th written byte of a transaction and keep
+                               listening like a busy target, -1 off */
+    uint32_t stretch_ns;    /* hold SCL low this long after every ACK clock */
+
+    /* bookkeeping, maintained by the decoder */
+    uint32_t wcount;        /* bytes written in current transaction */
+    uint32_t rcount;        /* bytes read in current transaction */
+};
+
+/** Counters kept per bus. */
+typedef struct
+{
+    uint64_t time_ns;       /* virtual time spent on this bus */
+    uint64_t delay_ns;      /* total requested by hal_delay_us/_ns */
+    uint32_t delay_calls;
+    uint32_t io_calls;      /* hal_io_ctl invocations */
+    uint32_t reg_ops;       /* fast path register loads/stores */
+    uint32_t dir_switches;  /* SDA/SCL input/output mode changes */
+    uint32_t critical;      /* critical sections entered */
+    uint32_t scl_edges;
+    uint32_t sda_edges;
+    uint32_t starts;        /* including repeated starts */
+    uint32_t stops;
+    uint32_t bytes;         /* bytes completed on the wire, incl. address */
+    uint32_t acks;          /* 9th clocks sampled low */
+    uint32_t stretches;     /* SCL holds by targets */
+} sim_stats_t;
+
+/**
+ * Shortest phase times seen on a bus, in ns, to hold against the UM10204
+ * minimums; UINT32_MAX until the phase occurred. Lines switch instantly,
+ * so the high times include whatever the controller allowed for rise time.
+ */
+typedef struct
+{
+    uint32_t low_ns;        /* tLOW, SCL fall to rise inside a transaction */
+    uint32_t high_ns;       /* tHIGH, SCL rise to fall inside a transaction */
+    uint32_t su_sta_ns;     /* SCL rise to a repeated START */
+    uint32_t hd_sta_ns;     /* START to SCL fall */
+    uint32_t su_sto_ns;     /* SCL rise to STOP */
+    uint32_t buf_ns;        /* STOP to the next START */
+} sim_timing_t;
+
+/** Cost model of one HAL call, in virtual nanoseconds. */
+typedef struct
+{
+    uint32_t io_ns;         /* line set/get */
+    uint32_t dir_ns;        /* direction switch (gpio_init on AT32) */
+    uint32_t call_ns;       /* per delay call overhead */
+    uint32_t reg_ns;        /* fast path register load/store */
+} sim_cost_t;
+
+struct sim_bus_s
+{
+    sw_i2c_t i2c;           /* must stay first, HAL slot points here */
+    gpio_type gpio;
+    sim_cost_t cost;
+    sim_target_t *targets;
+    sim_device_t *dev;      /* core in target mode on the same lines, or NULL */
+    sim_bus_t *next;
+
+    /* controller side of the lines */
+    uint8_t scl_latch, sda_latch;
+    uint8_t scl_output, sda_output;
+
+    /* wired-AND result */
+    uint8_t scl, sda;
+
+    /* decoder */
+    uint8_t state;
+    uint8_t bit;
+    uint8_t shift;
+    uint8_t rw;
+    uint8_t ack;
+    uint8_t listen;         /* scripted NACK: the active target takes the next byte */
+    uint8_t phase;
+    uint8_t tx;
+    uint8_t t_sda;          /* targets' SDA drive, 0 = pull low */
+    uint8_t t_scl;          /* targets' SCL drive, 0 = hold low */
+    uint64_t stretch_until; /* release time of a target SCL hold */
+    sim_target_t *active;
+    uint8_t in_xfer;
+
+    sim_stats_t stats;
+    sim_timing_t tmin;      /* reset with the stats */
+    uint64_t scl_rise_at, scl_fall_at, start_at, stop_at;
+    uint8_t hd_sta_open;    /* START seen, SCL has not fallen yet */
+    sim_stats_t xfer_mark;  /* stats at last START from idle */
+    sim_stats_t last_xfer;  /* delta of last START..STOP */
+    uint32_t xfers;
+};
+
+/**
+ * A second MCU on the bus running the core in target mode (sw_i2c_slave.c).
+ * Its lines join the wired-AND; every edge latches an EXINT flag and the
+ * handler runs irq_ns after the first pending edge, or when the previous run
+ * ends. A run takes isr_ns plus io_ns per HAL call and moves its lines at
+ * the virtual time of the call. The run cannot be preempted by the
+ * controller: when it outlasts the controller's current wait the
+ * controller's next edge is postponed, counted in late (optimistic result).
+ */
+struct sim_device_s
+{
+    sw_i2c_t i2c;           /* must stay first, HAL slot points here */
+    sim_bus_t *bus;
+    struct sw_i2c_slave_s *slave;
+    uint8_t scl_latch, sda_latch;
+    uint8_t irq_on;
+    uint32_t irq_ns;        /* edge to handler entry */
+    uint32_t isr_ns;        /* handler entry and exit */
+    uint32_t io_ns;         /* per HAL call in the handler */
+
+    uint32_t pending;       /* EXINT flags, scl_pin/sda_pin */
+    uint64_t edge_at;       /* first pending edge */
+    uint64_t busy_until;    /* end of the last run */
+
+    /* measurements */
+    uint32_t irqs;          /* handler runs */
+    uint32_t merged;        /* edges on a line whose flag was still set */
+    uint32_t late;          /* runs that held up the controller */
+    uint64_t entry_max_ns;  /* edge to handler entry */
+    uint64_t resp_max_ns;   /* edge to handler exit */
+    uint64_t resp_sum_ns;
+};
+
+/* bus */
+void sim_bus_init(sim_bus_t *b);
+void sim_bus_use_fast(sim_bus_t *b, int on);
+void sim_bus_place(sim_bus_t *b, gpio_type *port, uint32_t scl_pin, uint32_t sda_pin);
+void sim_bus_attach(sim_bus_t *b, sim_target_t *t);
+void sim_bus_reset_stats(sim_bus_t *b);
+void sim_device_init(sim_device_t *v, sim_bus_t *b, struct sw_i2c_slave_s *s);
+void sim_device_reset_stats(sim_device_t *v);
+void sim_stats_delta(sim_stats_t *out, const sim_stats_t *now, const sim_stats_t *mark);
+void sim_reset(void);
+uint64_t sim_now_ns(void);
+void sim_advance_ns(uint64_t ns);
+
+/* virtual targets */
+typedef struct
+{
+    sim_target_t base;
+    uint8_t regs[256];
+    uint8_t ptr;
+} sim_regfile_t;
+
+typedef struct
+{
+    sim_target_t base;
+    uint8_t *mem;
+    uint32_t size;          /* bytes, power of two */
+    uint16_t page;          /* page size, power of two */
+    uint8_t addr_bytes;     /* 1 or 2 */
+    uint32_t write_ns;      /* internal write cycle (tWR) */
+    uint64_t busy_until;
+    uint32_t ptr;
+    uint8_t buf[256];
+    uint16_t buf_len;
+    uint32_t buf_base;
+    uint32_t pages_written;
+} sim_eeprom_t;
+
+typedef struct
+{
+    sim_target_t base;
+    uint8_t status;
+    uint8_t data;
+    uint8_t config;
+    uint8_t *rptr;
+    uint8_t cmd;
+} sim_ds2482_t;
+
+#define SIM_SMBUS_BLOCK_MAX 32
+
+typedef struct
+{
+    sim_target_t base;
+    uint16_t words[0x80];   /* commands 0x00-0x7F, 0x00-0x3F read back one byte */
+    uint8_t blocks[16][1 + SIM_SMBUS_BLOCK_MAX]; /* commands 0x80-0x8F, count first */
+    uint8_t byte;           /* Send/Receive Byte */
+    uint8_t pec_on;         /* writes end with a PEC byte, checked at STOP */
+    int bad_pec;            /* send this many more corrupted PEC bytes */
+    uint32_t pec_errors;    /* writes dropped for a wrong PEC */
+
+    /* transaction */
+    uint8_t crc, crc_prev;  /* PEC since START, and before the last written byte */
+    uint8_t started;
+    uint8_t reading;
+    uint8_t rx[3 + SIM_SMBUS_BLOCK_MAX];
+    uint8_t rx_len;
+    uint8_t tx[1 + SIM_SMBUS_BLOCK_MAX];
+    uint8_t tx_len, tx_pos;
+} sim_smbus_t;
+
+void sim_regfile_init(sim_regfile_t *t, uint8_t addr7);
+void sim_eeprom_init(sim_eeprom_t *t, uint8_t addr7, uint8_t *mem, uint32_t size,
+                     uint16_t page, uint8_t addr_bytes, uint32_t write_ns);
+void sim_ds2482_init(sim_ds2482_t *t, uint8_t addr7);
+void sim_smbus_init(sim_smbus_t *t, uint8_t addr7);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SW_I2C_SIM_H_ */
@@ -0,0 +1,372 @@
+/***
+ * Virtual I2C targets for the simulated bus
+ */
+
+#include <string.h>
+#include "sw_i2c_sim.h"
+
+static void sim_target_base_init(sim_target_t *t, const sim_target_ops_t *ops, uint8_t addr7)
+{
+    memset(t, 0, sizeof(*t));
+    t->ops = ops;
+    t->addr = addr7;
+    t->nack_write_at = -1;
+}
+
+/**
+ * Register-file sensor: first written byte selects the register, following
+ * bytes are stored with auto-increment, reads continue from the pointer.
+ */
+
+static int regfile_start(sim_target_t *t, uint8_t rw)
+{
+    (void)t;
+    (void)rw;
+    return 1;
+}
+
+static int regfile_write(sim_target_t *t, uint8_t data)
+{
+    sim_regfile_t *r = (sim_regfile_t *)t;
+    if (t->wcount == 0)
+        r->ptr = data;
+    else
+        r->regs[r->ptr++] = data;
+    return 1;
+}
+
+static uint8_t regfile_read(sim_target_t *t)
+{
+    sim_regfile_t *r = (sim_regfile_t *)t;
+    return r->regs[r->ptr++];
+}
+
+static const sim_target_ops_t regfile_ops =
+{
+    .start = regfile_start,
+    .write = regfile_write,
+    .read = regfile_read,
+    .stop = NULL,
+};
+
+void sim_regfile_init(sim_regfile_t *t, uint8_t addr7)
+{
+    memset(t, 0, sizeof(*t));
+    sim_target_base_init(&t->base, &regfile_ops, addr7);
+}
+
+/**
+ * 24Cxx EEPROM: 1 or 2 address bytes, page buffered writes that roll over
+ * inside the page, committed on STOP. The address is NACKed for write_ns
+ * after a commit, which is what ACK polling relies on.
+ */
+
+static int eeprom_start(sim_target_t *t, uint8_t rw)
+{
+    sim_eeprom_t *e = (sim_eeprom_t *)t;
+    (void)rw;
+    if (sim_now_ns() < e->busy_until)
+        return 0;
+    e->buf_len = 0;
+    return 1;
+}
+
+static int eeprom_write(sim_target_t *t, uint8_t data)
+{
+    sim_eeprom_t *e = (sim_eeprom_t *)t;
+    uint32_t page_base;
+
+    if (t->wcount < e->addr_bytes)
+    {
+        e->ptr = (t->wcount == 0) ? data : ((e->ptr << 8) | data);
+        e->ptr &= e->size - 1;
+        return 1;
+    }
+    page_base = e->ptr & ~(uint32_t)(e->page - 1);
+    if (e->buf_len == 0)
+    {
+        memcpy(e->buf, &e->mem[page_base], e->page);
+        e->buf_base = page_base;
+    }
+    e->buf[e->ptr & (e->page - 1)] = data;
+    e->ptr = page_base | ((e->ptr + 1) & (e->page - 1));
+    e->buf_len++;
+    return 1;
+}
+
+static uint8_t eeprom_read(sim_target_t *t)
+{
+    sim_eeprom_t *e = (sim_eeprom_t *)t;
+    uint8_t data = e->mem[e->ptr];
+    e->ptr = (e->ptr + 1) & (e->size - 1);
+    return data;
+}
+
+static void eeprom_stop(sim_target_t *t)
+{
+    sim_eeprom_t *e = (sim_eeprom_t *)t;
+    if (e->buf_len == 0)
+        return;
+    memcpy(&e->mem[e->buf_base], e->buf, e->page);
+    e->buf_len = 0;
+    e->busy_until = sim_now_ns() + e->write_ns;
+    e->pages_written++;
+}
+
+static const sim_target_ops_t eeprom_ops =
+{
+    .start = eeprom_start,
+    .write = eeprom_write,
+    .read = eeprom_read,
+    .stop = eeprom_stop,
+};
+
+void sim_eeprom_init(sim_eeprom_t *t, uint8_t addr7, uint8_t *mem, uint32_t size,
+                     uint16_t page, uint8_t addr_bytes, uint32_t write_ns)
+{
+    memset(t, 0, sizeof(*t));
+    sim_target_base_init(&t->base, &eeprom_ops, addr7);
+    t->mem = mem;
+    t->size = size;
+    t->page = page > sizeof(t->buf) ? sizeof(t->buf) : page;
+    t->addr_bytes = addr_bytes;
+    t->write_ns = write_ns;
+}
+
+/**
+ * DS2482-style bridge: no register address on reads, the chip returns the
+ * register chosen by the last command (Set Read Pointer, Write Config, ...).
+ */
+
+#define DS2482_CMD_RESET        0xF0
+#define DS2482_CMD_SET_PTR      0xE1
+#define DS2482_CMD_WRITE_CFG    0xD2
+#define DS2482_PTR_STATUS       0xF0
+#define DS2482_PTR_DATA         0xE1
+#define DS2482_PTR_CONFIG       0xC3
+#define DS2482_STATUS_RST       0x10
+
+static int ds2482_start(sim_target_t *t, uint8_t rw)
+{
+    (void)t;
+    (void)rw;
+    return 1;
+}
+
+static int ds2482_write(sim_target_t *t, uint8_t data)
+{
+    sim_ds2482_t *d = (sim_ds2482_t *)t;
+
+    if (t->wcount == 0)
+    {
+        d->cmd = data;
+        if (data == DS2482_CMD_RESET)
+        {
+            d->status = DS2482_STATUS_RST;
+            d->config = 0;
+            d->rptr = &d->status;
+        }
+        return 1;
+    }
+    if (t->wcount > 1)
+        return 0;
+
+    switch (d->cmd)
+    {
+    case DS2482_CMD_SET_PTR:
+        if (data == DS2482_PTR_STATUS)
+            d->rptr = &d->status;
+        else if (data == DS2482_PTR_DATA)
+            d->rptr = &d->data;
+        else if (data == DS2482_PTR_CONFIG)
+            d->rptr = &d->config;
+        else
+            return 0;
+        return 1;
+    case DS2482_CMD_WRITE_CFG:
+        if ((data >> 4) != (~data & 0x0F))
+            return 0;
+        d->config = data & 0x0F;
+        d->status &= ~DS2482_STATUS_RST;
+        d->rptr = &d->config;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static uint8_t ds2482_read(sim_target_t *t)
+{
+    sim_ds2482_t *d = (sim_ds2482_t *)t;
+    return *d->rptr;
+}
+
+static const sim_target_ops_t ds2482_ops =
+{
+    .start = ds2482_start,
+    .write = ds2482_write,
+    .read = ds2482_read,
+    .stop = NULL,
+};
+
+void sim_ds2482_init(sim_ds2482_t *t, uint8_t addr7)
+{
+    memset(t, 0, sizeof(*t));
+    sim_target_base_init(&t->base, &ds2482_ops, addr7);
+    t->status = DS2482_STATUS_RST;
+    t->rptr = &t->status;
+}
+
+/**
+ * SMBus device: commands 0x00-0x3F are byte registers, 0x40-0x7F word
+ * registers (a write sets one byte or the word in either), 0x80-0x8F hold
+ * blocks, 0xC0 is a process call answering the complement of the word.
+ * The PEC is a bitwise CRC-8 over every byte from the first address byte
+ * on, independent of the core's table; it follows the data of every read.
+ */
+
+#define SMBUS_CMD_WORD          0x40
+#define SMBUS_CMD_BLOCK         0x80
+#define SMBUS_CMD_PROC_CALL     0xC0
+
+static uint8_t smbus_crc8(uint8_t crc, uint8_t data)
+{
+    int i;
+
+    crc ^= data;
+    for (i = 0; i < 8; i++)
+        crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    return crc;
+}
+
+/* Build the answer of a read from the bytes written before it */
+static void smbus_prepare_read(sim_smbus_t *m)
+{
+    uint8_t cmd = m->rx[0];
+    uint16_t w;
+
+    m->tx_len = 0;
+    m->tx_pos = 0;
+    if (m->rx_len == 0)
+    {
+        m->tx[m->tx_len++] = m->byte;
+    }
+    else if (cmd < SMBUS_CMD_BLOCK)
+    {
+        m->tx[m->tx_len++] = (uint8_t)m->words[cmd];
+        if (cmd >= SMBUS_CMD_WORD)
+            m->tx[m->tx_len++] = (uint8_t)(m->words[cmd] >> 8);
+    }
+    else if (cmd < SMBUS_CMD_BLOCK + 16)
+    {
+        /* a scripted count above the maximum is sent as is, data cut short */
+        m->tx_len = 1 + m->blocks[cmd - SMBUS_CMD_BLOCK][0];
+        if (m->tx_len > sizeof(m->tx))
+            m->tx_len = sizeof(m->tx);
+        memcpy(m->tx, m->blocks[cmd - SMBUS_CMD_BLOCK], m->tx_len);
+    }
+    else if (cmd == SMBUS_CMD_PROC_CALL && m->rx_len >= 3)
+    {
+        w = (uint16_t)~(m->rx[1] | (m->rx[2] << 8));
+        m->tx[m->tx_len++] = (uint8_t)w;
+        m->tx[m->tx_len++] = (uint8_t)(w >> 8);
+    }
+}
+
+static int smbus_start(sim_target_t *t, uint8_t rw)
+{
+    sim_smbus_t *m = (sim_smbus_t *)t;
+
+    if (!m->started)
+    {
+        m->started = 1;
+        m->reading = 0;
+        m->crc = 0;
+        m->rx_len = 0;
+    }
+    m->crc = smbus_crc8(m->crc, (uint8_t)((t->addr << 1) | rw));
+    if (rw)
+    {
+        m->reading = 1;
+        smbus_prepare_read(m);
+    }
+    return 1;
+}
+
+static int smbus_write(sim_target_t *t, uint8_t data)
+{
+    sim_smbus_t *m = (sim_smbus_t *)t;
+
+    if (m->rx_len >= sizeof(m->rx))
+        return 0;
+    m->rx[m->rx_len++] = data;
+    m->crc_prev = m->crc;
+    m->crc = smbus_crc8(m->crc, data);
+    return 1;
+}
+
+static uint8_t smbus_read(sim_target_t *t)
+{
+    sim_smbus_t *m = (sim_smbus_t *)t;
+    uint8_t b;
+
+    if (m->tx_pos < m->tx_len)
+    {
+        b = m->tx[m->tx_pos++];
+        m->crc = smbus_crc8(m->crc, b);
+        return b;
+    }
+    if (m->tx_pos++ == m->tx_len)
+    {
+        if (m->bad_pec > 0)
+        {
+            m->bad_pec--;
+            return m->crc ^ 0x5A;
+        }
+        return m->crc;
+    }
+    return 0xFF;
+}
+
+/* Commit a write-only transaction */
+static void smbus_stop(sim_target_t *t)
+{
+    sim_smbus_t *m = (sim_smbus_t *)t;
+    uint8_t n = m->rx_len, cmd = m->rx[0];
+
+    m->started = 0;
+    if (m->reading || n == 0)
+        return;
+    if (m->pec_on)
+    {
+        if (n < 2 || m->rx[n - 1] != m->crc_prev)
+        {
+            m->pec_errors++;
+            return;
+        }
+        n--;
+    }
+    if (n == 1)
+        m->byte = cmd;
+    else if (cmd < SMBUS_CMD_BLOCK && n == 2)
+        m->words[cmd] = (m->words[cmd] & 0xFF00) | m->rx[1];
+    else if (cmd < SMBUS_CMD_BLOCK && n == 3)
+        m->words[cmd] = m->rx[1] | (m->rx[2] << 8);
+    else if (cmd >= SMBUS_CMD_BLOCK && cmd < SMBUS_CMD_BLOCK + 16 &&
+             m->rx[1] >= 1 && m->rx[1] <= SIM_SMBUS_BLOCK_MAX && n == 2 + m->rx[1])
+        memcpy(m->blocks[cmd - SMBUS_CMD_BLOCK], &m->rx[1], n - 1);
+}
+
+static const sim_target_ops_t smbus_ops =
+{
+    .start = smbus_start,
+    .write = smbus_write,
+    .read = smbus_read,
+    .stop = smbus_stop,
+};
+
+void sim_smbus_init(sim_smbus_t *t, uint8_t addr7)
+{
+    memset(t, 0, sizeof(*t));
+    sim_target_base_init(&t->base, &smbus_ops, addr7);
+}
@@ -0,0 +1,71 @@
+/***
+ * Test runner: every suite starts from a simulator without buses.
+ *
+ * Usage: sw_i2c_test [suite]
+ */
+
+#include <stdlib.h>
+#include "sw_i2c_test.h"
+
+unsigned test_checks;
+unsigned test_failures;
+
+void test_fail(const char *file, int line, const char *expr, long long a, long long b)
+{
+    test_failures++;
+    if (a != b)
+        fprintf(stderr, "%s:%d: %s failed (%lld != %lld)\n", file, line, expr, a, b);
+    else
+        fprintf(stderr, "%s:%d: %s failed\n", file, line, expr);
+}
+
+typedef struct
+{
+    const char *name;
+    void (*fn)(void);
+} test_suite_t;
+
+static const test_suite_t suites[] =
+{
+    { "core", test_core },
+    { "timing", test_timing },
+    { "eeprom", test_eeprom },
+    { "async", test_async },
+    { "wave", test_wave },
+    { "multi", test_multi },
+    { "poll", test_poll },
+    { "cache", test_cache },
+    { "trace", test_trace },
+    { "recover", test_recover },
+    { "scan", test_scan },
+    { "slave", test_slave },
+    { "smbus", test_smbus },
+    { "hpp", test_hpp },
+};
+
+int main(int argc, char **argv)
+{
+    unsigned failed = 0, run = 0;
+
+    for (unsigned i = 0; i < sizeof(suites) / sizeof(suites[0]); i++)
+    {
+        unsigned checks = test_checks, failures = test_failures;
+
+        if (argc > 1 && strcmp(argv[1], suites[i].name) != 0)
+            continue;
+        sim_reset();
+        suites[i].fn();
+        run++;
+        printf("%-10s %4u checks  %s\n", suites[i].name, test_checks - checks,
+               test_failures == failures ? "ok" : "FAILED");
+        if (test_failures != failures)
+            failed++;
+    }
+    if (run == 0)
+    {
+        fprintf(stderr, "no suite %s\n", argc > 1 ? argv[1] : "");
+        return EXIT_FAILURE;
+    }
+    printf("%u suites, %u checks, %u failed\n", run, test_checks, test_failures);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,68 @@
+/***
+ * Pass/fail tests of the soft I2C core and its modules on the simulated
+ * bus (make -C sim test). Each suite is a function listed in
+ * sw_i2c_test.c; a failed check prints its location and the run exits
+ * non-zero.
+ */
+#ifndef _SW_I2C_TEST_H_
+#define _SW_I2C_TEST_H_
+
+#include <stdio.h>
+#include <string.h>
+#include "sw_i2c_sim.h"
+
+#ifndef TRUE
+	#define TRUE 1
+#endif
+#ifndef FALSE
+	#define FALSE 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern unsigned test_checks;
+extern unsigned test_failures;
+
+void test_fail(const char *file, int line, const char *expr, long long a, long long b);
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        test_checks++;                                                  \
+        if (!(cond))                                                    \
+            test_fail(__FILE__, __LINE__, #cond, 0, 0);                 \
+    } while (0)
+
+/* Integer equality, both values printed on failure */
+#define CHECK_EQ(a, b)                                                  \
+    do {                                                                \
+        long long a_ = (long long)(a), b_ = (long long)(b);             \
+        test_checks++;                                                  \
+        if (a_ != b_)                                                   \
+            test_fail(__FILE__, __LINE__, #a " == " #b, a_, b_);        \
+    } while (0)
+
+#define CHECK_MEM(a, b, n)  CHECK(memcmp((a), (b), (n)) == 0)
+
+/* suites */
+void test_core(void);
+void test_timing(void);
+void test_eeprom(void);
+void test_async(void);
+void test_wave(void);
+void test_multi(void);
+void test_poll(void);
+void test_cache(void);
+void test_trace(void);
+void test_recover(void);
+void test_scan(void);
+void test_slave(void);
+void test_smbus(void);
+void test_hpp(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SW_I2C_TEST_H_ */
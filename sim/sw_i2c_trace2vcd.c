@@ -0,0 +1,295 @@
+/***
+ * Host converter for soft I2C transaction traces.
+ *
+ * Input is a binary file of sw_i2c_trace_rec_t as stored by the MCU: the
+ * output of SW_I2C_Trace_Read written out in order, or a raw dump of the
+ * whole rec array (empty slots are skipped, the rest is ordered by seq).
+ *
+ * The default output is a VCD with SCL/SDA per bus, rebuilt from the kept
+ * wire bytes and spread evenly over each transaction's duration; bytes past
+ * SW_I2C_TRACE_BYTES have SDA 'x'. PulseView imports it and decodes it with
+ * its I2C decoder. With -s the annotations are printed directly, in the
+ * format of `sigrok-cli -P i2c --protocol-decoder-samplenum`, one sample
+ * per nanosecond.
+ *
+ * Usage: sw_i2c_trace2vcd [-s] [-f cycles_per_second] trace.bin
+ *        -f defaults to 1e9 (simulator nanoseconds); AT32 uses SystemCoreClock
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sw_i2c_trace.h"
+
+#define TRACE_IDLE_BIT_NS   2500    // bit time when a record has no duration
+#define TRACE_BUS_MAX       256
+
+typedef struct
+{
+    uint64_t t;
+    uint32_t order;                 // keeps stores of one instant in program order
+    uint8_t bus;
+    char sig;                       // 'c' SCL, 'd' SDA
+    char val;                       // '0', '1', 'x'
+} trace_event_t;
+
+static trace_event_t *events;
+static size_t event_cnt, event_cap;
+static uint8_t bus_used[TRACE_BUS_MAX];
+
+static const char * const status_names[] =
+{
+    "OK", "ERR_PARAM", "ADDR_NACK", "REG_NACK", "DATA_NACK", "BUS_BUSY",
+    "STRETCH_TIMEOUT", "LOCK_TIMEOUT", "QUEUE_FULL", "NO_DATA", "OVERRUN", "PEC",
+    "PROTOCOL",
+};
+
+static const char * status_name(uint8_t st)
+{
+    return st < sizeof(status_names) / sizeof(status_names[0]) ? status_names[st] : "?";
+}
+
+static int rec_cmp(const void *a, const void *b)
+{
+    uint32_t x = ((const sw_i2c_trace_rec_t *)a)->seq, y = ((const sw_i2c_trace_rec_t *)b)->seq;
+    return (int32_t)(x - y) < 0 ? -1 : x != y;
+}
+
+static int event_cmp(const void *a, const void *b)
+{
+    const trace_event_t *x = a, *y = b;
+
+    if (x->t != y->t)
+        return x->t < y->t ? -1 : 1;
+    return x->order < y->order ? -1 : x->order != y->order;
+}
+
+static void event_add(uint64_t t, uint8_t bus, char sig, char val)
+{
+    if (event_cnt == event_cap)
+    {
+        event_cap = event_cap ? event_cap * 2 : 1024;
+        events = realloc(events, event_cap * sizeof(*events));
+        if (events == NULL)
+        {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    events[event_cnt] = (trace_event_t){ t, (uint32_t)event_cnt, bus, sig, val };
+    event_cnt++;
+}
+
+/* Bit i of the record: wire byte, ACK and START markers; unknown past the kept bytes */
+static int rec_known(const sw_i2c_trace_rec_t *r, unsigned i)
+{
+    return i < SW_I2C_TRACE_BYTES;
+}
+
+static unsigned rec_starts(const sw_i2c_trace_rec_t *r)
+{
+    unsigned n = 0;
+
+    for (unsigned i = 0; i < r->wire && rec_known(r, i); i++)
+        n += (r->start >> i) & 1;
+    return n;
+}
+
+static uint64_t rec_bit_ns(const sw_i2c_trace_rec_t *r, double ns_per_cycle)
+{
+    uint64_t periods = (uint64_t)r->wire * 9 + rec_starts(r) + 1;
+    uint64_t bit = (uint64_t)(r->duration * ns_per_cycle) / periods;
+
+    if (r->duration == 0)
+        return TRACE_IDLE_BIT_NS;
+    return bit >= 4 ? bit : 4;
+}
+
+static void vcd_record(const sw_i2c_trace_rec_t *r, uint64_t t, uint64_t bit)
+{
+    uint64_t q = bit / 4;
+    uint8_t b = r->bus;
+
+    for (unsigned i = 0; i < r->wire; i++)
+    {
+        int known = rec_known(r, i);
+
+        if (known && ((r->start >> i) & 1))
+        {
+            if (i > 0)
+                event_add(t, b, 'd', '1');  // repeated START: release SDA with SCL low
+            event_add(t + q, b, 'c', '1');
+            event_add(t + 2 * q, b, 'd', '0');
+            event_add(t + 3 * q, b, 'c', '0');
+            t += bit;
+        }
+        for (int x = 7; x >= -1; x--)
+        {
+            char v;
+
+            if (!known)
+                v = 'x';
+            else if (x >= 0)
+                v = ((r->bytes[i] >> x) & 1) ? '1' : '0';
+            else
+                v = ((r->ack >> i) & 1) ? '0' : '1';
+            event_add(t, b, 'd', v);
+            event_add(t + q, b, 'c', '1');
+            event_add(t + 3 * q, b, 'c', '0');
+            t += bit;
+        }
+    }
+    if (r->wire)
+    {
+        event_add(t, b, 'd', '0');
+        event_add(t + q, b, 'c', '1');
+        event_add(t + 2 * q, b, 'd', '1');
+    }
+}
+
+static void vcd_print(void)
+{
+    uint64_t last = UINT64_MAX;
+
+    printf("$comment soft I2C trace $end\n$timescale 1ns $end\n$scope module sw_i2c $end\n");
+    for (unsigned b = 0; b < TRACE_BUS_MAX; b++)
+    {
+        if (bus_used[b])
+            printf("$var wire 1 c%u scl%u $end\n$var wire 1 d%u sda%u $end\n", b, b, b, b);
+    }
+    printf("$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n");
+    for (unsigned b = 0; b < TRACE_BUS_MAX; b++)
+    {
+        if (bus_used[b])
+            printf("1c%u\n1d%u\n", b, b);
+    }
+    printf("$end\n");
+
+    qsort(events, event_cnt, sizeof(*events), event_cmp);
+    for (size_t i = 0; i < event_cnt; i++)
+    {
+        if (events[i].t != last)
+        {
+            last = events[i].t;
+            printf("#%llu\n", (unsigned long long)last);
+        }
+        printf("%c%c%u\n", events[i].val, events[i].sig, events[i].bus);
+    }
+}
+
+/* Annotations in sigrok's I2C decoder wording, one START..STOP per record */
+static void sigrok_record(const sw_i2c_trace_rec_t *r, uint64_t t, uint64_t bit)
+{
+    int rd = 0;
+
+    if (r->status != SW_I2C_OK)
+        printf("%llu-%llu i2c-%u: Warning: %s\n", (unsigned long long)t,
+               (unsigned long long)(t + bit), r->bus, status_name(r->status));
+    for (unsigned i = 0; i < r->wire; i++)
+    {
+        int known = rec_known(r, i);
+        uint64_t e = t + 8 * bit;
+
+        if (known && ((r->start >> i) & 1))
+        {
+            printf("%llu-%llu i2c-%u: %s\n", (unsigned long long)t, (unsigned long long)(t + bit),
+                   r->bus, i ? "Start repeat" : "Start");
+            t += bit;
+            e = t + 8 * bit;
+            rd = r->bytes[i] & 1;
+            printf("%llu-%llu i2c-%u: Address %s: %02X\n", (unsigned long long)t,
+                   (unsigned long long)(e - bit), r->bus, rd ? "read" : "write", r->bytes[i] >> 1);
+            printf("%llu-%llu i2c-%u: %s\n", (unsigned long long)(e - bit), (unsigned long long)e,
+                   r->bus, rd ? "Read" : "Write");
+        }
+        else if (known)
+        {
+            printf("%llu-%llu i2c-%u: Data %s: %02X\n", (unsigned long long)t, (unsigned long long)e,
+                   r->bus, rd ? "read" : "write", r->bytes[i]);
+        }
+        else
+        {
+            printf("%llu-%llu i2c-%u: Data %s: ??\n", (unsigned long long)t, (unsigned long long)e,
+                   r->bus, rd ? "read" : "write");
+        }
+        t = e;
+        if (known)
+            printf("%llu-%llu i2c-%u: %s\n", (unsigned long long)t, (unsigned long long)(t + bit),
+                   r->bus, ((r->ack >> i) & 1) ? "ACK" : "NACK");
+        t += bit;
+    }
+    if (r->wire)
+        printf("%llu-%llu i2c-%u: Stop\n", (unsigned long long)t, (unsigned long long)(t + bit), r->bus);
+}
+
+int main(int argc, char **argv)
+{
+    double hz = 1e9;
+    int sigrok = 0;
+    const char *path = NULL;
+    sw_i2c_trace_rec_t *rec = NULL;
+    size_t cnt = 0, cap = 0, n;
+    uint64_t t_base = 0;
+    FILE *f;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-s") == 0)
+            sigrok = 1;
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            hz = atof(argv[++i]);
+        else
+            path = argv[i];
+    }
+    if (path == NULL || hz <= 0)
+    {
+        fprintf(stderr, "usage: %s [-s] [-f cycles_per_second] trace.bin\n", argv[0]);
+        return 2;
+    }
+    f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        perror(path);
+        return 1;
+    }
+    for (;;)
+    {
+        if (cnt == cap)
+        {
+            cap = cap ? cap * 2 : 256;
+            rec = realloc(rec, cap * sizeof(*rec));
+            if (rec == NULL)
+            {
+                perror("realloc");
+                return 1;
+            }
+        }
+        n = fread(&rec[cnt], sizeof(*rec), 1, f);
+        if (n != 1)
+            break;
+        if (rec[cnt].seq != 0)      // empty or torn slot of a raw dump
+            cnt++;
+    }
+    fclose(f);
+    qsort(rec, cnt, sizeof(*rec), rec_cmp);
+
+    /* 32-bit stamps wrap; records are in START order, so unwrap by difference */
+    for (size_t i = 0; i < cnt; i++)
+    {
+        uint64_t t, bit = rec_bit_ns(&rec[i], 1e9 / hz);
+
+        if (i > 0)
+            t_base += (uint32_t)(rec[i].stamp - rec[i - 1].stamp);
+        t = (uint64_t)(t_base * (1e9 / hz)) + TRACE_IDLE_BIT_NS;
+        bus_used[rec[i].bus] = 1;
+        if (sigrok)
+            sigrok_record(&rec[i], t, bit);
+        else
+            vcd_record(&rec[i], t, bit);
+    }
+    if (!sigrok)
+        vcd_print();
+    free(rec);
+    free(events);
+    return 0;
+}
@@ -0,0 +1,30 @@
+/***
+ * Host stand-in for FreeRTOS task services. Delays advance virtual time.
+ */
+#ifndef _SIM_TASK_H_
+#define _SIM_TASK_H_
+
+#include "FreeRTOS.h"
+
+typedef struct sim_task_s * TaskHandle_t;
+typedef void (*TaskFunction_t)(void *arg);
+
+typedef enum
+{
+    eNoAction = 0,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite,
+} eNotifyAction;
+
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+
+/* Tasks are recorded, never scheduled: host code drives the work itself */
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_words,
+                       void *arg, UBaseType_t prio, TaskHandle_t *handle);
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+uint32_t sim_task_notified_value(TaskHandle_t task);
+
+#endif /* _SIM_TASK_H_ */
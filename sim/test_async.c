@@ -0,0 +1,98 @@
+/***
+ * Async queue: submission limits, in-order execution by
+ * SW_I2C_Async_Process and the completion signals of a job.
+ */
+
+#include "sw_i2c_test.h"
+#include "sw_i2c_async.h"
+
+#define REG_ADDR    0x40
+
+static sim_bus_t bus;
+static sim_regfile_t regfile;
+static uint8_t seen_done, seen_status;
+static unsigned calls;
+
+static void on_done(sw_i2c_job_t *job)
+{
+    /* runs while the job is still the queue's */
+    seen_done = job->done;
+    seen_status = job->status;
+    calls++;
+    *(unsigned *)job->arg += 1;
+}
+
+static void idle(void *arg)
+{
+}
+
+void test_async(void)
+{
+    sw_i2c_async_t a;
+    TaskHandle_t waiter;
+    SemaphoreHandle_t sem = xSemaphoreCreateBinary();
+    unsigned mine = 0;
+    uint8_t wr[3] = { 0x08, 0xAB, 0xCD }, reg = 0x08, rd[2] = { 0 };
+    sw_i2c_msg_t write_msgs[] = { { REG_ADDR << 1, 0, 3, wr } };
+    sw_i2c_msg_t read_msgs[] =
+    {
+        { REG_ADDR << 1, SW_I2C_M_REG, 1, &reg },
+        { REG_ADDR << 1, SW_I2C_M_RD, 2, rd },
+    };
+    sw_i2c_msg_t absent_msgs[] = { { 0x22 << 1, 0, 3, wr } };
+    sw_i2c_job_t write_job = { write_msgs, 1, on_done, &mine, NULL, NULL, SW_I2C_OK, 0 };
+    sw_i2c_job_t read_job = { read_msgs, 2, NULL, NULL, NULL, sem, SW_I2C_OK, 0 };
+    sw_i2c_job_t absent_job = { absent_msgs, 1, on_done, &mine, NULL, NULL, SW_I2C_OK, 0 };
+
+    sim_bus_init(&bus);
+    sim_regfile_init(&regfile, REG_ADDR);
+    sim_bus_attach(&bus, &regfile.base);
+    SW_I2C_initial(&bus.i2c);
+    xTaskCreate(idle, "waiter", 128, NULL, 1, &waiter);
+    absent_job.notify_task = waiter;
+
+    CHECK_EQ(SW_I2C_Async_Init(&a, &bus.i2c, 0), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_Async_Init(&a, &bus.i2c, 2), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Async_Start_Task(&a, 2, 256), SW_I2C_OK);
+    CHECK(a.task != NULL);
+    CHECK_EQ(SW_I2C_Async_Process(&a, 0), FALSE);
+
+    /* depth 2: the third job does not fit */
+    CHECK(sem != NULL);
+    CHECK_EQ(xSemaphoreTake(sem, 0), pdFALSE);   // created empty
+    CHECK_EQ(SW_I2C_Async_Submit(&a, &write_job, 0), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Async_Submit(&a, &read_job, 0), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Async_Submit(&a, &absent_job, 0), SW_I2C_ERR_QUEUE_FULL);
+    CHECK_EQ(regfile.regs[0x08], 0);            // nothing ran on submit
+
+    /* in order: the write lands before the read-back */
+    CHECK_EQ(SW_I2C_Async_Process(&a, 0), TRUE);
+    CHECK_EQ(write_job.done, TRUE);
+    CHECK_EQ(write_job.status, SW_I2C_OK);
+    CHECK_EQ(calls, 1);
+    CHECK_EQ(mine, 1);
+    CHECK_EQ(seen_done, FALSE);
+    CHECK_EQ(seen_status, SW_I2C_OK);
+    CHECK_EQ(read_job.done, FALSE);
+    CHECK_EQ(xSemaphoreTake(sem, 0), pdFALSE);
+
+    CHECK_EQ(SW_I2C_Async_Process(&a, 0), TRUE);
+    CHECK_EQ(read_job.done, TRUE);
+    CHECK_EQ(rd[0], 0xAB);
+    CHECK_EQ(rd[1], 0xCD);
+    CHECK_EQ(xSemaphoreTake(sem, 0), pdTRUE);   // given on completion
+
+    /* a failure reaches the callback and the notified task */
+    CHECK_EQ(SW_I2C_Async_Submit(&a, &absent_job, 0), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Async_Process(&a, 0), TRUE);
+    CHECK_EQ(absent_job.status, SW_I2C_ERR_ADDR_NACK);
+    CHECK_EQ(seen_status, SW_I2C_ERR_ADDR_NACK);
+    CHECK_EQ(sim_task_notified_value(waiter), SW_I2C_ERR_ADDR_NACK);
+    CHECK_EQ(mine, 2);
+    CHECK_EQ(SW_I2C_Async_Process(&a, 0), FALSE);
+
+    write_job.num = 0;
+    CHECK_EQ(SW_I2C_Async_Submit(&a, &write_job, 0), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_Async_Submit(&a, NULL, 0), SW_I2C_ERR_PARAM);
+    vSemaphoreDelete(sem);
+}
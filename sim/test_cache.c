@@ -0,0 +1,139 @@
+/***
+ * Register shadow cache: reads served from the shadow, unchanged writes
+ * dropped, write-only registers, read-modify-write, failures forgetting
+ * the shadow, write-back after a device reset and argument checks.
+ */
+
+#include "sw_i2c_test.h"
+#include "sw_i2c_cache.h"
+
+#define REG_ADDR    0x40
+#define WINDOW      16
+
+static sim_bus_t bus;
+static sim_regfile_t regfile;
+static uint8_t value[WINDOW], state[WINDOW];
+
+static void cache_setup(sw_i2c_cache_t *c)
+{
+    *c = (sw_i2c_cache_t){ .bus = &bus.i2c, .IICID = REG_ADDR << 1, .alen = 1, .base = 0x10,
+                           .cnt = WINDOW, .value = value, .state = state };
+    memset(state, 0, sizeof(state));
+    SW_I2C_Cache_Set_Kind(c, 0x10, 8, SW_I2C_CACHE_CACHED);
+    SW_I2C_Cache_Set_Kind(c, 0x18, 2, SW_I2C_CACHE_WRITE_ONLY);
+}
+
+static void shadow(void)
+{
+    sw_i2c_cache_t c;
+    uint8_t v = 0;
+    uint32_t xfers;
+
+    cache_setup(&c);
+    regfile.regs[0x11] = 0x5A;
+    regfile.regs[0x1A] = 0x77;
+
+    /* cached: one bus read, then the shadow */
+    xfers = bus.xfers;
+    CHECK_EQ(SW_I2C_Cache_Read(&c, 0x11, &v), SW_I2C_OK);
+    CHECK_EQ(v, 0x5A);
+    CHECK_EQ(SW_I2C_Cache_Read(&c, 0x11, &v), SW_I2C_OK);
+    CHECK_EQ(v, 0x5A);
+    CHECK_EQ(bus.xfers, xfers + 1);
+    CHECK_EQ(c.hits, 1);
+
+    /* volatile, and outside the window: always the device */
+    CHECK_EQ(SW_I2C_Cache_Read(&c, 0x1A, &v), SW_I2C_OK);
+    regfile.regs[0x1A] = 0x78;
+    CHECK_EQ(SW_I2C_Cache_Read(&c, 0x1A, &v), SW_I2C_OK);
+    CHECK_EQ(v, 0x78);
+    CHECK_EQ(SW_I2C_Cache_Read(&c, 0x30, &v), SW_I2C_OK);
+    CHECK_EQ(bus.xfers, xfers + 4);
+
+    /* unchanged writes are dropped */
+    CHECK_EQ(SW_I2C_Cache_Write(&c, 0x12, 0x33), SW_I2C_OK);
+    CHECK_EQ(regfile.regs[0x12], 0x33);
+    CHECK_EQ(SW_I2C_Cache_Write(&c, 0x12, 0x33), SW_I2C_OK);
+    CHECK_EQ(c.skipped, 1);
+    CHECK_EQ(bus.xfers, xfers + 5);
+
+    /* write-only: unknown until written, then never read */
+    CHECK_EQ(SW_I2C_Cache_Read(&c, 0x18, &v), SW_I2C_ERR_NO_DATA);
+    CHECK_EQ(SW_I2C_Cache_Update_Bits(&c, 0x18, 0x0F, 0x01), SW_I2C_ERR_NO_DATA);
+    CHECK_EQ(SW_I2C_Cache_Write(&c, 0x18, 0xA0), SW_I2C_OK);
+    regfile.regs[0x18] = 0;
+    CHECK_EQ(SW_I2C_Cache_Read(&c, 0x18, &v), SW_I2C_OK);
+    CHECK_EQ(v, 0xA0);
+    CHECK_EQ(bus.xfers, xfers + 6);
+
+    /* read-modify-write: known register written once, unknown read first */
+    CHECK_EQ(SW_I2C_Cache_Update_Bits(&c, 0x18, 0x0F, 0x05), SW_I2C_OK);
+    CHECK_EQ(regfile.regs[0x18], 0xA5);
+    CHECK_EQ(bus.xfers, xfers + 7);
+    regfile.regs[0x13] = 0xF0;
+    CHECK_EQ(SW_I2C_Cache_Update_Bits(&c, 0x13, 0x03, 0x01), SW_I2C_OK);
+    CHECK_EQ(regfile.regs[0x13], 0xF1);
+    CHECK_EQ(bus.xfers, xfers + 9);
+    CHECK_EQ(SW_I2C_Cache_Update_Bits(&c, 0x13, 0x03, 0x01), SW_I2C_OK);
+    CHECK_EQ(bus.xfers, xfers + 9);
+    CHECK_EQ(c.skipped, 2);
+
+    /* a failed write forgets the value */
+    regfile.base.nack_write_at = 1;
+    CHECK_EQ(SW_I2C_Cache_Write(&c, 0x11, 0x22), SW_I2C_ERR_DATA_NACK);
+    regfile.base.nack_write_at = -1;
+    CHECK_EQ(SW_I2C_Cache_Read(&c, 0x11, &v), SW_I2C_OK);
+    CHECK_EQ(v, 0x5A);
+    CHECK_EQ(bus.xfers, xfers + 11);
+
+    /* device reset: the known registers written back */
+    memset(&regfile.regs[0x10], 0, WINDOW);
+    CHECK_EQ(SW_I2C_Cache_Sync(&c), SW_I2C_OK);
+    CHECK_EQ(regfile.regs[0x11], 0x5A);
+    CHECK_EQ(regfile.regs[0x12], 0x33);
+    CHECK_EQ(regfile.regs[0x13], 0xF1);
+    CHECK_EQ(regfile.regs[0x18], 0xA5);
+    CHECK_EQ(regfile.regs[0x14], 0);
+    CHECK_EQ(regfile.regs[0x1A], 0);
+
+    SW_I2C_Cache_Invalidate(&c);
+    regfile.regs[0x11] = 0x66;
+    CHECK_EQ(SW_I2C_Cache_Read(&c, 0x11, &v), SW_I2C_OK);
+    CHECK_EQ(v, 0x66);
+    CHECK_EQ(SW_I2C_Cache_Read(&c, 0x18, &v), SW_I2C_ERR_NO_DATA);
+}
+
+static void params(void)
+{
+    sw_i2c_cache_t c;
+    uint8_t v = 0;
+    uint32_t xfers = bus.xfers;
+
+    cache_setup(&c);
+    CHECK_EQ(SW_I2C_Cache_Read(NULL, 0x11, &v), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_Cache_Read(&c, 0x11, NULL), SW_I2C_ERR_PARAM);
+    for (uint8_t alen = 0; alen <= 3; alen += 3)
+    {
+        c.alen = alen;
+        CHECK_EQ(SW_I2C_Cache_Read(&c, 0x11, &v), SW_I2C_ERR_PARAM);
+        CHECK_EQ(SW_I2C_Cache_Write(&c, 0x11, 1), SW_I2C_ERR_PARAM);
+        CHECK_EQ(SW_I2C_Cache_Update_Bits(&c, 0x11, 1, 1), SW_I2C_ERR_PARAM);
+        CHECK_EQ(SW_I2C_Cache_Sync(&c), SW_I2C_ERR_PARAM);
+    }
+    c.alen = 1;
+    c.bus = NULL;
+    CHECK_EQ(SW_I2C_Cache_Write(&c, 0x11, 1), SW_I2C_ERR_PARAM);
+    CHECK_EQ(bus.xfers, xfers);
+}
+
+void test_cache(void)
+{
+    sim_bus_init(&bus);
+    sim_regfile_init(&regfile, REG_ADDR);
+    sim_bus_attach(&bus, &regfile.base);
+    SW_I2C_initial(&bus.i2c);
+    SW_I2C_Set_Speed(&bus.i2c, SW_I2C_SPEED_FAST);
+
+    shadow();
+    params();
+}
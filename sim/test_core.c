@@ -0,0 +1,400 @@
+/***
+ * Core transfers: data round trips through every API per edge mode and
+ * clock, combined transactions, NACK reporting, clock stretching,
+ * statistics, prepared programs, read chunking, lock timeouts and buses
+ * sharing a GPIO block (sim_bus_place).
+ */
+
+#include "sw_i2c_test.h"
+#include "sw_i2c_prog.h"
+#include "sw_i2c_wave.h"
+#include "sw_i2c_multi.h"
+
+#define REG_ADDR    0x40
+#define EE_ADDR     0x50
+#define DS_ADDR     0x18
+
+static sim_bus_t bus;
+static sim_regfile_t regfile;
+static sim_eeprom_t eeprom;
+static sim_ds2482_t ds2482;
+static uint8_t ee_mem[4096];
+
+static void fill(uint8_t *p, size_t n, uint8_t seed)
+{
+    for (size_t i = 0; i < n; i++)
+        p[i] = (uint8_t)(seed + i * 13);
+}
+
+static void setup(void)
+{
+    sim_bus_init(&bus);
+    sim_regfile_init(&regfile, REG_ADDR);
+    sim_eeprom_init(&eeprom, EE_ADDR, ee_mem, sizeof(ee_mem), 32, 2, 0);
+    sim_ds2482_init(&ds2482, DS_ADDR);
+    sim_bus_attach(&bus, &regfile.base);
+    sim_bus_attach(&bus, &eeprom.base);
+    sim_bus_attach(&bus, &ds2482.base);
+    SW_I2C_initial(&bus.i2c);
+}
+
+/* Every API moves the right bytes in the given edge mode */
+static void round_trips(int fast, uint32_t flags, uint32_t hz)
+{
+    uint8_t out[64], in[64];
+    double khz;
+
+    sim_bus_use_fast(&bus, fast);
+    bus.i2c.flags = flags;
+    SW_I2C_Calibrate(&bus.i2c);                 // edge cost differs per mode
+    SW_I2C_Set_Speed(&bus.i2c, hz);
+
+    fill(out, sizeof(out), (uint8_t)hz);
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, REG_ADDR << 1, 0x10, 1, out, sizeof(out)), SW_I2C_OK);
+    CHECK_MEM(&regfile.regs[0x10], out, sizeof(out));
+    memset(in, 0, sizeof(in));
+    CHECK_EQ(SW_I2C_Read_Mem(&bus.i2c, REG_ADDR << 1, 0x10, 1, in, sizeof(in)), SW_I2C_OK);
+    CHECK_MEM(in, out, sizeof(in));
+
+    /* one repeated START, one STOP, SCL near the clock (START to STOP window) */
+    CHECK_EQ(bus.last_xfer.starts, 1);
+    CHECK_EQ(bus.last_xfer.stops, 1);
+    khz = bus.last_xfer.scl_edges / 2.0 / (bus.last_xfer.time_ns / 1e6);
+    CHECK(khz <= hz / 1000.0 * 1.03);
+    CHECK(khz >= hz / 1000.0 * 0.80);
+
+    fill(out, 8, 0x5A);
+    CHECK_EQ(SW_I2C_Write_8addr(&bus.i2c, REG_ADDR << 1, 0x80, out, 8), 1);
+    memset(in, 0, 8);
+    CHECK_EQ(SW_I2C_Read_8addr(&bus.i2c, REG_ADDR << 1, 0x80, in, 8), 1);
+    CHECK_MEM(in, out, 8);
+
+    fill(out, 16, 0xA5);
+    CHECK_EQ(SW_I2C_Write_16addr(&bus.i2c, EE_ADDR << 1, 0x0123, out, 16), 1);
+    CHECK_MEM(&ee_mem[0x0123], out, 16);
+    memset(in, 0, 16);
+    CHECK_EQ(SW_I2C_Read_16addr(&bus.i2c, EE_ADDR << 1, 0x0123, in, 16), 1);
+    CHECK_MEM(in, out, 16);
+
+    /* DS2482: reset, then the status register is read without an address */
+    in[0] = 0;
+    out[0] = 0xF0;
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, DS_ADDR << 1, 0, 0, out, 1), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Read_Noaddr(&bus.i2c, DS_ADDR << 1, in, 1), 1);
+    CHECK_EQ(in[0], 0x10);
+
+    CHECK_EQ(SW_I2C_Check_SlaveAddr(&bus.i2c, REG_ADDR << 1), 1);
+    CHECK_EQ(SW_I2C_Check_SlaveAddr(&bus.i2c, 0x22 << 1), 0);
+}
+
+static void combined(void)
+{
+    uint8_t cfg[2] = { 0x20, 0x3C }, reg = 0x20, status = 0, data_reg = 0x30, data[4];
+    sw_i2c_msg_t msgs[] =
+    {
+        { REG_ADDR << 1, 0, 2, cfg },
+        { REG_ADDR << 1, SW_I2C_M_REG, 1, &reg },
+        { REG_ADDR << 1, SW_I2C_M_RD, 1, &status },
+        { REG_ADDR << 1, SW_I2C_M_REG, 1, &data_reg },
+        { REG_ADDR << 1, SW_I2C_M_RD, sizeof(data), data },
+    };
+
+    fill(&regfile.regs[0x30], 4, 0x77);
+    CHECK_EQ(SW_I2C_Transfer(&bus.i2c, msgs, 5), SW_I2C_OK);
+    CHECK_EQ(status, 0x3C);
+    CHECK_MEM(data, &regfile.regs[0x30], sizeof(data));
+    CHECK_EQ(bus.last_xfer.starts, 4);         // repeated
+    CHECK_EQ(bus.last_xfer.stops, 1);
+
+    /* a read cannot continue without START, a segment needs its buffer */
+    msgs[2].flags |= SW_I2C_M_NOSTART;
+    CHECK_EQ(SW_I2C_Transfer(&bus.i2c, msgs, 5), SW_I2C_ERR_PARAM);
+    msgs[2].flags &= ~SW_I2C_M_NOSTART;
+    msgs[4].buf = NULL;
+    CHECK_EQ(SW_I2C_Transfer(&bus.i2c, msgs, 5), SW_I2C_ERR_PARAM);
+}
+
+static void nacks(void)
+{
+    uint8_t out[4] = { 1, 2, 3, 4 };
+    size_t idx = 99;
+
+    CHECK_EQ(SW_I2C_Write_8addr(&bus.i2c, 0x22 << 1, 0x00, out, 4), 0);
+    CHECK_EQ(bus.last_xfer.bytes, 1);          // stopped after the address
+    CHECK_EQ(SW_I2C_Last_Status(&bus.i2c, NULL), SW_I2C_ERR_ADDR_NACK);
+
+    regfile.base.nack_write_at = 0;
+    CHECK_EQ(SW_I2C_Write_8addr(&bus.i2c, REG_ADDR << 1, 0x00, out, 4), 0);
+    CHECK_EQ(SW_I2C_Last_Status(&bus.i2c, NULL), SW_I2C_ERR_REG_NACK);
+
+    regfile.base.nack_write_at = 3;             // register, data 0, data 1, data 2
+    CHECK_EQ(SW_I2C_Write_8addr(&bus.i2c, REG_ADDR << 1, 0x00, out, 4), 0);
+    CHECK_EQ(SW_I2C_Last_Status(&bus.i2c, &idx), SW_I2C_ERR_DATA_NACK);
+    CHECK_EQ(idx, 2);
+    regfile.base.nack_write_at = -1;
+
+    regfile.base.nack_addr = 1;
+    CHECK_EQ(SW_I2C_Write_8addr(&bus.i2c, REG_ADDR << 1, 0x00, out, 4), 0);
+    CHECK_EQ(SW_I2C_Last_Status(&bus.i2c, NULL), SW_I2C_ERR_ADDR_NACK);
+    CHECK_EQ(SW_I2C_Write_8addr(&bus.i2c, REG_ADDR << 1, 0x00, out, 4), 1);
+    CHECK_EQ(SW_I2C_Last_Status(&bus.i2c, NULL), SW_I2C_OK);
+}
+
+static void stretching(void)
+{
+    uint8_t out[8], in[8];
+
+    sim_bus_use_fast(&bus, 1);
+    bus.i2c.flags = SW_I2C_FLAG_OPEN_DRAIN | SW_I2C_FLAG_CLOCK_STRETCH;
+    SW_I2C_Set_Speed(&bus.i2c, SW_I2C_SPEED_FAST);
+    fill(out, sizeof(out), 0x31);
+
+    regfile.base.stretch_ns = 5000;
+    CHECK_EQ(SW_I2C_Write_8addr(&bus.i2c, REG_ADDR << 1, 0x40, out, sizeof(out)), 1);
+    CHECK(bus.last_xfer.stretches > 0);
+    memset(in, 0, sizeof(in));
+    CHECK_EQ(SW_I2C_Read_8addr(&bus.i2c, REG_ADDR << 1, 0x40, in, sizeof(in)), 1);
+    CHECK_MEM(in, out, sizeof(in));
+    CHECK_EQ(bus.i2c.stretch_fault, 0);
+
+    /* a hold beyond the bound fails the transaction, the bus is usable after it */
+    bus.i2c.stretch_timeout_us = 1000;
+    regfile.base.stretch_ns = 20000000;
+    CHECK_EQ(SW_I2C_Write_8addr(&bus.i2c, REG_ADDR << 1, 0x40, out, sizeof(out)), 0);
+    CHECK_EQ(bus.i2c.stretch_fault, 1);
+    CHECK_EQ(SW_I2C_Last_Status(&bus.i2c, NULL), SW_I2C_ERR_STRETCH_TIMEOUT);
+    regfile.base.stretch_ns = 0;
+    sim_advance_ns(20000000);
+    CHECK_EQ(SW_I2C_Read_8addr(&bus.i2c, REG_ADDR << 1, 0x40, in, sizeof(in)), 1);
+    CHECK_MEM(in, out, sizeof(in));
+    bus.i2c.stretch_timeout_us = 0;
+}
+
+/* Per-target counters: reads and writes of one target share a slot, the
+   general call address gets one too; the latency histogram; NACKs and aborts */
+static void stats(void)
+{
+    uint8_t out[4] = { 1, 2, 3, 4 }, in[2], gc = 0x06;
+    sw_i2c_msg_t rd[] = { { (REG_ADDR << 1) | I2C_READ, SW_I2C_M_RD, 2, in } };
+    sw_i2c_msg_t general[] = { { 0x00, 0, 1, &gc } };
+    sw_i2c_stats_t s;
+    const sw_i2c_counters_t *reg, *gen;
+    uint32_t binned = 0;
+    unsigned bin = 0;
+
+    SW_I2C_Stats_Reset(&bus.i2c);
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, REG_ADDR << 1, 0x10, 1, out, 4), SW_I2C_OK);
+    SW_I2C_Stats_Get(&bus.i2c, &s);
+    for (unsigned i = 0; i < SW_I2C_STATS_BINS; i++)
+    {
+        if (s.latency[i])
+            bin = i;
+        binned += s.latency[i];
+    }
+    CHECK_EQ(binned, 1);
+    CHECK(bin > 0 && s.bus.hold_cycles > 0 && s.bus.hold_cycles < (1ull << bin));
+
+    CHECK_EQ(SW_I2C_Transfer(&bus.i2c, rd, 1), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Transfer(&bus.i2c, general, 1), SW_I2C_ERR_ADDR_NACK);
+    CHECK_EQ(SW_I2C_Transfer(&bus.i2c, general, 1), SW_I2C_ERR_ADDR_NACK);
+    regfile.base.nack_write_at = 2;
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, REG_ADDR << 1, 0x10, 1, out, 4), SW_I2C_ERR_DATA_NACK);
+    regfile.base.nack_write_at = -1;
+    bus.i2c.stretch_timeout_us = 1000;
+    regfile.base.stretch_ns = 20000000;
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, REG_ADDR << 1, 0x10, 1, out, 4), SW_I2C_ERR_STRETCH_TIMEOUT);
+    regfile.base.stretch_ns = 0;
+    bus.i2c.stretch_timeout_us = 0;
+    sim_advance_ns(20000000);
+
+    SW_I2C_Stats_Get(&bus.i2c, &s);
+    reg = &s.target[0];
+    gen = &s.target[1];
+    CHECK(reg->used && gen->used && !s.target[2].used);
+    CHECK_EQ(reg->IICID, REG_ADDR << 1);
+    CHECK_EQ(reg->transfers, 4);
+    CHECK_EQ(reg->bytes_in, 2);
+    CHECK_EQ(reg->bytes_out, 5 + 3 + 1);            // register + 4, to the NACK, to the held clock
+    CHECK_EQ(reg->nacks, 1);
+    CHECK_EQ(reg->aborts, 1);
+    CHECK_EQ(gen->IICID, 0x00);
+    CHECK_EQ(gen->transfers, 2);
+    CHECK_EQ(gen->bytes_out, 0);
+    CHECK_EQ(gen->nacks, 2);
+    CHECK_EQ(s.bus.transfers, 6);
+    CHECK_EQ(s.bus.nacks, 3);
+    CHECK_EQ(s.bus.aborts, 1);
+    CHECK_EQ(s.bus.bytes_in, 2);
+    binned = 0;
+    for (unsigned i = 0; i < SW_I2C_STATS_BINS; i++)
+        binned += s.latency[i];
+    CHECK_EQ(binned, 6);
+
+    /* six more addresses fill the table, the last one is not tracked */
+    for (uint8_t a = 0; a < 7; a++)
+        CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, (0x60 + a) << 1, 0x00, 1, out, 1), SW_I2C_ERR_ADDR_NACK);
+    SW_I2C_Stats_Get(&bus.i2c, &s);
+    CHECK(s.target[SW_I2C_STATS_TARGETS - 1].used);
+    CHECK_EQ(s.target[SW_I2C_STATS_TARGETS - 1].IICID, 0x65 << 1);
+    CHECK_EQ(s.untracked, 1);
+    CHECK_EQ(s.bus.transfers, 13);
+
+    SW_I2C_Stats_Reset(&bus.i2c);
+    SW_I2C_Stats_Get(&bus.i2c, &s);
+    CHECK(!s.target[0].used && s.bus.transfers == 0);
+}
+
+/* A prepared register read replays the same transaction on every call */
+static void prepared(void)
+{
+    uint8_t ops[SW_I2C_PROG_OPS(1 + 4, 2)], in[4];
+    sw_i2c_prog_t p = { .ops = ops, .cap = sizeof(ops) };
+
+    sim_bus_use_fast(&bus, 1);
+    bus.i2c.flags = SW_I2C_FLAG_OPEN_DRAIN;
+    SW_I2C_Set_Speed(&bus.i2c, SW_I2C_SPEED_FAST);
+    fill(&regfile.regs[0x60], sizeof(in), 0x44);
+    CHECK_EQ(SW_I2C_Prog_Prepare_Reg_Read(&p, &bus.i2c, REG_ADDR << 1, 0x60, 1, sizeof(in)), SW_I2C_OK);
+    for (int n = 0; n < 2; n++)
+    {
+        memset(in, 0, sizeof(in));
+        CHECK_EQ(SW_I2C_Prog_Replay(&bus.i2c, &p, in), SW_I2C_OK);
+        CHECK_MEM(in, &regfile.regs[0x60], sizeof(in));
+        CHECK_EQ(bus.last_xfer.starts, 1);
+        CHECK_EQ(bus.last_xfer.bytes, 7);           // two addresses, register, data
+        regfile.regs[0x61]++;
+    }
+
+    /* a missing target ends the replay at its address */
+    CHECK_EQ(SW_I2C_Prog_Prepare_Reg_Read(&p, &bus.i2c, 0x22 << 1, 0x60, 1, 1), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Prog_Replay(&bus.i2c, &p, in), SW_I2C_ERR_ADDR_NACK);
+    CHECK_EQ(bus.last_xfer.bytes, 1);
+    CHECK_EQ(SW_I2C_Last_Status(&bus.i2c, NULL), SW_I2C_ERR_ADDR_NACK);
+
+    /* ops too small, and a mode without open-drain SDA */
+    p.cap = 16;
+    CHECK_EQ(SW_I2C_Prog_Prepare_Reg_Read(&p, &bus.i2c, REG_ADDR << 1, 0x60, 1, sizeof(in)), SW_I2C_ERR_PARAM);
+    p.cap = sizeof(ops);
+    bus.i2c.flags = 0;
+    CHECK_EQ(SW_I2C_Prog_Prepare_Reg_Read(&p, &bus.i2c, REG_ADDR << 1, 0x60, 1, sizeof(in)), SW_I2C_ERR_PARAM);
+}
+
+/* chunk_len splits reads only; every entry point gives up on a held lock */
+static void locking(void)
+{
+    uint8_t out[20], in[20], ops[SW_I2C_PROG_OPS(3, 2)];
+    uint32_t wout[SW_I2C_WAVE_TICKS(3, 2)], win[SW_I2C_WAVE_TICKS(3, 2)];
+    uint8_t reg = 0x60;
+    sw_i2c_msg_t msgs[] =
+    {
+        { REG_ADDR << 1, SW_I2C_M_REG, 1, &reg },
+        { REG_ADDR << 1, SW_I2C_M_RD, 2, in },
+    };
+    sw_i2c_msg_t *group_msgs[] = { msgs };
+    sw_i2c_t *group_bus[] = { &bus.i2c };
+    sw_i2c_prog_t p = { .ops = ops, .cap = sizeof(ops) };
+    sw_i2c_wave_t w = { .out = wout, .in = win, .cap = SW_I2C_WAVE_TICKS(3, 2) };
+    sw_i2c_multi_t g;
+    sw_i2c_status_e group_st[1];
+    sw_i2c_stats_t stats;
+    uint32_t xfers;
+
+    sim_bus_use_fast(&bus, 1);
+    bus.i2c.flags = SW_I2C_FLAG_OPEN_DRAIN;
+    SW_I2C_Set_Speed(&bus.i2c, SW_I2C_SPEED_FAST);
+    bus.i2c.chunk_len = 8;
+    fill(out, sizeof(out), 0x42);
+
+    xfers = bus.xfers;
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, REG_ADDR << 1, 0x60, 1, out, sizeof(out)), SW_I2C_OK);
+    CHECK_EQ(bus.xfers - xfers, 1);
+    CHECK_MEM(&regfile.regs[0x60], out, sizeof(out));
+
+    xfers = bus.xfers;
+    memset(in, 0, sizeof(in));
+    CHECK_EQ(SW_I2C_Read_Mem(&bus.i2c, REG_ADDR << 1, 0x60, 1, in, sizeof(in)), SW_I2C_OK);
+    CHECK_EQ(bus.xfers - xfers, 3);
+    CHECK_MEM(in, out, sizeof(in));
+    bus.i2c.chunk_len = 0;
+
+    CHECK_EQ(SW_I2C_Prog_Prepare(&p, &bus.i2c, msgs, 2), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Wave_Compile(&w, &bus.i2c, msgs, 2), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Multi_Init(&g, group_bus, 1), SW_I2C_OK);
+
+    SW_I2C_Stats_Reset(&bus.i2c);
+    bus.i2c.lock_timeout_ms = 5;
+    CHECK_EQ(SW_I2C_Lock(&bus.i2c), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Read_Mem(&bus.i2c, REG_ADDR << 1, 0x60, 1, in, 2), SW_I2C_ERR_LOCK_TIMEOUT);
+    CHECK_EQ(SW_I2C_Prog_Replay(&bus.i2c, &p, in), SW_I2C_ERR_LOCK_TIMEOUT);
+    CHECK_EQ(SW_I2C_Wave_Execute(&bus.i2c, &w, msgs, 2, NULL), SW_I2C_ERR_LOCK_TIMEOUT);
+    CHECK_EQ(SW_I2C_Multi_Transfer(&g, group_msgs, 2, group_st), SW_I2C_ERR_LOCK_TIMEOUT);
+    CHECK_EQ(group_st[0], SW_I2C_ERR_LOCK_TIMEOUT);
+    CHECK_EQ(SW_I2C_Last_Status(&bus.i2c, NULL), SW_I2C_ERR_LOCK_TIMEOUT);
+    SW_I2C_Unlock(&bus.i2c);
+    SW_I2C_Stats_Get(&bus.i2c, &stats);
+    CHECK_EQ(stats.lock_timeouts, 4);
+    bus.i2c.lock_timeout_ms = 0;
+
+    /* and work once it is free */
+    memset(in, 0, 2);
+    CHECK_EQ(SW_I2C_Prog_Replay(&bus.i2c, &p, in), SW_I2C_OK);
+    CHECK_MEM(in, out, 2);
+    memset(in, 0, 2);
+    CHECK_EQ(SW_I2C_Wave_Execute(&bus.i2c, &w, msgs, 2, NULL), SW_I2C_OK);
+    CHECK_MEM(in, out, 2);
+    memset(in, 0, 2);
+    CHECK_EQ(SW_I2C_Multi_Transfer(&g, group_msgs, 2, group_st), SW_I2C_OK);
+    CHECK_MEM(in, out, 2);
+}
+
+/* Two buses on one GPIO block: each store moves only its own pins */
+static void shared_block(void)
+{
+    static sim_bus_t a, b;
+    static sim_regfile_t ra, rb;
+    static gpio_type port;
+    uint8_t out[4] = { 9, 8, 7, 6 }, in[4];
+
+    sim_bus_init(&a);
+    sim_bus_init(&b);
+    sim_regfile_init(&ra, REG_ADDR);
+    sim_regfile_init(&rb, REG_ADDR);
+    sim_bus_attach(&a, &ra.base);
+    sim_bus_attach(&b, &rb.base);
+    sim_bus_place(&a, &port, GPIO_PINS_3, GPIO_PINS_4);
+    sim_bus_place(&b, &port, GPIO_PINS_5, GPIO_PINS_6);
+    a.i2c.flags = b.i2c.flags = SW_I2C_FLAG_OPEN_DRAIN;
+    SW_I2C_initial(&a.i2c);
+    SW_I2C_initial(&b.i2c);
+    sim_bus_use_fast(&a, 1);
+    sim_bus_use_fast(&b, 1);
+
+    CHECK_EQ(SW_I2C_Write_Mem(&a.i2c, REG_ADDR << 1, 0x00, 1, out, 4), SW_I2C_OK);
+    CHECK_MEM(ra.regs, out, 4);
+    CHECK_EQ(rb.regs[0], 0);
+    CHECK_EQ(b.stats.scl_edges, 0);
+    CHECK_EQ(SW_I2C_Read_Mem(&b.i2c, REG_ADDR << 1, 0x00, 1, in, 4), SW_I2C_OK);
+    CHECK_EQ(in[0], 0);
+    CHECK_EQ(port.idt & (GPIO_PINS_3 | GPIO_PINS_4 | GPIO_PINS_5 | GPIO_PINS_6),
+             GPIO_PINS_3 | GPIO_PINS_4 | GPIO_PINS_5 | GPIO_PINS_6);
+}
+
+void test_core(void)
+{
+    static const uint32_t clocks[] = { SW_I2C_SPEED_STANDARD, SW_I2C_SPEED_FAST, SW_I2C_SPEED_FAST_PLUS };
+
+    setup();
+    for (unsigned c = 0; c < sizeof(clocks) / sizeof(clocks[0]); c++)
+    {
+        round_trips(0, 0, clocks[c]);
+        round_trips(1, 0, clocks[c]);
+        round_trips(1, SW_I2C_FLAG_OPEN_DRAIN, clocks[c]);
+    }
+    combined();
+    nacks();
+    stretching();
+    stats();
+    prepared();
+    locking();
+    shared_block();
+}
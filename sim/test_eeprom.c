@@ -0,0 +1,110 @@
+/***
+ * 24Cxx EEPROM layer: page split writes, ACK polling on the write cycle,
+ * block select addressing and argument checks.
+ */
+
+#include "sw_i2c_test.h"
+#include "sw_i2c_eeprom.h"
+
+static sim_bus_t bus;
+static sim_eeprom_t big, blk0, blk1;
+static uint8_t big_mem[4096], blk0_mem[256], blk1_mem[256];
+
+static void fill(uint8_t *p, size_t n, uint8_t seed)
+{
+    for (size_t i = 0; i < n; i++)
+        p[i] = (uint8_t)(seed + i * 7);
+}
+
+/* 24C32: two address bytes, 32-byte pages, 3 ms write cycle */
+static void paging(void)
+{
+    sw_i2c_eeprom_t e = { &bus.i2c, 0xA0, 2, 32, sizeof(big_mem), 0, 0 };
+    uint8_t out[100], in[100];
+    uint64_t t0, took;
+    uint32_t starts;
+
+    fill(out, sizeof(out), 0x11);
+    bus.i2c.chunk_len = 8;                      // never splits a page write
+    starts = bus.stats.starts;
+    t0 = sim_now_ns();
+    CHECK_EQ(SW_I2C_EEPROM_Write(&e, 20, out, sizeof(out)), SW_I2C_OK);
+    took = sim_now_ns() - t0;
+    CHECK_EQ(big.pages_written, 4);             // 12 + 32 + 32 + 24
+    CHECK_MEM(&big_mem[20], out, sizeof(out));
+    CHECK_EQ(big_mem[19], 0);
+    CHECK_EQ(big_mem[120], 0);
+
+    /* polled: four cycles plus about 3 ms on the wire, not 4 x 10 ms */
+    CHECK(took >= 4 * 3000000ULL);
+    CHECK(took < 4 * 3000000ULL + 4000000ULL);
+    /* one probe per poll_ms tick: the page write and up to four probes each */
+    CHECK(bus.stats.starts - starts <= 4 * 5);
+    CHECK(sim_now_ns() >= big.busy_until);
+
+    memset(in, 0, sizeof(in));
+    CHECK_EQ(SW_I2C_EEPROM_Read(&e, 20, in, sizeof(in)), SW_I2C_OK);
+    CHECK_MEM(in, out, sizeof(in));
+    bus.i2c.chunk_len = 0;
+
+    /* a cycle longer than write_timeout_ms */
+    big.write_ns = 30000000;
+    e.write_timeout_ms = 5;
+    CHECK_EQ(SW_I2C_EEPROM_Write(&e, 0, out, 4), SW_I2C_ERR_ADDR_NACK);
+    CHECK_EQ(SW_I2C_EEPROM_Read(&e, 0, in, 4), SW_I2C_ERR_ADDR_NACK);
+    sim_advance_ns(30000000);
+    CHECK_EQ(SW_I2C_EEPROM_Wait_Ready(&e), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_EEPROM_Read(&e, 0, in, 4), SW_I2C_OK);
+    CHECK_MEM(in, out, 4);
+    big.write_ns = 3000000;
+}
+
+/* 24C04: one address byte, memory bit 8 in the device address */
+static void blocks(void)
+{
+    sw_i2c_eeprom_t e = { &bus.i2c, 0xA4, 1, 16, 512, 0, 0 };     // A1 pin high
+    uint8_t out[24], in[24];
+
+    fill(out, sizeof(out), 0x80);
+    CHECK_EQ(SW_I2C_EEPROM_Write(&e, 244, out, sizeof(out)), SW_I2C_OK);
+    CHECK_MEM(&blk0_mem[244], out, 12);
+    CHECK_MEM(&blk1_mem[0], out + 12, 12);
+    memset(in, 0, sizeof(in));
+    CHECK_EQ(SW_I2C_EEPROM_Read(&e, 244, in, sizeof(in)), SW_I2C_OK);
+    CHECK_MEM(in, out, sizeof(in));
+}
+
+static void params(void)
+{
+    sw_i2c_eeprom_t e = { &bus.i2c, 0xA0, 2, 32, sizeof(big_mem), 0, 0 };
+    sw_i2c_eeprom_t no_bus = { NULL, 0xA0, 2, 32, sizeof(big_mem), 0, 0 };
+    uint8_t buf[4] = { 0 };
+
+    CHECK_EQ(SW_I2C_EEPROM_Read(NULL, 0, buf, 4), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_EEPROM_Write(NULL, 0, buf, 4), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_EEPROM_Wait_Ready(NULL), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_EEPROM_Wait_Ready(&no_bus), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_EEPROM_Read(&no_bus, 0, buf, 4), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_EEPROM_Read(&e, sizeof(big_mem) - 2, buf, 4), SW_I2C_ERR_PARAM);
+    e.addr_bytes = 3;
+    CHECK_EQ(SW_I2C_EEPROM_Read(&e, 0, buf, 4), SW_I2C_ERR_PARAM);
+}
+
+void test_eeprom(void)
+{
+    sim_bus_init(&bus);
+    sim_eeprom_init(&big, 0x50, big_mem, sizeof(big_mem), 32, 2, 3000000);
+    /* the blocks of one chip as two models: no write cycle, as the
+     * polled address (block 0) would not see the other one busy */
+    sim_eeprom_init(&blk0, 0x52, blk0_mem, sizeof(blk0_mem), 16, 1, 0);
+    sim_eeprom_init(&blk1, 0x53, blk1_mem, sizeof(blk1_mem), 16, 1, 0);
+    sim_bus_attach(&bus, &big.base);
+    sim_bus_attach(&bus, &blk0.base);
+    sim_bus_attach(&bus, &blk1.base);
+    SW_I2C_initial(&bus.i2c);
+    SW_I2C_Set_Speed(&bus.i2c, SW_I2C_SPEED_FAST);
+
+    paging();
+    blocks();
+    params();
+}
@@ -0,0 +1,143 @@
+/***
+ * C++ bus (sw_i2c.hpp): SoftI2c instantiated on a port whose set/clear/
+ * input go to the simulated GPIO registers and whose delays advance
+ * virtual time, checked for data, NACK reporting, clock stretching and
+ * phase times at each speed profile.
+ */
+
+#include "sw_i2c_test.h"
+#include "sw_i2c.hpp"
+
+#define REG_ADDR    0x40
+
+static sim_bus_t bus;
+static sim_regfile_t regfile;
+
+/* Port of sw_i2c.hpp on the simulated lines; edges cost no wait */
+struct SimPort
+{
+    static gpio_type *g;
+
+    static void set(uint32_t pins) { SW_I2C_REG_WRITE(&g->scr, pins); }
+    static void clear(uint32_t pins) { SW_I2C_REG_WRITE(&g->clr, pins); }
+    static uint32_t input() { return SW_I2C_REG_READ(&g->idt); }
+    template<uint32_t Ns> static void delay() { sim_advance_ns(Ns); }
+    static constexpr uint32_t wait_trim_ns = 0;
+};
+
+gpio_type *SimPort::g;
+
+template<class Speed, uint32_t Flags = 0>
+using SimBus = sw_i2c::SoftI2c<SimPort, GPIO_PINS_0, GPIO_PINS_1, Speed, Flags>;
+
+template<class B>
+static void data(void)
+{
+    uint8_t out[8], in[8], reg = 0x10;
+    sw_i2c_msg_t msgs[] =
+    {
+        { REG_ADDR << 1, SW_I2C_M_REG, 1, &reg },
+        { REG_ADDR << 1, SW_I2C_M_RD, 4, in },
+    };
+
+    for (unsigned i = 0; i < sizeof(out); i++)
+        out[i] = (uint8_t)(B::timing.low_ns + i * 3);
+    sim_bus_reset_stats(&bus);
+
+    CHECK_EQ(B::write_mem(REG_ADDR << 1, 0x10, 1, out, sizeof(out)), SW_I2C_OK);
+    CHECK_MEM(&regfile.regs[0x10], out, sizeof(out));
+    memset(in, 0, sizeof(in));
+    CHECK_EQ(B::read_mem(REG_ADDR << 1, 0x10, 1, in, sizeof(in)), SW_I2C_OK);
+    CHECK_MEM(in, out, sizeof(in));
+    CHECK_EQ(bus.last_xfer.starts, 1);                  // repeated
+    CHECK_EQ(bus.last_xfer.bytes, 3 + sizeof(in));
+    CHECK_EQ(bus.last_xfer.acks, 3 + sizeof(in) - 1);     // all but the last read byte
+
+    memset(in, 0, sizeof(in));
+    CHECK_EQ(B::transfer(msgs, 2), SW_I2C_OK);
+    CHECK_MEM(in, out, 4);
+    CHECK_EQ(in[4], 0);
+    CHECK_EQ(bus.xfers, 3);
+
+    /* phases at least the spec minimums of the profile */
+    CHECK(bus.tmin.low_ns >= B::timing.low_ns);
+    CHECK(bus.tmin.high_ns >= B::timing.high_ns);
+    CHECK(bus.tmin.su_sta_ns >= B::timing.su_sta_ns);
+    CHECK(bus.tmin.hd_sta_ns >= B::timing.hd_sta_ns);
+    CHECK(bus.tmin.su_sto_ns >= B::timing.su_sto_ns);
+    CHECK(bus.tmin.buf_ns >= B::timing.buf_ns);
+}
+
+template<class B>
+static void failures(void)
+{
+    uint8_t reg = 0x20, out[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    sw_i2c_msg_t msgs[] =
+    {
+        { REG_ADDR << 1, SW_I2C_M_REG, 1, &reg },
+        { REG_ADDR << 1, SW_I2C_M_NOSTART, 8, out },
+    };
+    sw_i2c_msg_t block[] = { { REG_ADDR << 1, SW_I2C_M_RD | SW_I2C_M_RECV_LEN, 8, out } };
+    size_t idx = 99;
+
+    CHECK_EQ(B::probe(REG_ADDR << 1), SW_I2C_OK);
+    CHECK_EQ(B::probe(0x22 << 1), SW_I2C_ERR_ADDR_NACK);
+    CHECK_EQ(bus.last_xfer.stops, 1);
+
+    regfile.base.nack_write_at = 3;                     // out[2]
+    CHECK_EQ(B::transfer(msgs, 2, &idx), SW_I2C_ERR_DATA_NACK);
+    CHECK_EQ(idx, 2);
+    regfile.base.nack_write_at = 0;
+    CHECK_EQ(B::transfer(msgs, 2, &idx), SW_I2C_ERR_REG_NACK);
+    regfile.base.nack_write_at = -1;
+
+    CHECK_EQ(B::transfer(block, 1), SW_I2C_ERR_PARAM);
+    CHECK_EQ(B::read_mem(REG_ADDR << 1, 0, 3, out, 1), SW_I2C_ERR_PARAM);
+
+    /* SDA held low by someone else */
+    bus.i2c.hal_io_ctl(HAL_IO_OPT_SET_SDA_LOW, &bus.i2c);
+    CHECK_EQ(B::probe(REG_ADDR << 1), SW_I2C_ERR_BUS_BUSY);
+    bus.i2c.hal_io_ctl(HAL_IO_OPT_SET_SDA_HIGH, &bus.i2c);
+    CHECK_EQ(B::probe(REG_ADDR << 1), SW_I2C_OK);
+}
+
+static void stretching(void)
+{
+    using Stretch = SimBus<sw_i2c::Fast, SW_I2C_FLAG_CLOCK_STRETCH>;
+    uint8_t out[4] = { 0xDE, 0xAD, 0xBE, 0xEF }, in[4];
+
+    regfile.base.stretch_ns = 3000;
+    CHECK_EQ(Stretch::write_mem(REG_ADDR << 1, 0x30, 1, out, 4), SW_I2C_OK);
+    CHECK(bus.last_xfer.stretches > 0);
+    memset(in, 0, sizeof(in));
+    CHECK_EQ(Stretch::read_mem(REG_ADDR << 1, 0x30, 1, in, 4), SW_I2C_OK);
+    CHECK_MEM(in, out, 4);
+
+    /* beyond SW_I2C_STRETCH_TIMEOUT_US; the C API recovers the bus after it */
+    regfile.base.stretch_ns = 2 * SW_I2C_STRETCH_TIMEOUT_US * 1000;
+    CHECK_EQ(Stretch::write_mem(REG_ADDR << 1, 0x30, 1, out, 4), SW_I2C_ERR_STRETCH_TIMEOUT);
+    regfile.base.stretch_ns = 0;
+    sim_advance_ns(2 * SW_I2C_STRETCH_TIMEOUT_US * 1000);
+    CHECK_EQ(SW_I2C_Recover(&bus.i2c), SW_I2C_OK);
+    CHECK_EQ(Stretch::read_mem(REG_ADDR << 1, 0x30, 1, in, 4), SW_I2C_OK);
+    CHECK_MEM(in, out, 4);
+}
+
+void test_hpp(void)
+{
+    sim_bus_init(&bus);
+    sim_regfile_init(&regfile, REG_ADDR);
+    sim_bus_attach(&bus, &regfile.base);
+    bus.i2c.flags = SW_I2C_FLAG_OPEN_DRAIN;
+    SW_I2C_initial(&bus.i2c);
+    sim_bus_use_fast(&bus, 1);
+    SimPort::g = bus.i2c.scl_port;
+    CHECK_EQ(bus.i2c.scl_pin, GPIO_PINS_0);
+    CHECK_EQ(bus.i2c.sda_pin, GPIO_PINS_1);
+
+    data<SimBus<sw_i2c::Standard>>();
+    data<SimBus<sw_i2c::Fast>>();
+    data<SimBus<sw_i2c::FastPlus>>();
+    failures<SimBus<sw_i2c::Fast>>();
+    stretching();
+}
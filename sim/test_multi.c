@@ -0,0 +1,194 @@
+/***
+ * Lockstep engine: three buses on one GPIO port run one transaction shape
+ * at once, each with its own data; a failing bus drops out and the others
+ * finish.
+ */
+
+#include "sw_i2c_test.h"
+#include "sw_i2c_multi.h"
+
+#define REG_ADDR    0x40
+#define BUSES       3
+
+static sim_bus_t bus[BUSES];
+static sim_regfile_t regfile[BUSES];
+static gpio_type port;
+static sw_i2c_t *group_bus[BUSES];
+
+/* Per-bus data, written in lockstep and read back */
+static void data(sw_i2c_multi_t *g)
+{
+    uint8_t wr[BUSES][3], in[BUSES][2], *pdata[BUSES];
+    sw_i2c_msg_t m[BUSES][1], *msgs[BUSES];
+    sw_i2c_status_e st[BUSES];
+    uint64_t t0, group_ns, single_ns;
+
+    for (int i = 0; i < BUSES; i++)
+    {
+        wr[i][0] = 0x10;
+        wr[i][1] = (uint8_t)(0x11 * (i + 1));
+        wr[i][2] = (uint8_t)(0xF0 - i);
+        m[i][0] = (sw_i2c_msg_t){ REG_ADDR << 1, 0, 3, wr[i] };
+        msgs[i] = m[i];
+        pdata[i] = in[i];
+        sim_bus_reset_stats(&bus[i]);
+    }
+    CHECK_EQ(SW_I2C_Multi_Transfer(g, msgs, 1, st), SW_I2C_OK);
+    for (int i = 0; i < BUSES; i++)
+    {
+        CHECK_EQ(st[i], SW_I2C_OK);
+        CHECK_MEM(&regfile[i].regs[0x10], &wr[i][1], 2);
+        CHECK_EQ(bus[i].xfers, 1);
+    }
+
+    memset(in, 0, sizeof(in));
+    t0 = sim_now_ns();
+    CHECK_EQ(SW_I2C_Multi_Read_Mem(g, REG_ADDR << 1, 0x10, 1, pdata, 2, st), SW_I2C_OK);
+    group_ns = sim_now_ns() - t0;
+    for (int i = 0; i < BUSES; i++)
+    {
+        CHECK_EQ(st[i], SW_I2C_OK);
+        CHECK_MEM(in[i], &wr[i][1], 2);
+        CHECK_EQ(bus[i].xfers, 2);
+        CHECK_EQ(bus[i].last_xfer.starts, 1);          // repeated
+        CHECK_EQ(bus[i].last_xfer.bytes, 5);
+        CHECK_EQ(bus[i].last_xfer.scl_edges, bus[0].last_xfer.scl_edges);
+    }
+
+    /* one group read costs about one bus read, not three */
+    t0 = sim_now_ns();
+    CHECK_EQ(SW_I2C_Read_Mem(&bus[0].i2c, REG_ADDR << 1, 0x10, 1, in[0], 2), SW_I2C_OK);
+    single_ns = sim_now_ns() - t0;
+    CHECK(group_ns < single_ns + single_ns / 2);
+}
+
+/* A failure keeps to its bus */
+static void failures(sw_i2c_multi_t *g)
+{
+    uint8_t in[BUSES][2], *pdata[BUSES], wr[3] = { 0x20, 0xAB, 0xCD };
+    uint8_t wr4[4] = { 0x30, 0x5A, 0xA5, 0x3C }, before[256];
+    sw_i2c_msg_t m[BUSES][1], *msgs[BUSES];
+    sw_i2c_status_e st[BUSES];
+    size_t idx = 0;
+
+    for (int i = 0; i < BUSES; i++)
+    {
+        pdata[i] = in[i];
+        m[i][0] = (sw_i2c_msg_t){ REG_ADDR << 1, 0, 3, wr };
+        msgs[i] = m[i];
+    }
+
+    /* bus 1 has no target at the address */
+    regfile[1].base.nack_addr = 1;
+    memset(in, 0, sizeof(in));
+    CHECK_EQ(SW_I2C_Multi_Read_Mem(g, REG_ADDR << 1, 0x10, 1, pdata, 2, st), SW_I2C_ERR_ADDR_NACK);
+    CHECK_EQ(st[0], SW_I2C_OK);
+    CHECK_EQ(st[1], SW_I2C_ERR_ADDR_NACK);
+    CHECK_EQ(st[2], SW_I2C_OK);
+    CHECK_EQ(in[0][0], 0x11);
+    CHECK_EQ(in[1][0], 0);
+    CHECK_EQ(in[2][0], 0x33);
+    CHECK_EQ(SW_I2C_Last_Status(&bus[1].i2c, NULL), SW_I2C_ERR_ADDR_NACK);
+    CHECK_EQ(bus[1].last_xfer.stops, 1);
+
+    /* bus 2 NACKs the second data byte */
+    regfile[2].base.nack_write_at = 2;
+    CHECK_EQ(SW_I2C_Multi_Transfer(g, msgs, 1, st), SW_I2C_ERR_DATA_NACK);
+    regfile[2].base.nack_write_at = -1;
+    CHECK_EQ(st[0], SW_I2C_OK);
+    CHECK_EQ(st[1], SW_I2C_OK);
+    CHECK_EQ(st[2], SW_I2C_ERR_DATA_NACK);
+    CHECK_EQ(SW_I2C_Last_Status(&bus[2].i2c, &idx), SW_I2C_ERR_DATA_NACK);
+    CHECK_EQ(idx, 2);
+    CHECK_EQ(regfile[1].regs[0x21], 0xCD);
+    CHECK_EQ(regfile[2].regs[0x21], 0);                 // NACKed, not stored
+
+    /* bus 2 NACKs the first of three data bytes and keeps listening: the
+       STOP it gets right away keeps the rest off its registers */
+    memcpy(before, regfile[2].regs, sizeof(before));
+    for (int i = 0; i < BUSES; i++)
+    {
+        m[i][0] = (sw_i2c_msg_t){ REG_ADDR << 1, 0, 4, wr4 };
+        sim_bus_reset_stats(&bus[i]);
+    }
+    regfile[2].base.nack_write_at = 1;
+    CHECK_EQ(SW_I2C_Multi_Transfer(g, msgs, 1, st), SW_I2C_ERR_DATA_NACK);
+    regfile[2].base.nack_write_at = -1;
+    CHECK_EQ(st[0], SW_I2C_OK);
+    CHECK_EQ(st[2], SW_I2C_ERR_DATA_NACK);
+    CHECK_EQ(SW_I2C_Last_Status(&bus[2].i2c, &idx), SW_I2C_ERR_DATA_NACK);
+    CHECK_EQ(idx, 1);
+    CHECK_MEM(&regfile[0].regs[0x30], &wr4[1], 3);
+    CHECK_MEM(regfile[2].regs, before, sizeof(before));
+    CHECK_EQ(bus[2].last_xfer.stops, 1);
+    CHECK_EQ(bus[2].last_xfer.bytes, 3);                 // address, register, NACKed byte
+    CHECK(bus[2].stats.scl_edges < bus[0].stats.scl_edges);            // own SCL stopped
+
+    /* a register NACK: no repeated START for bus 1, so the address and read
+       clocks must not reach it as writes */
+    memcpy(before, regfile[1].regs, sizeof(before));
+    regfile[1].base.nack_write_at = 0;
+    CHECK_EQ(SW_I2C_Multi_Read_Mem(g, REG_ADDR << 1, 0x10, 1, pdata, 2, st), SW_I2C_ERR_REG_NACK);
+    regfile[1].base.nack_write_at = -1;
+    CHECK_EQ(st[0], SW_I2C_OK);
+    CHECK_EQ(st[1], SW_I2C_ERR_REG_NACK);
+    CHECK_EQ(st[2], SW_I2C_OK);
+    CHECK_MEM(regfile[1].regs, before, sizeof(before));
+    CHECK_EQ(bus[1].last_xfer.stops, 1);
+}
+
+static void params(sw_i2c_multi_t *g)
+{
+    static gpio_type other;
+    static sim_bus_t elsewhere;
+    sw_i2c_t *mixed[] = { &bus[0].i2c, &elsewhere.i2c };
+    sw_i2c_t *unset[] = { NULL, &bus[0].i2c };
+    uint8_t a[1] = { 0 }, b[2] = { 0 };
+    sw_i2c_msg_t ma[] = { { REG_ADDR << 1, SW_I2C_M_RD, 1, a } };
+    sw_i2c_msg_t mb[] = { { REG_ADDR << 1, SW_I2C_M_RD, 2, b } };
+    sw_i2c_msg_t *shape[] = { ma, mb, ma };
+    sw_i2c_status_e st[BUSES];
+    sw_i2c_multi_t h;
+
+    sim_bus_init(&elsewhere);
+    sim_bus_place(&elsewhere, &other, GPIO_PINS_3, GPIO_PINS_4);
+    elsewhere.i2c.flags = SW_I2C_FLAG_OPEN_DRAIN;
+    SW_I2C_initial(&elsewhere.i2c);
+    sim_bus_use_fast(&elsewhere, 1);
+
+    CHECK_EQ(SW_I2C_Multi_Init(&h, mixed, 2), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_Multi_Init(&h, group_bus, 0), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_Multi_Init(&h, unset, 2), SW_I2C_ERR_PARAM);
+    bus[1].i2c.flags = 0;
+    CHECK_EQ(SW_I2C_Multi_Init(&h, group_bus, BUSES), SW_I2C_ERR_PARAM);
+    bus[1].i2c.flags = SW_I2C_FLAG_OPEN_DRAIN;
+    CHECK_EQ(SW_I2C_Multi_Transfer(g, shape, 1, st), SW_I2C_ERR_PARAM);
+}
+
+void test_multi(void)
+{
+    static const uint32_t pins[BUSES][2] =
+    {
+        { GPIO_PINS_3, GPIO_PINS_4 }, { GPIO_PINS_5, GPIO_PINS_6 }, { GPIO_PINS_7, GPIO_PINS_8 },
+    };
+    sw_i2c_multi_t g;
+
+    for (int i = 0; i < BUSES; i++)
+    {
+        sim_bus_init(&bus[i]);
+        sim_regfile_init(&regfile[i], REG_ADDR);
+        sim_bus_attach(&bus[i], &regfile[i].base);
+        sim_bus_place(&bus[i], &port, pins[i][0], pins[i][1]);
+        bus[i].i2c.flags = SW_I2C_FLAG_OPEN_DRAIN;
+        SW_I2C_initial(&bus[i].i2c);
+        sim_bus_use_fast(&bus[i], 1);
+        SW_I2C_Calibrate(&bus[i].i2c);
+        SW_I2C_Set_Speed(&bus[i].i2c, SW_I2C_SPEED_FAST);
+        group_bus[i] = &bus[i].i2c;
+    }
+    CHECK_EQ(SW_I2C_Multi_Init(&g, group_bus, BUSES), SW_I2C_OK);
+
+    data(&g);
+    failures(&g);
+    params(&g);
+}
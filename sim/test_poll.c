@@ -0,0 +1,137 @@
+/***
+ * Poll scheduler: earliest deadline first among due blocks, merged reads
+ * of bordering blocks, periods and deadline misses on the virtual tick
+ * count, and the sequence-counted snapshots.
+ */
+
+#include "sw_i2c_test.h"
+#include "sw_i2c_poll.h"
+
+#define REG_ADDR    0x40
+
+static sim_bus_t bus;
+static sim_regfile_t regfile;
+
+static void ticks_until(TickType_t t)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    if ((int32_t)(t - now) > 0)
+        vTaskDelay(t - now);
+}
+
+static void schedule(void)
+{
+    sw_i2c_poll_t p;
+    sw_i2c_poll_item_t a = { .IICID = REG_ADDR << 1, .regaddr = 0x00, .alen = 1, .len = 4, .period_ms = 10 };
+    sw_i2c_poll_item_t b = { .IICID = REG_ADDR << 1, .regaddr = 0x04, .alen = 1, .len = 4, .period_ms = 10 };
+    sw_i2c_poll_item_t c = { .IICID = REG_ADDR << 1, .regaddr = 0x20, .alen = 1, .len = 2, .period_ms = 25, .deadline_ms = 5 };
+    uint8_t in[SW_I2C_POLL_MAX_LEN];
+    TickType_t t0, sleep, stamp;
+    uint32_t c_reads = 0, c_seq;
+
+    for (int i = 0; i < 8; i++)
+        regfile.regs[i] = (uint8_t)(0x10 + i);
+    regfile.regs[0x20] = 0xC0;
+    regfile.regs[0x21] = 0xC1;
+
+    CHECK_EQ(SW_I2C_Poll_Init(&p, &bus.i2c), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Poll_Add(&p, &a), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Poll_Add(&p, &b), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Poll_Add(&p, &c), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Poll_Get(&a, in, NULL), SW_I2C_ERR_NO_DATA);
+
+    /* c has the earliest deadline, a and b share one transfer after it */
+    t0 = xTaskGetTickCount();
+    sim_bus_reset_stats(&bus);
+    sleep = SW_I2C_Poll_Run(&p);
+    CHECK_EQ(p.reads, 2);
+    CHECK_EQ(p.coalesced, 1);
+    CHECK_EQ(bus.xfers, 2);
+    CHECK_EQ(bus.last_xfer.bytes, 3 + 8);
+    CHECK(sleep >= 9 && sleep <= 10);
+
+    CHECK_EQ(SW_I2C_Poll_Get(&a, in, &stamp), SW_I2C_OK);
+    CHECK_MEM(in, regfile.regs, 4);
+    CHECK(stamp - t0 <= 1);                             // tick count at the end of the read
+    CHECK_EQ(SW_I2C_Poll_Get(&b, in, NULL), SW_I2C_OK);
+    CHECK_MEM(in, &regfile.regs[4], 4);
+    CHECK_EQ(SW_I2C_Poll_Get(&c, in, NULL), SW_I2C_OK);
+    CHECK_EQ(in[1], 0xC1);
+
+    /* 100 ms: a and b every 10 ms in one read, c every 25 ms */
+    c_seq = c.seq;
+    while ((int32_t)(xTaskGetTickCount() - (t0 + 100)) < 0)
+    {
+        vTaskDelay(sleep);
+        sleep = SW_I2C_Poll_Run(&p);
+        c_reads += c.seq != c_seq;
+        c_seq = c.seq;
+    }
+    CHECK_EQ(a.seq, 11);
+    CHECK_EQ(b.seq, 11);
+    CHECK_EQ(c.seq, 5);
+    CHECK_EQ(c_reads, 4);
+    CHECK_EQ(p.reads, 11 + 5);
+    CHECK_EQ(p.coalesced, 11);
+    CHECK_EQ(a.misses + b.misses + c.misses, 0);
+    CHECK_EQ(c.release, t0 + 125);
+
+    /* new data in the current slot, the previous one left intact */
+    regfile.regs[0] = 0x99;
+    ticks_until(a.release);
+    SW_I2C_Poll_Run(&p);
+    CHECK_EQ(SW_I2C_Poll_Get(&a, in, &stamp), SW_I2C_OK);
+    CHECK_EQ(in[0], 0x99);
+    CHECK(stamp - (a.release - 10) <= 1);               // released 10 ticks after the read
+    CHECK_EQ(a.data[(a.seq + 1) & 1][0], 0x10);
+
+    /* run late: c past its deadline, released again from now */
+    ticks_until(c.release + 7);
+    SW_I2C_Poll_Run(&p);
+    CHECK_EQ(c.misses, 1);
+    CHECK((int32_t)(c.release - xTaskGetTickCount()) > 0);
+
+    /* a failed read is published with its status */
+    regfile.base.nack_addr = 8;
+    ticks_until(c.release);
+    SW_I2C_Poll_Run(&p);
+    regfile.base.nack_addr = 0;
+    CHECK_EQ(SW_I2C_Poll_Get(&c, in, NULL), SW_I2C_ERR_ADDR_NACK);
+}
+
+static void params(void)
+{
+    sw_i2c_poll_t p;
+    sw_i2c_poll_item_t it = { .IICID = REG_ADDR << 1, .alen = 1, .len = 4, .period_ms = 10 };
+    uint8_t in[4];
+
+    CHECK_EQ(SW_I2C_Poll_Init(NULL, &bus.i2c), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_Poll_Init(&p, NULL), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_Poll_Init(&p, &bus.i2c), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Poll_Run(&p), SW_I2C_POLL_IDLE_MS);
+    it.len = 0;
+    CHECK_EQ(SW_I2C_Poll_Add(&p, &it), SW_I2C_ERR_PARAM);
+    it.len = SW_I2C_POLL_MAX_LEN + 1;
+    CHECK_EQ(SW_I2C_Poll_Add(&p, &it), SW_I2C_ERR_PARAM);
+    it.len = 4;
+    it.alen = 3;
+    CHECK_EQ(SW_I2C_Poll_Add(&p, &it), SW_I2C_ERR_PARAM);
+    it.alen = 1;
+    it.period_ms = 0;
+    CHECK_EQ(SW_I2C_Poll_Add(&p, &it), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_Poll_Get(NULL, in, NULL), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_Poll_Get(&it, NULL, NULL), SW_I2C_ERR_PARAM);
+}
+
+void test_poll(void)
+{
+    sim_bus_init(&bus);
+    sim_regfile_init(&regfile, REG_ADDR);
+    sim_bus_attach(&bus, &regfile.base);
+    SW_I2C_initial(&bus.i2c);
+    SW_I2C_Set_Speed(&bus.i2c, SW_I2C_SPEED_FAST);
+
+    schedule();
+    params();
+}
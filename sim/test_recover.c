@@ -0,0 +1,168 @@
+/***
+ * Bus recovery: a target left driving SDA by an abandoned read is clocked
+ * free, explicitly, at init and before the next transaction; a held SCL
+ * is reported as a failed recovery. Prepared replays recover the same way.
+ */
+
+#include "sw_i2c_test.h"
+#include "sw_i2c_prog.h"
+
+#define REG_ADDR    0x40
+
+static sim_bus_t bus;
+static sim_regfile_t regfile;
+
+static void line(hal_io_opt_e opt)
+{
+    bus.i2c.hal_io_ctl(opt, &bus.i2c);
+    sim_advance_ns(2500);
+}
+
+/* START, read address, then the controller stops after bits of a 0x00 byte */
+static void abandon_read(int bits)
+{
+    uint8_t addr = (REG_ADDR << 1) | 1;
+
+    regfile.ptr = 0x00;
+    line(HAL_IO_OPT_SET_SDA_LOW);
+    line(HAL_IO_OPT_SET_SCL_LOW);
+    for (int x = 7; x >= -1; x--)
+    {
+        line(x >= 0 && !(addr & (1 << x)) ? HAL_IO_OPT_SET_SDA_LOW : HAL_IO_OPT_SET_SDA_HIGH);
+        line(HAL_IO_OPT_SET_SCL_HIGH);
+        line(HAL_IO_OPT_SET_SCL_LOW);
+    }
+    line(HAL_IO_OPT_SET_SDA_HIGH);
+    for (int x = 0; x < bits; x++)
+    {
+        line(HAL_IO_OPT_SET_SCL_HIGH);
+        line(HAL_IO_OPT_SET_SCL_LOW);
+    }
+    line(HAL_IO_OPT_SET_SCL_HIGH);
+}
+
+static void stuck_sda(void)
+{
+    uint8_t out[2] = { 0x12, 0x34 }, in[2];
+    uint32_t rec = bus.i2c.recoveries;
+
+    regfile.regs[0x00] = 0;
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, REG_ADDR << 1, 0x10, 1, out, 2), SW_I2C_OK);
+
+    /* explicit */
+    abandon_read(3);
+    CHECK_EQ(bus.sda, 0);
+    CHECK_EQ(SW_I2C_Recover(&bus.i2c), SW_I2C_OK);
+    CHECK_EQ(bus.i2c.recoveries, rec + 1);
+    CHECK_EQ(bus.scl, 1);
+    CHECK_EQ(bus.sda, 1);
+    memset(in, 0, sizeof(in));
+    CHECK_EQ(SW_I2C_Read_Mem(&bus.i2c, REG_ADDR << 1, 0x10, 1, in, 2), SW_I2C_OK);
+    CHECK_MEM(in, out, 2);
+    CHECK_EQ(bus.i2c.recoveries, rec + 1);
+
+    /* before the next transaction, which then runs normally */
+    abandon_read(6);
+    memset(in, 0, sizeof(in));
+    CHECK_EQ(SW_I2C_Read_Mem(&bus.i2c, REG_ADDR << 1, 0x10, 1, in, 2), SW_I2C_OK);
+    CHECK_MEM(in, out, 2);
+    CHECK_EQ(bus.i2c.recoveries, rec + 2);
+
+    /* at init */
+    abandon_read(0);
+    SW_I2C_initial(&bus.i2c);
+    CHECK_EQ(bus.i2c.recoveries, rec + 3);
+    CHECK_EQ(bus.sda, 1);
+
+    /* not when disabled: the bus is reported busy and left alone */
+    abandon_read(1);
+    bus.i2c.flags |= SW_I2C_FLAG_NO_RECOVERY;
+    CHECK_EQ(SW_I2C_Read_Mem(&bus.i2c, REG_ADDR << 1, 0x10, 1, in, 2), SW_I2C_ERR_BUS_BUSY);
+    CHECK_EQ(bus.i2c.recoveries, rec + 3);
+    CHECK_EQ(bus.sda, 0);
+    bus.i2c.flags &= ~SW_I2C_FLAG_NO_RECOVERY;
+    CHECK_EQ(SW_I2C_Recover(&bus.i2c), SW_I2C_OK);
+    CHECK_EQ(bus.i2c.recovery_failures, 0);
+}
+
+static void held_scl(void)
+{
+    uint8_t out[4] = { 1, 2, 3, 4 }, in[4];
+    uint32_t rec = bus.i2c.recoveries;
+
+    /* a stretch timeout recovers, which cannot clock a held SCL */
+    bus.i2c.flags |= SW_I2C_FLAG_CLOCK_STRETCH;
+    bus.i2c.stretch_timeout_us = 1000;
+    regfile.base.stretch_ns = 20000000;
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, REG_ADDR << 1, 0x20, 1, out, 4), SW_I2C_ERR_STRETCH_TIMEOUT);
+    regfile.base.stretch_ns = 0;
+    CHECK_EQ(bus.i2c.recoveries, rec + 1);
+    CHECK_EQ(bus.i2c.recovery_failures, 1);
+    CHECK_EQ(SW_I2C_Recover(&bus.i2c), SW_I2C_ERR_BUS_BUSY);
+    CHECK_EQ(bus.i2c.recovery_failures, 2);
+
+    /* released */
+    sim_advance_ns(20000000);
+    CHECK_EQ(SW_I2C_Recover(&bus.i2c), SW_I2C_OK);
+    CHECK_EQ(bus.i2c.recovery_failures, 2);
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, REG_ADDR << 1, 0x20, 1, out, 4), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Read_Mem(&bus.i2c, REG_ADDR << 1, 0x20, 1, in, 4), SW_I2C_OK);
+    CHECK_MEM(in, out, 4);
+    bus.i2c.stretch_timeout_us = 0;
+
+    CHECK_EQ(SW_I2C_Recover(NULL), SW_I2C_ERR_PARAM);
+}
+
+static void replay(void)
+{
+    uint8_t ops[SW_I2C_PROG_OPS(3, 2)], in[2];
+    sw_i2c_prog_t p = { .ops = ops, .cap = sizeof(ops) };
+    uint32_t rec;
+
+    sim_bus_use_fast(&bus, 1);
+    SW_I2C_Calibrate(&bus.i2c);
+    regfile.regs[0x30] = 0xAB;
+    regfile.regs[0x31] = 0xCD;
+    CHECK_EQ(SW_I2C_Prog_Prepare_Reg_Read(&p, &bus.i2c, REG_ADDR << 1, 0x30, 1, 2), SW_I2C_OK);
+    rec = bus.i2c.recoveries;
+
+    abandon_read(2);
+    CHECK_EQ(SW_I2C_Prog_Replay(&bus.i2c, &p, in), SW_I2C_OK);
+    CHECK_EQ(in[0], 0xAB);
+    CHECK_EQ(in[1], 0xCD);
+    CHECK_EQ(bus.i2c.recoveries, rec + 1);
+
+    abandon_read(2);
+    bus.i2c.flags |= SW_I2C_FLAG_NO_RECOVERY;
+    CHECK_EQ(SW_I2C_Prog_Replay(&bus.i2c, &p, in), SW_I2C_ERR_BUS_BUSY);
+    CHECK_EQ(bus.i2c.recoveries, rec + 1);
+    bus.i2c.flags &= ~SW_I2C_FLAG_NO_RECOVERY;
+    CHECK_EQ(SW_I2C_Recover(&bus.i2c), SW_I2C_OK);
+
+    /* after a stretch timeout the bus is recovered for the next caller */
+    bus.i2c.flags |= SW_I2C_FLAG_CLOCK_STRETCH;
+    bus.i2c.stretch_timeout_us = 1000;
+    regfile.base.stretch_ns = 5000000;
+    CHECK_EQ(SW_I2C_Prog_Replay(&bus.i2c, &p, in), SW_I2C_ERR_STRETCH_TIMEOUT);
+    regfile.base.stretch_ns = 0;
+    CHECK_EQ(bus.i2c.recoveries, rec + 3);
+    sim_advance_ns(5000000);
+    CHECK_EQ(SW_I2C_Prog_Replay(&bus.i2c, &p, in), SW_I2C_OK);
+    CHECK_EQ(in[1], 0xCD);
+    bus.i2c.stretch_timeout_us = 0;
+    bus.i2c.flags &= ~SW_I2C_FLAG_CLOCK_STRETCH;
+}
+
+void test_recover(void)
+{
+    sim_bus_init(&bus);
+    sim_regfile_init(&regfile, REG_ADDR);
+    sim_bus_attach(&bus, &regfile.base);
+    bus.i2c.flags = SW_I2C_FLAG_OPEN_DRAIN;
+    SW_I2C_initial(&bus.i2c);
+    SW_I2C_Set_Speed(&bus.i2c, SW_I2C_SPEED_FAST);
+
+    stuck_sda();
+    held_scl();
+    replay();
+}
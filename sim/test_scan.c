@@ -0,0 +1,111 @@
+/***
+ * Address scan: presence bitmap over a range, probe direction per mode,
+ * cost per address, and a scan stopped by a held clock.
+ */
+
+#include "sw_i2c_test.h"
+
+static sim_bus_t bus;
+static sim_regfile_t low, mid;
+static sim_eeprom_t eeprom;
+static uint8_t eeprom_mem[256];
+
+static int found(const uint8_t *map, uint8_t a)
+{
+    return (map[a >> 3] >> (a & 7)) & 1;
+}
+
+static unsigned count(const uint8_t *map)
+{
+    unsigned n = 0;
+
+    for (unsigned a = 0; a < 0x80; a++)
+        n += found(map, a);
+    return n;
+}
+
+static void presence(void)
+{
+    uint8_t map[SW_I2C_SCAN_BYTES];
+    sim_stats_t mark;
+
+    /* write probes: START, address, STOP each */
+    mark = bus.stats;
+    CHECK_EQ(SW_I2C_Scan(&bus.i2c, 0x00, 0x7F, SW_I2C_SCAN_WRITE, map), SW_I2C_OK);
+    CHECK_EQ(count(map), 3);
+    CHECK(found(map, 0x08) && found(map, 0x40) && found(map, 0x50));
+    CHECK_EQ(bus.stats.starts - mark.starts, 0x80);
+    CHECK_EQ(bus.stats.stops - mark.stops, 0x80);
+    CHECK_EQ(bus.stats.bytes - mark.bytes, 0x80);
+
+    /* auto: the EEPROM range is probed with a read, one byte NACKed */
+    mark = bus.stats;
+    CHECK_EQ(SW_I2C_Scan(&bus.i2c, 0x00, 0x7F, SW_I2C_SCAN_AUTO, map), SW_I2C_OK);
+    CHECK_EQ(count(map), 3);
+    CHECK_EQ(bus.stats.bytes - mark.bytes, 0x80 + 1);
+    CHECK_EQ(eeprom.pages_written, 0);
+
+    mark = bus.stats;
+    CHECK_EQ(SW_I2C_Scan(&bus.i2c, 0x00, 0x7F, SW_I2C_SCAN_READ, map), SW_I2C_OK);
+    CHECK_EQ(count(map), 3);
+    CHECK_EQ(bus.stats.bytes - mark.bytes, 0x80 + 3);
+
+    /* a sub-range, the rest of the map cleared */
+    memset(map, 0xFF, sizeof(map));
+    CHECK_EQ(SW_I2C_Scan(&bus.i2c, 0x40, 0x4F, SW_I2C_SCAN_WRITE, map), SW_I2C_OK);
+    CHECK_EQ(count(map), 1);
+    CHECK(found(map, 0x40));
+    CHECK_EQ(SW_I2C_Scan(&bus.i2c, 0x7F, 0x7F, SW_I2C_SCAN_WRITE, map), SW_I2C_OK);
+    CHECK_EQ(count(map), 0);
+}
+
+/* A held clock ends the scan, what was found before it is kept */
+static void stopped(void)
+{
+    uint8_t map[SW_I2C_SCAN_BYTES];
+    uint32_t rec = bus.i2c.recoveries;
+
+    bus.i2c.flags |= SW_I2C_FLAG_CLOCK_STRETCH;
+    bus.i2c.stretch_timeout_us = 1000;
+    mid.base.stretch_ns = 20000000;
+    CHECK_EQ(SW_I2C_Scan(&bus.i2c, 0x00, 0x7F, SW_I2C_SCAN_WRITE, map), SW_I2C_ERR_STRETCH_TIMEOUT);
+    mid.base.stretch_ns = 0;
+    CHECK_EQ(SW_I2C_Last_Status(&bus.i2c, NULL), SW_I2C_ERR_STRETCH_TIMEOUT);
+    CHECK(found(map, 0x08));
+    CHECK(!found(map, 0x50));
+    CHECK_EQ(bus.i2c.recoveries, rec + 1);
+    sim_advance_ns(20000000);
+    CHECK_EQ(SW_I2C_Scan(&bus.i2c, 0x00, 0x7F, SW_I2C_SCAN_WRITE, map), SW_I2C_OK);
+    CHECK_EQ(count(map), 3);
+    bus.i2c.stretch_timeout_us = 0;
+    bus.i2c.flags &= ~SW_I2C_FLAG_CLOCK_STRETCH;
+}
+
+static void params(void)
+{
+    uint8_t map[SW_I2C_SCAN_BYTES];
+
+    CHECK_EQ(SW_I2C_Scan(NULL, 0x00, 0x7F, SW_I2C_SCAN_WRITE, map), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_Scan(&bus.i2c, 0x00, 0x7F, SW_I2C_SCAN_WRITE, NULL), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_Scan(&bus.i2c, 0x10, 0x0F, SW_I2C_SCAN_WRITE, map), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_Scan(&bus.i2c, 0x00, 0x80, SW_I2C_SCAN_WRITE, map), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_Scan(&bus.i2c, 0x00, 0x7F, SW_I2C_SCAN_AUTO + 1, map), SW_I2C_ERR_PARAM);
+}
+
+void test_scan(void)
+{
+    sim_bus_init(&bus);
+    sim_regfile_init(&low, 0x08);
+    sim_regfile_init(&mid, 0x40);
+    sim_eeprom_init(&eeprom, 0x50, eeprom_mem, sizeof(eeprom_mem), 16, 1, 0);
+    sim_bus_attach(&bus, &low.base);
+    sim_bus_attach(&bus, &mid.base);
+    sim_bus_attach(&bus, &eeprom.base);
+    bus.i2c.flags = SW_I2C_FLAG_OPEN_DRAIN;
+    SW_I2C_initial(&bus.i2c);
+    SW_I2C_Set_Speed(&bus.i2c, SW_I2C_SPEED_FAST);
+
+    presence();
+    stopped();
+    params();
+}
@@ -0,0 +1,97 @@
+/***
+ * Target mode: register writes and reads through the core on a second
+ * simulated MCU, write masks, and the latched overrun that refuses writes
+ * once the interrupt latency has lost an edge.
+ */
+
+#include "sw_i2c_test.h"
+#include "sw_i2c_slave.h"
+
+#define SLAVE_ADDR  0x30
+#define LEN         16
+
+static sim_bus_t bus;
+static sim_device_t dev;
+static sw_i2c_slave_t slave;
+static uint8_t regs[64];
+
+static void fill(uint8_t *p, size_t n, uint8_t seed)
+{
+    for (size_t i = 0; i < n; i++)
+        p[i] = (uint8_t)(seed + i * 5);
+}
+
+static void registers(void)
+{
+    static const uint8_t mask[8] = { 0xFF, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    uint8_t out[LEN], in[LEN];
+
+    SW_I2C_Set_Speed(&bus.i2c, SW_I2C_SPEED_FAST);
+    dev.irq_ns = 100;
+    fill(out, sizeof(out), 0x21);
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, SLAVE_ADDR << 1, 0x20, 1, out, LEN), SW_I2C_OK);
+    CHECK_MEM(&regs[0x20], out, LEN);
+    memset(in, 0, sizeof(in));
+    CHECK_EQ(SW_I2C_Read_Mem(&bus.i2c, SLAVE_ADDR << 1, 0x20, 1, in, LEN), SW_I2C_OK);
+    CHECK_MEM(in, out, LEN);
+    CHECK_EQ(slave.xfers, 2);
+    CHECK_EQ(slave.wr_len, 0);
+    CHECK_EQ(slave.rd_len, LEN);
+    CHECK_EQ(slave.overruns, 0);
+    CHECK_EQ(slave.status, SW_I2C_OK);
+
+    /* registers 0x08-0x0F read-only */
+    slave.wr_mask = mask;
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, SLAVE_ADDR << 1, 0x06, 1, out, 4), SW_I2C_ERR_DATA_NACK);
+    CHECK_MEM(&regs[0x06], out, 2);
+    CHECK_EQ(regs[0x08], 0);
+    CHECK_EQ(slave.nacks, 1);
+    slave.wr_mask = NULL;
+}
+
+static void overrun(void)
+{
+    uint8_t out[LEN], in[LEN], map[sizeof(regs)];
+
+    /* 1 MHz with 1.6 us to the handler: edges are lost */
+    SW_I2C_Set_Speed(&bus.i2c, SW_I2C_SPEED_FAST_PLUS);
+    dev.irq_ns = 1600;
+    fill(out, sizeof(out), 0x60);
+    CHECK(SW_I2C_Write_Mem(&bus.i2c, SLAVE_ADDR << 1, 0x20, 1, out, LEN) != SW_I2C_OK);
+    CHECK(slave.overruns > 0);
+    CHECK_EQ(slave.status, SW_I2C_ERR_OVERRUN);
+
+    /* latched: writes refused even at a latency that works, reads served */
+    SW_I2C_Set_Speed(&bus.i2c, SW_I2C_SPEED_FAST);
+    dev.irq_ns = 100;
+    sim_advance_ns(100000);
+    memcpy(map, regs, sizeof(map));
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, SLAVE_ADDR << 1, 0x20, 1, out, LEN), SW_I2C_ERR_DATA_NACK);
+    CHECK_EQ(SW_I2C_Last_Status(&bus.i2c, NULL), SW_I2C_ERR_DATA_NACK);
+    CHECK_MEM(regs, map, sizeof(regs));
+    CHECK_EQ(SW_I2C_Read_Mem(&bus.i2c, SLAVE_ADDR << 1, 0x20, 1, in, LEN), SW_I2C_OK);
+    CHECK_MEM(in, &map[0x20], LEN);
+
+    CHECK_EQ(SW_I2C_Slave_Clear_Status(&slave), SW_I2C_ERR_OVERRUN);
+    CHECK_EQ(SW_I2C_Slave_Clear_Status(&slave), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, SLAVE_ADDR << 1, 0x20, 1, out, LEN), SW_I2C_OK);
+    CHECK_MEM(&regs[0x20], out, LEN);
+    CHECK_EQ(SW_I2C_Slave_Clear_Status(NULL), SW_I2C_ERR_PARAM);
+}
+
+void test_slave(void)
+{
+    sim_bus_init(&bus);
+    bus.i2c.flags = SW_I2C_FLAG_OPEN_DRAIN;
+    SW_I2C_initial(&bus.i2c);
+    sim_device_init(&dev, &bus, &slave);
+    slave.d = &dev.i2c;
+    slave.IICID = SLAVE_ADDR << 1;
+    slave.alen = 1;
+    slave.regs = regs;
+    slave.size = sizeof(regs);
+    CHECK_EQ(SW_I2C_Slave_Init(&slave), SW_I2C_OK);
+
+    registers();
+    overrun();
+}
@@ -0,0 +1,115 @@
+/***
+ * SMBus layer: protocol data, the PEC the core computes from its CRC-8
+ * table against a known vector and the target's bitwise check, PEC
+ * mismatches, and Block Read count checks.
+ */
+
+#include "sw_i2c_test.h"
+#include "sw_i2c_smbus.h"
+
+#define SMBUS_ADDR  0x5A
+
+static sim_bus_t bus;
+static sim_smbus_t dev;
+
+static void protocol(void)
+{
+    sw_i2c_smbus_t s = { &bus.i2c, SMBUS_ADDR << 1, 1 };
+    uint8_t out[SW_I2C_SMBUS_BLOCK_MAX], in[SW_I2C_SMBUS_BLOCK_MAX], b = 0, cnt = 0;
+    uint16_t w = 0;
+
+    for (unsigned i = 0; i < sizeof(out); i++)
+        out[i] = (uint8_t)(0xA0 + i);
+    dev.pec_on = 1;
+
+    CHECK_EQ(SW_I2C_SMBus_Send_Byte(&s, 0x3C), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_SMBus_Receive_Byte(&s, &b), SW_I2C_OK);
+    CHECK_EQ(b, 0x3C);
+    CHECK_EQ(SW_I2C_SMBus_Write_Byte(&s, 0x10, 0x5A), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_SMBus_Read_Byte(&s, 0x10, &b), SW_I2C_OK);
+    CHECK_EQ(b, 0x5A);
+    CHECK_EQ(SW_I2C_SMBus_Write_Word(&s, 0x44, 0xBEEF), SW_I2C_OK);
+    CHECK_EQ(dev.words[0x44], 0xBEEF);                 // low byte first
+    CHECK_EQ(SW_I2C_SMBus_Read_Word(&s, 0x44, &w), SW_I2C_OK);
+    CHECK_EQ(w, 0xBEEF);
+    CHECK_EQ(SW_I2C_SMBus_Process_Call(&s, 0xC0, 0x1234, &w), SW_I2C_OK);
+    CHECK_EQ(w, 0xEDCB);
+    CHECK_EQ(SW_I2C_SMBus_Write_Block(&s, 0x83, out, sizeof(out)), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_SMBus_Read_Block(&s, 0x83, in, &cnt), SW_I2C_OK);
+    CHECK_EQ(cnt, sizeof(out));
+    CHECK_MEM(in, out, sizeof(out));
+    CHECK_EQ(dev.pec_errors, 0);
+    dev.pec_on = 0;
+}
+
+static void pec(void)
+{
+    sw_i2c_smbus_t s = { &bus.i2c, SMBUS_ADDR << 1, 0 };
+    uint8_t b = 0;
+
+    /* CRC-8 (x^8 + x^2 + x + 1) of B4 12 34 is B0 */
+    CHECK_EQ(SW_I2C_SMBus_Write_Byte(&s, 0x12, 0x34), SW_I2C_OK);
+    CHECK_EQ(bus.i2c.pec, 0xB0);
+
+    /* appended and checked by the target: the PEC over itself leaves 0 */
+    s.pec = 1;
+    dev.pec_on = 1;
+    CHECK_EQ(SW_I2C_SMBus_Write_Byte(&s, 0x12, 0x35), SW_I2C_OK);
+    CHECK_EQ(bus.i2c.pec, 0);
+    CHECK_EQ(dev.pec_errors, 0);
+    CHECK_EQ(dev.words[0x12] & 0xFF, 0x35);
+
+    /* a write without PEC is dropped by the target */
+    s.pec = 0;
+    CHECK_EQ(SW_I2C_SMBus_Write_Byte(&s, 0x12, 0x36), SW_I2C_OK);
+    CHECK_EQ(dev.pec_errors, 1);
+    CHECK_EQ(dev.words[0x12] & 0xFF, 0x35);
+
+    /* a corrupted PEC on a read is reported, the next read is clean */
+    s.pec = 1;
+    dev.bad_pec = 1;
+    CHECK_EQ(SW_I2C_SMBus_Read_Byte(&s, 0x12, &b), SW_I2C_ERR_PEC);
+    CHECK_EQ(SW_I2C_Last_Status(&bus.i2c, NULL), SW_I2C_ERR_PEC);
+    CHECK_EQ(bus.last_xfer.stops, 1);
+    CHECK_EQ(SW_I2C_SMBus_Read_Byte(&s, 0x12, &b), SW_I2C_OK);
+    CHECK_EQ(b, 0x35);
+    dev.pec_on = 0;
+}
+
+static void block_count(void)
+{
+    sw_i2c_smbus_t s = { &bus.i2c, SMBUS_ADDR << 1, 0 };
+    uint8_t in[SW_I2C_SMBUS_BLOCK_MAX], cnt = 0xEE;
+
+    /* above the SMBus maximum: the read ends after the count byte */
+    dev.blocks[5][0] = SW_I2C_SMBUS_BLOCK_MAX + 8;
+    CHECK_EQ(SW_I2C_SMBus_Read_Block(&s, 0x85, in, &cnt), SW_I2C_ERR_PROTOCOL);
+    CHECK_EQ(cnt, 0xEE);
+    CHECK_EQ(bus.last_xfer.stops, 1);
+    CHECK_EQ(bus.last_xfer.bytes, 5);                  // two addresses, command, count, one NACKed
+    s.pec = 1;
+    CHECK_EQ(SW_I2C_SMBus_Read_Block(&s, 0x85, in, &cnt), SW_I2C_ERR_PROTOCOL);
+
+    dev.blocks[5][0] = 0;
+    CHECK_EQ(SW_I2C_SMBus_Read_Block(&s, 0x85, in, &cnt), SW_I2C_ERR_PROTOCOL);
+
+    /* the bus is left idle */
+    dev.blocks[5][0] = 1;
+    dev.blocks[5][1] = 0x77;
+    CHECK_EQ(SW_I2C_SMBus_Read_Block(&s, 0x85, in, &cnt), SW_I2C_OK);
+    CHECK_EQ(cnt, 1);
+    CHECK_EQ(in[0], 0x77);
+}
+
+void test_smbus(void)
+{
+    sim_bus_init(&bus);
+    sim_smbus_init(&dev, SMBUS_ADDR);
+    sim_bus_attach(&bus, &dev.base);
+    SW_I2C_initial(&bus.i2c);
+    SW_I2C_Set_Speed(&bus.i2c, SW_I2C_SPEED_STANDARD);
+
+    protocol();
+    pec();
+    block_count();
+}
@@ -0,0 +1,164 @@
+/***
+ * Phase timing of every engine against the UM10204 minimums, measured on
+ * the simulated lines: the core in each edge mode, prepared programs,
+ * waveforms and lockstep groups, at 100 kHz, 400 kHz and 1 MHz; and two
+ * targets at their own clocks on one bus.
+ */
+
+#include "sw_i2c_test.h"
+#include "sw_i2c_prog.h"
+#include "sw_i2c_wave.h"
+#include "sw_i2c_multi.h"
+
+#define REG_ADDR    0x40
+#define SLOW_ADDR   0x41
+
+enum { ENG_HAL, ENG_FAST, ENG_OPEN_DRAIN, ENG_PROG, ENG_WAVE, ENG_MULTI };
+
+static const char * const eng_name[] = { "hal", "fast", "od", "prog", "wave", "multi" };
+
+/* Spec minimums per mode, ns */
+static const struct
+{
+    uint32_t hz;
+    sim_timing_t min;
+} spec[] =
+{
+    { SW_I2C_SPEED_STANDARD,  { 4700, 4000, 4700, 4000, 4000, 4700 } },
+    { SW_I2C_SPEED_FAST,      { 1300,  600,  600,  600,  600, 1300 } },
+    { SW_I2C_SPEED_FAST_PLUS, {  500,  260,  260,  260,  260,  500 } },
+};
+
+static sim_bus_t bus;
+static sim_regfile_t regfile, slow;
+
+static void expect_min(const char *what, int eng, uint32_t hz, uint32_t seen, uint32_t min)
+{
+    test_checks++;
+    if (seen < min)
+    {
+        test_failures++;
+        fprintf(stderr, "%s %u Hz: %s %u ns, spec minimum %u ns\n", eng_name[eng], (unsigned)hz, what,
+                (unsigned)seen, (unsigned)min);
+    }
+}
+
+/* Write the register, read it back after a repeated START; twice for tBUF */
+static void run(int eng, uint32_t hz)
+{
+    uint8_t reg = 0x20, out[3] = { 0x20, 0x5A, 0xC3 }, in[2];
+    uint8_t ops[SW_I2C_PROG_OPS(3, 2)];
+    uint32_t wout[SW_I2C_WAVE_TICKS(3, 2)], win[SW_I2C_WAVE_TICKS(3, 2)];
+    sw_i2c_msg_t msgs[] =
+    {
+        { REG_ADDR << 1, SW_I2C_M_REG, 1, &reg },
+        { REG_ADDR << 1, SW_I2C_M_RD, 2, in },
+    };
+    sw_i2c_msg_t *group_msgs[] = { msgs };
+    sw_i2c_t *group_bus[] = { &bus.i2c };
+    sw_i2c_prog_t p = { .ops = ops, .cap = sizeof(ops) };
+    sw_i2c_wave_t w = { .out = wout, .in = win, .cap = SW_I2C_WAVE_TICKS(3, 2) };
+    sw_i2c_multi_t g;
+    sw_i2c_status_e group_st[1];
+
+    sim_bus_use_fast(&bus, eng != ENG_HAL);
+    bus.i2c.flags = eng >= ENG_OPEN_DRAIN ? SW_I2C_FLAG_OPEN_DRAIN : 0;
+    SW_I2C_Calibrate(&bus.i2c);
+    SW_I2C_Set_Speed(&bus.i2c, hz);
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, REG_ADDR << 1, 0x20, 1, &out[1], 2), SW_I2C_OK);
+    sim_bus_reset_stats(&bus);
+
+    for (int n = 0; n < 2; n++)
+    {
+        memset(in, 0, sizeof(in));
+        switch (eng)
+        {
+        case ENG_PROG:
+            CHECK_EQ(SW_I2C_Prog_Prepare(&p, &bus.i2c, msgs, 2), SW_I2C_OK);
+            CHECK_EQ(SW_I2C_Prog_Replay(&bus.i2c, &p, in), SW_I2C_OK);
+            break;
+        case ENG_WAVE:
+            CHECK_EQ(SW_I2C_Wave_Transfer(&bus.i2c, &w, msgs, 2, NULL), SW_I2C_OK);
+            break;
+        case ENG_MULTI:
+            CHECK_EQ(SW_I2C_Multi_Init(&g, group_bus, 1), SW_I2C_OK);
+            CHECK_EQ(SW_I2C_Multi_Transfer(&g, group_msgs, 2, group_st), SW_I2C_OK);
+            break;
+        default:
+            CHECK_EQ(SW_I2C_Transfer(&bus.i2c, msgs, 2), SW_I2C_OK);
+            break;
+        }
+        CHECK_MEM(in, &out[1], 2);
+    }
+    CHECK_EQ(bus.xfers, 2);
+
+    for (unsigned m = 0; m < sizeof(spec) / sizeof(spec[0]); m++)
+    {
+        if (spec[m].hz != hz)
+            continue;
+        expect_min("tLOW", eng, hz, bus.tmin.low_ns, spec[m].min.low_ns);
+        expect_min("tHIGH", eng, hz, bus.tmin.high_ns, spec[m].min.high_ns);
+        expect_min("tSU;STA", eng, hz, bus.tmin.su_sta_ns, spec[m].min.su_sta_ns);
+        expect_min("tHD;STA", eng, hz, bus.tmin.hd_sta_ns, spec[m].min.hd_sta_ns);
+        expect_min("tSU;STO", eng, hz, bus.tmin.su_sto_ns, spec[m].min.su_sto_ns);
+        expect_min("tBUF", eng, hz, bus.tmin.buf_ns, spec[m].min.buf_ns);
+    }
+    /* each phase was seen */
+    CHECK(bus.tmin.su_sta_ns != UINT32_MAX);
+    CHECK(bus.tmin.buf_ns != UINT32_MAX);
+}
+
+/* A 100 kHz target listed in dev_speed on a 1 MHz bus: each gets its own tLOW/tHIGH */
+static void targets(void)
+{
+    static const sw_i2c_dev_speed_t speeds[] = { { SLOW_ADDR << 1, SW_I2C_SPEED_STANDARD } };
+    uint8_t out[2] = { 0x5A, 0xC3 }, in[2];
+
+    sim_bus_use_fast(&bus, 1);
+    bus.i2c.flags = SW_I2C_FLAG_OPEN_DRAIN;
+    bus.i2c.dev_speed = speeds;
+    bus.i2c.dev_speed_cnt = 1;
+    SW_I2C_Calibrate(&bus.i2c);
+    SW_I2C_Set_Speed(&bus.i2c, SW_I2C_SPEED_FAST_PLUS);
+    CHECK_EQ(SW_I2C_Target_Clock(&bus.i2c, REG_ADDR << 1), SW_I2C_SPEED_FAST_PLUS);
+    CHECK_EQ(SW_I2C_Target_Clock(&bus.i2c, SLOW_ADDR << 1), SW_I2C_SPEED_STANDARD);
+    CHECK_EQ(SW_I2C_Target_Clock(&bus.i2c, (SLOW_ADDR << 1) | I2C_READ), SW_I2C_SPEED_STANDARD);
+
+    sim_bus_reset_stats(&bus);
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, SLOW_ADDR << 1, 0x10, 1, out, 2), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Read_Mem(&bus.i2c, SLOW_ADDR << 1, 0x10, 1, in, 2), SW_I2C_OK);
+    CHECK_MEM(in, out, 2);
+    expect_min("slow tLOW", ENG_FAST, SW_I2C_SPEED_STANDARD, bus.tmin.low_ns, spec[0].min.low_ns);
+    expect_min("slow tHIGH", ENG_FAST, SW_I2C_SPEED_STANDARD, bus.tmin.high_ns, spec[0].min.high_ns);
+    expect_min("slow tSU;STA", ENG_FAST, SW_I2C_SPEED_STANDARD, bus.tmin.su_sta_ns, spec[0].min.su_sta_ns);
+
+    /* the other target keeps the bus clock: well under the 100 kHz minimums */
+    sim_bus_reset_stats(&bus);
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, REG_ADDR << 1, 0x10, 1, out, 2), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Read_Mem(&bus.i2c, REG_ADDR << 1, 0x10, 1, in, 2), SW_I2C_OK);
+    CHECK_MEM(in, out, 2);
+    expect_min("tLOW", ENG_FAST, SW_I2C_SPEED_FAST_PLUS, bus.tmin.low_ns, spec[2].min.low_ns);
+    expect_min("tHIGH", ENG_FAST, SW_I2C_SPEED_FAST_PLUS, bus.tmin.high_ns, spec[2].min.high_ns);
+    CHECK(bus.tmin.low_ns < spec[1].min.low_ns);
+    CHECK(bus.tmin.high_ns < spec[1].min.high_ns);
+
+    bus.i2c.dev_speed = NULL;
+    bus.i2c.dev_speed_cnt = 0;
+}
+
+void test_timing(void)
+{
+    sim_bus_init(&bus);
+    sim_regfile_init(&regfile, REG_ADDR);
+    sim_regfile_init(&slow, SLOW_ADDR);
+    sim_bus_attach(&bus, &regfile.base);
+    sim_bus_attach(&bus, &slow.base);
+    SW_I2C_initial(&bus.i2c);
+
+    for (unsigned m = 0; m < sizeof(spec) / sizeof(spec[0]); m++)
+    {
+        for (int eng = ENG_HAL; eng <= ENG_MULTI; eng++)
+            run(eng, spec[m].hz);
+    }
+    targets();
+}
@@ -0,0 +1,198 @@
+/***
+ * Transaction trace: what a drained record holds, ring wrap-around and the
+ * lost count, and the host converter's output for known records.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "sw_i2c_test.h"
+#include "sw_i2c_trace.h"
+
+#define REG_ADDR    0x40
+
+static sim_bus_t bus;
+static sim_regfile_t regfile;
+static sw_i2c_trace_t ring;
+static sw_i2c_trace_rec_t slots[4];
+
+/* Wire bytes, ACK and START bits, and the summary fields of each shape */
+static void records(void)
+{
+    static const uint8_t wr[2] = { 0xA1, 0xA2 };
+    static const uint8_t wr_wire[] = { REG_ADDR << 1, 0x10, 0xA1, 0xA2 };
+    static const uint8_t rd_wire[] = { REG_ADDR << 1, 0x10, (REG_ADDR << 1) | I2C_READ, 0xA1, 0xA2 };
+    uint8_t in[2], big[12] = { 0 };
+    sw_i2c_trace_rec_t r[4];
+    uint64_t t0 = sim_now_ns();
+
+    CHECK_EQ(SW_I2C_Trace_Init(&ring, slots, 4), SW_I2C_OK);
+    SW_I2C_Trace_Attach(&bus.i2c, &ring, 3);
+    CHECK_EQ(SW_I2C_Trace_Read(&ring, r, 4), 0);
+
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, REG_ADDR << 1, 0x10, 1, wr, 2), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Read_Mem(&bus.i2c, REG_ADDR << 1, 0x10, 1, in, 2), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, 0x48 << 1, 0x10, 1, wr, 2), SW_I2C_ERR_ADDR_NACK);
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, REG_ADDR << 1, 0x20, 1, big, sizeof(big)), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Trace_Read(&ring, r, 4), 4);
+    CHECK_EQ(SW_I2C_Trace_Read(&ring, r, 4), 0);
+    CHECK_EQ(ring.lost, 0);
+
+    CHECK_EQ(r[0].seq, 1);
+    CHECK_EQ(r[0].bus, 3);
+    CHECK_EQ(r[0].IICID, REG_ADDR << 1);
+    CHECK_EQ(r[0].flags, SW_I2C_TRACE_F_WR | SW_I2C_TRACE_F_REG);
+    CHECK_EQ(r[0].status, SW_I2C_OK);
+    CHECK_EQ(r[0].reg, 0x10);
+    CHECK_EQ(r[0].len, 2);
+    CHECK_EQ(r[0].wire, 4);
+    CHECK_MEM(r[0].bytes, wr_wire, sizeof(wr_wire));
+    CHECK_EQ(r[0].ack, 0x0F);
+    CHECK_EQ(r[0].start, 0x01);
+    CHECK(r[0].stamp >= t0 && r[0].duration > 0);
+    CHECK(r[1].stamp >= r[0].stamp + r[0].duration);
+
+    /* repeated START before the read address; the last byte is ours to NACK */
+    CHECK_EQ(r[1].seq, 2);
+    CHECK_EQ(r[1].flags, SW_I2C_TRACE_F_RD | SW_I2C_TRACE_F_REG);
+    CHECK_EQ(r[1].reg, 0x10);
+    CHECK_EQ(r[1].len, 2);
+    CHECK_EQ(r[1].wire, 5);
+    CHECK_MEM(r[1].bytes, rd_wire, sizeof(rd_wire));
+    CHECK_EQ(r[1].ack, 0x0F);
+    CHECK_EQ(r[1].start, 0x05);
+
+    CHECK_EQ(r[2].IICID, 0x48 << 1);
+    CHECK_EQ(r[2].status, SW_I2C_ERR_ADDR_NACK);
+    CHECK_EQ(r[2].wire, 1);
+    CHECK_EQ(r[2].ack, 0);
+    CHECK_EQ(r[2].bytes[0], 0x48 << 1);
+
+    /* past SW_I2C_TRACE_BYTES only the count goes on */
+    CHECK_EQ(r[3].len, sizeof(big));
+    CHECK_EQ(r[3].wire, 2 + sizeof(big));
+    CHECK_EQ(r[3].bytes[1], 0x20);
+    CHECK_EQ(r[3].ack, 0xFF);
+}
+
+/* Six records into four slots: the oldest two are lost, the rest in order */
+static void wrap(void)
+{
+    sw_i2c_trace_rec_t r[4];
+    uint8_t v = 0;
+
+    CHECK_EQ(SW_I2C_Trace_Init(&ring, slots, 3), SW_I2C_ERR_PARAM);
+    CHECK_EQ(SW_I2C_Trace_Init(&ring, slots, 4), SW_I2C_OK);
+    for (int i = 0; i < 6; i++)
+        CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, REG_ADDR << 1, (uint16_t)i, 1, &v, 1), SW_I2C_OK);
+
+    CHECK_EQ(SW_I2C_Trace_Read(&ring, r, 1), 1);
+    CHECK_EQ(ring.lost, 2);
+    CHECK_EQ(r[0].seq, 3);
+    CHECK_EQ(r[0].reg, 2);
+    CHECK_EQ(SW_I2C_Trace_Read(&ring, r, 4), 3);
+    CHECK_EQ(r[0].seq, 4);
+    CHECK_EQ(r[2].seq, 6);
+    CHECK_EQ(r[2].reg, 5);
+    CHECK_EQ(ring.lost, 2);
+
+    /* a slot overwritten between two reads */
+    for (int i = 0; i < 5; i++)
+        CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, REG_ADDR << 1, 0, 1, &v, 1), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Trace_Read(&ring, r, 4), 4);
+    CHECK_EQ(r[0].seq, 8);
+    CHECK_EQ(ring.lost, 3);
+
+    SW_I2C_Trace_Attach(&bus.i2c, NULL, 0);
+    CHECK_EQ(SW_I2C_Write_Mem(&bus.i2c, REG_ADDR << 1, 0, 1, &v, 1), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Trace_Read(&ring, r, 4), 0);
+}
+
+/* Runs the converter on recs and returns its output, NULL on failure */
+static char *trace2vcd(const char *args, const sw_i2c_trace_rec_t *recs, size_t cnt)
+{
+    static char out[4096];
+    char path[] = "/tmp/sw_i2c_traceXXXXXX", cmd[256];
+    int fd = mkstemp(path);
+    FILE *f;
+    size_t n;
+
+    if (fd < 0)
+        return NULL;
+    f = fdopen(fd, "wb");
+    n = fwrite(recs, sizeof(*recs), cnt, f);
+    fclose(f);
+    snprintf(cmd, sizeof(cmd), "%s %s %s", SW_I2C_TRACE2VCD, args, path);
+    f = popen(cmd, "r");
+    if (f == NULL || n != cnt)
+    {
+        unlink(path);
+        return NULL;
+    }
+    n = fread(out, 1, sizeof(out) - 1, f);
+    out[n] = 0;
+    unlink(path);
+    return pclose(f) == 0 ? out : NULL;
+}
+
+/* A write and a NACKed address, stored out of order with an empty slot */
+static void converter(void)
+{
+    sw_i2c_trace_rec_t recs[3] = { 0 };
+    const char *out;
+
+    recs[2] = (sw_i2c_trace_rec_t){ .seq = 1, .stamp = 0, .duration = 20000, .bus = 0,
+                                    .IICID = 0x80, .flags = SW_I2C_TRACE_F_WR, .len = 1,
+                                    .wire = 2, .ack = 0x03, .start = 0x01, .bytes = { 0x80, 0x5A } };
+    recs[0] = (sw_i2c_trace_rec_t){ .seq = 2, .stamp = 100000, .duration = 10000, .bus = 1,
+                                    .IICID = 0x90, .status = SW_I2C_ERR_ADDR_NACK,
+                                    .wire = 1, .ack = 0, .start = 0x01, .bytes = { 0x90 } };
+
+    out = trace2vcd("-s", recs, 3);
+    CHECK(out != NULL);
+    if (out == NULL)
+        return;
+    CHECK(strcmp(out,
+        "2500-3500 i2c-0: Start\n"
+        "3500-10500 i2c-0: Address write: 40\n"
+        "10500-11500 i2c-0: Write\n"
+        "11500-12500 i2c-0: ACK\n"
+        "12500-20500 i2c-0: Data write: 5A\n"
+        "20500-21500 i2c-0: ACK\n"
+        "21500-22500 i2c-0: Stop\n"
+        "102500-103409 i2c-1: Warning: ADDR_NACK\n"
+        "102500-103409 i2c-1: Start\n"
+        "103409-109772 i2c-1: Address write: 48\n"
+        "109772-110681 i2c-1: Write\n"
+        "110681-111590 i2c-1: NACK\n"
+        "111590-112499 i2c-1: Stop\n") == 0);
+
+    /* -f scales cycles: the same write at 500 MHz takes twice as long */
+    out = trace2vcd("-s -f 5e8", &recs[2], 1);
+    CHECK(out != NULL && strstr(out, "2500-4500 i2c-0: Start\n") == out);
+
+    /* the VCD declares both buses and starts SCL low after the first START */
+    out = trace2vcd("", recs, 3);
+    CHECK(out != NULL);
+    if (out == NULL)
+        return;
+    CHECK(strstr(out, "$timescale 1ns $end") != NULL);
+    CHECK(strstr(out, "$var wire 1 c0 scl0 $end") != NULL);
+    CHECK(strstr(out, "$var wire 1 d1 sda1 $end") != NULL);
+    CHECK(strstr(out, "#3000\n0d0\n") != NULL);
+    CHECK(strstr(out, "#3250\n0c0\n") != NULL);
+}
+
+void test_trace(void)
+{
+    sim_bus_init(&bus);
+    sim_regfile_init(&regfile, REG_ADDR);
+    sim_bus_attach(&bus, &regfile.base);
+    bus.i2c.flags = SW_I2C_FLAG_OPEN_DRAIN;
+    SW_I2C_initial(&bus.i2c);
+    SW_I2C_Set_Speed(&bus.i2c, SW_I2C_SPEED_FAST);
+
+    records();
+    wrap();
+    converter();
+}
@@ -0,0 +1,218 @@
+/***
+ * Waveform engine: compiled tick schedule, playback on the simulated bus
+ * by the CPU player and by a model of the timer + DMA player, the decoded
+ * transaction and the phase times measured on the lines.
+ */
+
+#include "sw_i2c_test.h"
+#include "sw_i2c_wave.h"
+#include "sw_i2c_phase.h"
+
+#define REG_ADDR    0x40
+#define TICKS       SW_I2C_WAVE_TICKS(6, 3)
+#define TMR_CLK_NS  4           // timer clock of the DMA model, 250 MHz
+
+static sim_bus_t bus;
+static sim_regfile_t regfile;
+static uint32_t wout[TICKS], win[TICKS];
+
+/* Measured phase within a few percent above the scheduled ticks */
+static int near(uint32_t seen, uint32_t ticks, uint32_t tick_ns)
+{
+    uint32_t want = ticks * tick_ns;
+
+    return seen >= want - want / 50 && seen <= want + want / 20;
+}
+
+/* The timer runs on its own: events at fixed times, whatever a store costs */
+static void dma_at(uint64_t t)
+{
+    if (t > sim_now_ns())
+        sim_advance_ns(t - sim_now_ns());
+}
+
+/**
+ * Request order of SW_I2C_AT32_Wave_Run: a software overflow stores out[0],
+ * every overflow the next word, the channel 1 compare at
+ * SW_I2C_WAVE_SAMPLE_CLK samples the port; playback ends when the output
+ * channel is done and the sample of its last word is taken.
+ */
+static sw_i2c_status_e dma_run(sw_i2c_t *d, sw_i2c_wave_t *w)
+{
+    uint64_t period = w->tick_ns / TMR_CLK_NS * TMR_CLK_NS, t0 = sim_now_ns();
+    uint64_t ccr = SW_I2C_WAVE_SAMPLE_CLK(period / TMR_CLK_NS) * TMR_CLK_NS;
+    uint32_t out = 0, in = 0;
+
+    SW_I2C_REG_WRITE(d->fast.scl_set, w->out[out++]);
+    for (uint64_t k = 0; out < w->len || in < w->len; k++)
+    {
+        dma_at(t0 + k * period + ccr);
+        if (in < w->len)
+            w->in[in++] = SW_I2C_REG_READ(d->fast.sda_in);
+        dma_at(t0 + (k + 1) * period);
+        if (out < w->len)
+            SW_I2C_REG_WRITE(d->fast.scl_set, w->out[out++]);
+    }
+    return SW_I2C_OK;
+}
+
+/* Write two bytes, read them back after a repeated START */
+static void schedule(uint32_t hz)
+{
+    uint8_t wr[3] = { 0x30, 0x12, 0x34 }, reg = 0x30, rd[2] = { 0 };
+    sw_i2c_msg_t msgs[] =
+    {
+        { REG_ADDR << 1, 0, 3, wr },
+        { REG_ADDR << 1, SW_I2C_M_REG, 1, &reg },
+        { REG_ADDR << 1, SW_I2C_M_RD, 2, rd },
+    };
+    sw_i2c_wave_t w = { .out = wout, .in = win, .cap = TICKS };
+    sw_i2c_timing_t tm;
+    uint32_t scl = bus.i2c.scl_pin, sda = bus.i2c.sda_pin, start, stop, bits;
+
+    SW_I2C_Set_Speed(&bus.i2c, hz);
+    CHECK_EQ(SW_I2C_Wave_Compile(&w, &bus.i2c, msgs, 3), SW_I2C_OK);
+
+    /* two ticks cover the longer of tLOW and tHIGH, conditions whole ticks */
+    tm = sw_i2c_spec_timing(hz, 0);
+    CHECK(2 * w.tick_ns >= tm.low_ns && 2 * w.tick_ns >= tm.high_ns);
+    CHECK(2 * w.tick_ns <= (tm.low_ns > tm.high_ns ? tm.low_ns : tm.high_ns) + 1);
+    CHECK(w.su_sta * w.tick_ns >= tm.su_sta_ns && (w.su_sta - 1) * w.tick_ns < tm.su_sta_ns);
+    CHECK(w.hd_sta * w.tick_ns >= tm.hd_sta_ns && (w.hd_sta - 1) * w.tick_ns < tm.hd_sta_ns);
+    CHECK(w.su_sto * w.tick_ns >= tm.su_sto_ns && (w.su_sto - 1) * w.tick_ns < tm.su_sto_ns);
+    CHECK(w.buf * w.tick_ns >= tm.buf_ns && (w.buf - 1) * w.tick_ns < tm.buf_ns);
+
+    /* 3 STARTs, 9 bytes (3 addresses, 6 payload) of 9 bits, one STOP */
+    start = 2 + w.su_sta + w.hd_sta;
+    stop = 2 + w.su_sto + w.buf;
+    bits = 9 * 9 * SW_I2C_WAVE_TICKS_PER_BIT;
+    CHECK_EQ(w.len, 3 * start + bits + stop);
+    CHECK(w.len <= TICKS);
+
+    /* first START: SCL low, SDA high, SCL high held, SDA low held */
+    CHECK_EQ(wout[0], scl << 16);
+    CHECK_EQ(wout[1], sda);
+    CHECK_EQ(wout[2], scl);
+    CHECK_EQ(wout[2 + w.su_sta], sda << 16);
+    /* address 0x80, first bit 1: SCL low, SDA high, SCL high, hold */
+    CHECK_EQ(wout[start], scl << 16);
+    CHECK_EQ(wout[start + 1], sda);
+    CHECK_EQ(wout[start + 2], scl);
+    CHECK_EQ(wout[start + 3], 0);
+    /* STOP at the end */
+    CHECK_EQ(wout[w.len - stop + 1], sda << 16);
+    CHECK_EQ(wout[w.len - stop + 2], scl);
+    CHECK_EQ(wout[w.len - w.buf], sda);
+
+    /* played on the bus: one transaction with the data */
+    sim_bus_reset_stats(&bus);
+    CHECK_EQ(SW_I2C_Wave_Execute(&bus.i2c, &w, msgs, 3, NULL), SW_I2C_OK);
+    CHECK_EQ(rd[0], 0x12);
+    CHECK_EQ(rd[1], 0x34);
+    CHECK_EQ(regfile.regs[0x30], 0x12);
+    CHECK_EQ(bus.xfers, 1);
+    CHECK_EQ(bus.last_xfer.starts, 2);          // repeated
+    CHECK_EQ(bus.last_xfer.stops, 1);
+    CHECK_EQ(bus.last_xfer.bytes, 9);
+    CHECK_EQ(bus.last_xfer.acks, 8);            // all but the last read byte
+
+    /* the lines follow the schedule */
+    CHECK(near(bus.tmin.low_ns, 2, w.tick_ns));
+    CHECK(near(bus.tmin.high_ns, 2, w.tick_ns));
+    CHECK(near(bus.tmin.su_sta_ns, w.su_sta, w.tick_ns));
+    CHECK(near(bus.tmin.hd_sta_ns, w.hd_sta, w.tick_ns));
+    CHECK(near(bus.tmin.su_sto_ns, w.su_sto, w.tick_ns));
+    CHECK(bus.tmin.low_ns >= tm.low_ns);
+    CHECK(bus.tmin.hd_sta_ns >= tm.hd_sta_ns);
+
+    /* tBUF is held before playback returns */
+    memset(rd, 0, sizeof(rd));
+    CHECK_EQ(SW_I2C_Wave_Execute(&bus.i2c, &w, msgs, 3, NULL), SW_I2C_OK);
+    CHECK_EQ(rd[1], 0x34);
+    CHECK(bus.tmin.buf_ns >= w.buf * w.tick_ns - w.buf * w.tick_ns / 50);
+
+    /* the DMA player: same transaction, ends with both lines released */
+    memset(rd, 0, sizeof(rd));
+    sim_bus_reset_stats(&bus);
+    CHECK_EQ(SW_I2C_Wave_Execute(&bus.i2c, &w, msgs, 3, dma_run), SW_I2C_OK);
+    CHECK_EQ(rd[0], 0x12);
+    CHECK_EQ(rd[1], 0x34);
+    CHECK_EQ(bus.last_xfer.stops, 1);
+    CHECK_EQ(bus.last_xfer.acks, 8);
+    CHECK(bus.scl && bus.sda);
+    CHECK(near(bus.tmin.low_ns, 2, w.tick_ns));
+    CHECK(near(bus.tmin.su_sto_ns, w.su_sto, w.tick_ns));
+    CHECK_EQ(SW_I2C_Wave_Execute(&bus.i2c, &w, msgs, 3, dma_run), SW_I2C_OK);
+    CHECK(bus.tmin.buf_ns >= w.buf * w.tick_ns - w.buf * w.tick_ns / 50);
+
+    /* its samples come a full tick after the SCL release word, like the
+     * CPU player's: a target may hold SCL for most of that tick */
+    regfile.base.stretch_ns = 3 * w.tick_ns - w.tick_ns / 4;
+    memset(rd, 0, sizeof(rd));
+    CHECK_EQ(SW_I2C_Wave_Execute(&bus.i2c, &w, msgs, 3, dma_run), SW_I2C_OK);
+    CHECK_EQ(rd[1], 0x34);
+    CHECK(bus.last_xfer.stretches > 0);
+    regfile.base.stretch_ns = 0;
+}
+
+/* The fixed sequence runs to STOP, the decoder finds the failure */
+static void failures(void)
+{
+    uint8_t wr[4] = { 0x50, 1, 2, 3 }, rd[1];
+    sw_i2c_msg_t write_msg[] = { { REG_ADDR << 1, 0, 4, wr } };
+    sw_i2c_msg_t absent_msg[] = { { 0x22 << 1, SW_I2C_M_RD, 1, rd } };
+    sw_i2c_msg_t short_msg[] = { { REG_ADDR << 1, 0, 1, wr } };
+    sw_i2c_msg_t long_msg[] = { { REG_ADDR << 1, 0, 1, wr }, { REG_ADDR << 1, SW_I2C_M_RD, 1, rd } };
+    sw_i2c_wave_t w = { .out = wout, .in = win, .cap = TICKS };
+    sw_i2c_wave_t small = { .out = wout, .in = win, .cap = 40 };
+    size_t idx = 0;
+
+    SW_I2C_Set_Speed(&bus.i2c, SW_I2C_SPEED_FAST);
+    regfile.base.nack_write_at = 2;
+    CHECK_EQ(SW_I2C_Wave_Transfer(&bus.i2c, &w, write_msg, 1, NULL), SW_I2C_ERR_DATA_NACK);
+    CHECK_EQ(SW_I2C_Last_Status(&bus.i2c, &idx), SW_I2C_ERR_DATA_NACK);
+    CHECK_EQ(idx, 2);
+    CHECK_EQ(bus.last_xfer.stops, 1);
+    CHECK_EQ(bus.last_xfer.scl_edges, (5 * 9 + 1) * 2);     // every bit and the STOP: played to the end
+    regfile.base.nack_write_at = -1;
+
+    CHECK_EQ(SW_I2C_Wave_Transfer(&bus.i2c, &w, absent_msg, 1, NULL), SW_I2C_ERR_ADDR_NACK);
+
+    /* a held SCL is seen at the sample point, not waited for */
+    regfile.base.stretch_ns = 20000;
+    CHECK_EQ(SW_I2C_Wave_Transfer(&bus.i2c, &w, write_msg, 1, NULL), SW_I2C_ERR_STRETCH_TIMEOUT);
+    regfile.base.stretch_ns = 0;
+    sim_advance_ns(20000);
+    CHECK_EQ(SW_I2C_Recover(&bus.i2c), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Wave_Transfer(&bus.i2c, &w, write_msg, 1, NULL), SW_I2C_OK);
+    CHECK_EQ(regfile.regs[0x52], 3);
+
+    /* decoding more than was compiled stops at the end of in[] */
+    CHECK_EQ(SW_I2C_Wave_Compile(&w, &bus.i2c, short_msg, 1), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Wave_Execute(&bus.i2c, &w, short_msg, 1, NULL), SW_I2C_OK);
+    CHECK_EQ(SW_I2C_Wave_Decode(&w, write_msg, 1, NULL), SW_I2C_ERR_PARAM);
+    rd[0] = 0x5A;
+    CHECK_EQ(SW_I2C_Wave_Execute(&bus.i2c, &w, long_msg, 2, NULL), SW_I2C_ERR_PARAM);
+    CHECK_EQ(rd[0], 0x5A);
+
+    CHECK_EQ(SW_I2C_Wave_Compile(&small, &bus.i2c, write_msg, 1), SW_I2C_ERR_PARAM);
+    bus.i2c.flags = 0;
+    CHECK_EQ(SW_I2C_Wave_Compile(&w, &bus.i2c, write_msg, 1), SW_I2C_ERR_PARAM);
+    bus.i2c.flags = SW_I2C_FLAG_OPEN_DRAIN;
+}
+
+void test_wave(void)
+{
+    sim_bus_init(&bus);
+    sim_regfile_init(&regfile, REG_ADDR);
+    sim_bus_attach(&bus, &regfile.base);
+    bus.i2c.flags = SW_I2C_FLAG_OPEN_DRAIN;
+    SW_I2C_initial(&bus.i2c);
+    sim_bus_use_fast(&bus, 1);
+    SW_I2C_Calibrate(&bus.i2c);
+
+    schedule(SW_I2C_SPEED_STANDARD);
+    schedule(SW_I2C_SPEED_FAST);
+    schedule(SW_I2C_SPEED_FAST_PLUS);
+    failures();
+}
@@ -1,7 +1,12 @@
 #include <stdlib.h>
+#include <string.h>
 #define TAG "SW_I2C"
 #include "log.h"
 #include "sw_i2c.h"
+#include "sw_i2c_phase.h"
+#if SW_I2C_TRACE
+#include "sw_i2c_trace.h"
+#endif
 
 #ifndef TRUE
 	#define TRUE 1
@@ -10,6 +15,33 @@
 	#define FALSE 0
 #endif
 
+#if SW_I2C_PEC
+#define I2C_PEC(x)      do { x; } while (0)
+
+/* SMBus PEC, CRC-8 with polynomial x^8 + x^2 + x + 1, one step per byte */
+static const uint8_t i2c_crc8[256] =
+{
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3,
+};
+#else
+#define I2C_PEC(x)      do { } while (0)
+#endif
+
 /**
  * @brief Initialize the I2C bus.
  *
@@ -21,14 +53,65 @@ void SW_I2C_initial(sw_i2c_t *d)
 {
 	if (d)
 	{
-		if (d->hal_io_ctl(HAL_IO_OPT_IS_LINE_BUSY, d) == TRUE)
+		uint8_t busy = d->hal_io_ctl(HAL_IO_OPT_IS_LINE_BUSY, d) == TRUE;
+
+		d->hal_init(d);
+		SW_I2C_Set_Speed(d, d->clock_hz);
+		SW_I2C_Calibrate(d);
+		if (busy)
 		{
-			logE("line detected busy (port %d, pin %d)", d->scl_port, d->scl_pin);
+			logE("line detected busy (port %p, pin %lu)", (void *)d->scl_port, (unsigned long)d->scl_pin);
+			if (!(d->flags & SW_I2C_FLAG_NO_RECOVERY) && SW_I2C_Recover(d) != SW_I2C_OK)
+				logE("bus recovery failed");
 		}
-		d->hal_init(d);
 	}
 }
 
+/**
+ * @brief Set the default clock of the bus.
+ *
+ * Targets listed in d->dev_speed keep their own clock. Use the
+ * SW_I2C_SPEED_* profiles or any rate; 0 selects SW_I2C_CLOCK_HZ. The
+ * START/STOP/ACK phase waits are derived from the I2C spec minimums of
+ * the mode the rate falls in, stretched to fill the period; a rate above
+ * what the minimums allow runs at the minimums. Call again after
+ * changing d->rise_ns.
+ *
+ * @param[in] d Pointer to the I2C instance.
+ * @param[in] clock_hz SCL frequency in Hz.
+ */
+void SW_I2C_Set_Speed(sw_i2c_t *d, uint32_t clock_hz)
+{
+	if (d)
+	{
+		d->clock_hz = clock_hz ? clock_hz : SW_I2C_CLOCK_HZ;
+		d->half_ns = 500000000UL / d->clock_hz;
+		d->tm.hz = 0;                       // phase waits follow on the next transaction
+	}
+}
+
+/**
+ * @brief Clock used for a target.
+ *
+ * @param[in] d Pointer to the I2C instance.
+ * @param[in] IICID 8-bit target address, R/W bit ignored.
+ * @return The target's entry in d->dev_speed, the bus clock otherwise.
+ */
+uint32_t SW_I2C_Target_Clock(const sw_i2c_t *d, uint8_t IICID)
+{
+	uint32_t hz = d->clock_hz ? d->clock_hz : SW_I2C_CLOCK_HZ;
+
+	for (uint8_t i = 0; i < d->dev_speed_cnt; i++)
+	{
+		if ((d->dev_speed[i].IICID & ~I2C_READ) == (IICID & ~I2C_READ))
+		{
+			hz = d->dev_speed[i].clock_hz;
+			break;
+		}
+	}
+	return hz;
+}
+
 /**
  * @brief Deinitialize the I2C bus.
  *
@@ -44,101 +127,165 @@ void SW_I2C_deinit(sw_i2c_t *d)
 	}
 }
 
-static void sda_out(sw_i2c_t *d, uint8_t out)
+/**
+ * Line primitives: single register store when the port filled d->fast,
+ * hal_io_ctl otherwise.
+ */
+static inline void scl_high(sw_i2c_t *d)
+{
+    if (d->fast.scl_set)
+        SW_I2C_REG_WRITE(d->fast.scl_set, d->fast.scl_mask);
+    else
+        d->hal_io_ctl(HAL_IO_OPT_SET_SCL_HIGH, d);
+}
+
+static inline void scl_low(sw_i2c_t *d)
+{
+    if (d->fast.scl_set)
+        SW_I2C_REG_WRITE(d->fast.scl_clr, d->fast.scl_mask);
+    else
+        d->hal_io_ctl(HAL_IO_OPT_SET_SCL_LOW, d);
+}
+
+static inline void sda_high(sw_i2c_t *d)
 {
-    if(out)
+    if (d->fast.scl_set)
+        SW_I2C_REG_WRITE(d->fast.sda_set, d->fast.sda_mask);
+    else
         d->hal_io_ctl(HAL_IO_OPT_SET_SDA_HIGH, d);
+}
+
+static inline void sda_low(sw_i2c_t *d)
+{
+    if (d->fast.scl_set)
+        SW_I2C_REG_WRITE(d->fast.sda_clr, d->fast.sda_mask);
     else
         d->hal_io_ctl(HAL_IO_OPT_SET_SDA_LOW, d);
 }
 
-static void i2c_clk_data_out(sw_i2c_t *d)
+/**
+ * SDA direction. With SW_I2C_FLAG_OPEN_DRAIN the pin stays an open-drain
+ * output: releasing it (latch high) lets the target drive the line and the
+ * level is read back from the input register, so no pin reconfiguration.
+ */
+static inline void sda_input(sw_i2c_t *d)
 {
-    d->hal_io_ctl(HAL_IO_OPT_SET_SCL_HIGH, d);
-    d->hal_delay_us(SW_I2C_WAIT_TIME);
-    d->hal_io_ctl(HAL_IO_OPT_SET_SCL_LOW, d);
+    if (d->flags & SW_I2C_FLAG_OPEN_DRAIN)
+        sda_high(d);
+    else
+        d->hal_io_ctl(HAL_IO_OPT_SET_SDA_INPUT, d);
 }
 
-static void i2c_port_initial(sw_i2c_t *d)
+static inline void sda_output(sw_i2c_t *d)
 {
-    portENTER_CRITICAL();
-    d->hal_io_ctl(HAL_IO_OPT_SET_SDA_HIGH, d);
-    d->hal_io_ctl(HAL_IO_OPT_SET_SCL_HIGH, d);
-    portEXIT_CRITICAL();
+    if (d->flags & SW_I2C_FLAG_OPEN_DRAIN)
+        sda_high(d);
+    else
+        d->hal_io_ctl(HAL_IO_OPT_SET_SDA_OUTPUT, d);
 }
 
-
-static uint8_t SW_I2C_ReadVal_SDA(sw_i2c_t *d)
+/**
+ * Wait in nanoseconds, less the calibrated cost of the edge before it and of
+ * the delay call itself. Without hal_delay_ns the wait is rounded up to
+ * whole microseconds.
+ */
+static inline void i2c_wait(sw_i2c_t *d, uint32_t ns)
 {
-    
-    return d->hal_io_ctl(HAL_IO_OPT_GET_SDA_LEVEL, d);
+    if (ns <= d->wait_trim_ns)
+        return;
+    ns -= d->wait_trim_ns;
+    if (d->hal_delay_ns)
+        d->hal_delay_ns(ns);
+    else
+        d->hal_delay_us((ns + 999) / 1000);
 }
 
+/* Switch the phase waits to a clock, derived once per clock change */
+static void i2c_use_clock(sw_i2c_t *d, uint32_t hz)
+{
+    if (d->tm.hz != hz)
+        d->tm = sw_i2c_spec_timing(hz, d->rise_ns);
+    d->half_ns = (d->tm.low_ns + d->tm.high_ns) >> 1;
+}
 
-static void i2c_start_condition(sw_i2c_t *d)
+/**
+ * Pick the timing for a transaction: the target's override from
+ * d->dev_speed if listed, the bus clock otherwise.
+ */
+static void i2c_select_speed(sw_i2c_t *d, uint8_t IICID)
 {
-    portENTER_CRITICAL();
-    d->hal_io_ctl(HAL_IO_OPT_SET_SDA_HIGH, d);
-    d->hal_io_ctl(HAL_IO_OPT_SET_SCL_HIGH, d);
-    portEXIT_CRITICAL();
-    d->hal_delay_us(SW_I2C_WAIT_TIME);
-    d->hal_io_ctl(HAL_IO_OPT_SET_SDA_LOW, d);
-    d->hal_delay_us(SW_I2C_WAIT_TIME);
-    d->hal_io_ctl(HAL_IO_OPT_SET_SCL_LOW, d);
-    d->hal_delay_us(SW_I2C_WAIT_TIME << 1);
+    i2c_use_clock(d, SW_I2C_Target_Clock(d, IICID));
 }
 
-static void i2c_stop_condition(sw_i2c_t *d)
+static inline uint8_t scl_level(sw_i2c_t *d)
 {
-    portENTER_CRITICAL();
-    d->hal_io_ctl(HAL_IO_OPT_SET_SDA_LOW, d);
-    d->hal_io_ctl(HAL_IO_OPT_SET_SCL_HIGH, d);
-    portEXIT_CRITICAL();
-    d->hal_delay_us(SW_I2C_WAIT_TIME);
-    d->hal_io_ctl(HAL_IO_OPT_SET_SDA_HIGH, d);
-    d->hal_delay_us(SW_I2C_WAIT_TIME);
+    if (d->fast.scl_set)
+        return (SW_I2C_REG_READ(d->fast.scl_in) & d->fast.scl_mask) ? 1 : 0;
+    return d->hal_io_ctl(HAL_IO_OPT_GET_SCL_LEVEL, d);
 }
 
-static uint8_t i2c_check_ack(sw_i2c_t *d)
+/**
+ * Clock stretching: after releasing SCL wait until the line really is high.
+ * Polls every quarter period up to d->stretch_timeout_us; on timeout the
+ * transaction is marked failed through d->stretch_fault.
+ */
+static uint8_t i2c_scl_wait_high(sw_i2c_t *d)
 {
-    uint8_t ack;
-    int i;
-    unsigned int temp;
-    portENTER_CRITICAL();
-    d->hal_io_ctl(HAL_IO_OPT_SET_SDA_INPUT, d);
-    d->hal_io_ctl(HAL_IO_OPT_SET_SCL_HIGH, d);
-    portEXIT_CRITICAL();
-    ack = 0;
-    d->hal_delay_us(SW_I2C_WAIT_TIME);
-    for (i = 10; i > 0; i--)
+    uint32_t step, limit, waited = 0;
+
+    if (!(d->flags & SW_I2C_FLAG_CLOCK_STRETCH) || scl_level(d))
+        return TRUE;
+
+    step = d->half_ns >> 2;
+    if (step == 0)
+        step = 1;
+    limit = (d->stretch_timeout_us ? d->stretch_timeout_us : SW_I2C_STRETCH_TIMEOUT_US) * 1000UL;
+    while (!scl_level(d))
     {
-        temp = !(SW_I2C_ReadVal_SDA(d));
-        if (temp)
+        if (waited >= limit)
         {
-            ack = 1;
-            break;
+            d->stretch_fault = TRUE;
+            return FALSE;
         }
+        i2c_wait(d, step);
+        waited += step;
     }
+    return TRUE;
+}
+
+static void i2c_port_initial(sw_i2c_t *d)
+{
     portENTER_CRITICAL();
-    d->hal_io_ctl(HAL_IO_OPT_SET_SCL_LOW, d);
-    d->hal_io_ctl(HAL_IO_OPT_SET_SDA_OUTPUT, d);
+    sda_high(d);
+    scl_high(d);
     portEXIT_CRITICAL();
-    d->hal_delay_us(SW_I2C_WAIT_TIME);
-    return ack;
 }
 
-static void i2c_check_not_ack(sw_i2c_t *d)
+
+static inline uint8_t SW_I2C_ReadVal_SDA(sw_i2c_t *d)
 {
-    d->hal_io_ctl(HAL_IO_OPT_SET_SDA_INPUT, d);
-    i2c_clk_data_out(d);
-    d->hal_io_ctl(HAL_IO_OPT_SET_SDA_OUTPUT, d);
-    d->hal_delay_us(SW_I2C_WAIT_TIME);
+    if (d->fast.scl_set)
+        return (SW_I2C_REG_READ(d->fast.sda_in) & d->fast.sda_mask) ? 1 : 0;
+    return d->hal_io_ctl(HAL_IO_OPT_GET_SDA_LEVEL, d);
 }
 
+
+/* Bit phases, shared with sw_i2c.hpp, on top of the primitives above */
+#define SW_I2C_PH_DECL              static
+#define SW_I2C_PH_CTX               sw_i2c_t *d
+#define SW_I2C_PH_SCL_HIGH(d)       scl_high(d)
+#define SW_I2C_PH_SCL_LOW(d)        scl_low(d)
+#define SW_I2C_PH_SDA_HIGH(d)       sda_high(d)
+#define SW_I2C_PH_SDA_LOW(d)        sda_low(d)
+#define SW_I2C_PH_SDA_INPUT(d)      sda_input(d)
+#define SW_I2C_PH_SDA_OUTPUT(d)     sda_output(d)
+#define SW_I2C_PH_SDA_GET(d)        SW_I2C_ReadVal_SDA(d)
+#define SW_I2C_PH_SCL_WAIT_HIGH(d)  i2c_scl_wait_high(d)
+#define SW_I2C_PH_WAIT(d, t)        i2c_wait(d, (d)->tm.t)
+#include "sw_i2c_phase.h"
+
 static void i2c_slave_address(sw_i2c_t *d, uint8_t IICID, uint8_t readwrite)
 {
-    int x;
-
     if (readwrite)
     {
         IICID |= I2C_READ;
@@ -148,79 +295,747 @@ static void i2c_slave_address(sw_i2c_t *d, uint8_t IICID, uint8_t readwrite)
         IICID &= ~I2C_READ;
     }
 
-    d->hal_io_ctl(HAL_IO_OPT_SET_SCL_LOW, d);
-    for (x = 7; x >= 0; x--)
-    {
-        sda_out(d, IICID & (1 << x));
-        d->hal_delay_us(SW_I2C_WAIT_TIME);
-        i2c_clk_data_out(d);
+    I2C_PEC(d->pec = i2c_crc8[d->pec ^ IICID]);
+    i2c_shift_out(d, IICID);
+}
+
+/* The PEC step runs in the SCL low phase ahead of the first bit */
+static void SW_I2C_Write_Data(sw_i2c_t *d, uint8_t data)
+{
+    I2C_PEC(d->pec = i2c_crc8[d->pec ^ data]);
+    i2c_shift_out(d, data);
+}
+
+static uint8_t SW_I2C_Read_Data(sw_i2c_t *d)
+{
+    uint8_t readdata = i2c_shift_in(d);
+
+    I2C_PEC(d->pec = i2c_crc8[d->pec ^ readdata]); // SCL low ahead of the ACK clock
+    return readdata;
+}
+
+/* Shortest of SW_I2C_CAL_ROUNDS runs, so a preempted round does not count */
+#define I2C_CAL_MIN(out, body)                          \
+    do {                                                \
+        (out) = UINT32_MAX;                             \
+        for (int r_ = 0; r_ < SW_I2C_CAL_ROUNDS; r_++)  \
+        {                                               \
+            uint32_t t_ = d->hal_cycles();              \
+            body;                                       \
+            t_ = d->hal_cycles() - t_;                  \
+            if (t_ < (out))                             \
+                (out) = t_;                             \
+        }                                               \
+    } while (0)
+
+/**
+ * @brief Measure the cost of a delay call and of a line edge.
+ *
+ * Every i2c_wait follows an edge, so a phase would outlast its wait by
+ * that much. The rate of hal_cycles is
+ * taken from a long SW_I2C_CAL_REF_NS wait, then a short wait and an SCL
+ * release (harmless on an idle bus) are timed and their excess stored in
+ * d->wait_trim_ns. Runs from SW_I2C_initial; call again after changing the
+ * CPU clock or d->fast. Without hal_cycles the trim stays 0.
+ *
+ * @param[in] d Pointer to the I2C instance.
+ */
+void SW_I2C_Calibrate(sw_i2c_t *d)
+{
+	uint32_t ref, base, wait, edge, over_ns;
+
+	if (d == NULL || d->hal_cycles == NULL)
+		return;
+	d->wait_trim_ns = 0;
+
+	I2C_CAL_MIN(ref, i2c_wait(d, SW_I2C_CAL_REF_NS));
+	if (ref == 0)
+		return;
+	I2C_CAL_MIN(base, (void)0);
+	I2C_CAL_MIN(wait, i2c_wait(d, SW_I2C_CAL_SHORT_NS));
+	I2C_CAL_MIN(edge, scl_high(d));
 
+	/* cycles to ns against the reference wait */
+	over_ns = (uint64_t)(wait - base) * SW_I2C_CAL_REF_NS / ref;
+	over_ns = over_ns > SW_I2C_CAL_SHORT_NS ? over_ns - SW_I2C_CAL_SHORT_NS : 0;
+	/* one edge per wait: no phase drops below its spec minimum, and the
+	 * low half of a data bit (SCL and SDA edges) runs one edge long */
+	d->wait_trim_ns = over_ns + (uint64_t)(edge > base ? edge - base : 0) * SW_I2C_CAL_REF_NS / ref;
+}
+
+/**
+ * Transaction engine. Every phase returns a status and the caller stops at
+ * the first failure, so a missing target costs one address byte.
+ */
+
+/* Fold a pending stretch timeout into the result of a phase */
+static sw_i2c_status_e i2c_phase_status(sw_i2c_t *d, uint8_t ok, sw_i2c_status_e err)
+{
+    if (d->stretch_fault)
+        return SW_I2C_ERR_STRETCH_TIMEOUT;
+    return ok ? SW_I2C_OK : err;
+}
+
+#if SW_I2C_STATS || SW_I2C_TRACE
+static inline uint32_t i2c_cycles(sw_i2c_t *d)
+{
+    return d->hal_cycles ? d->hal_cycles() : 0;
+}
+#endif
+
+#if SW_I2C_TRACE
+#define I2C_TRACE(x)    do { x; } while (0)
+
+/* Keep the first wire bytes of the running transaction for its trace record */
+static inline void i2c_trace_byte(sw_i2c_t *d, uint8_t byte, uint8_t ack, uint8_t start)
+{
+    uint8_t n = d->trace_wire;
+
+    if (n < SW_I2C_TRACE_BYTES)
+    {
+        d->trace_bytes[n] = byte;
+        d->trace_ack |= (ack != 0) << n;
+        d->trace_start |= start << n;
     }
+    if (n != 0xFF)
+        d->trace_wire = n + 1;
 }
+#else
+#define I2C_TRACE(x)    do { } while (0)
+#endif
+
+#if SW_I2C_STATS
+#define I2C_STATS(x)    do { x; } while (0)
 
-static void i2c_register_address(sw_i2c_t *d, uint8_t addr)
+static uint8_t i2c_log2_bin(uint32_t cycles)
 {
-    int x;
+    uint8_t bin = cycles ? 32 - __builtin_clz(cycles) : 0;
 
-    d->hal_io_ctl(HAL_IO_OPT_SET_SCL_LOW, d);
+    return bin < SW_I2C_STATS_BINS ? bin : SW_I2C_STATS_BINS - 1;
+}
 
-    for (x = 7; x >= 0; x--)
+/* Slot of a target, claimed on first use; NULL once the table is full */
+static sw_i2c_counters_t * i2c_stats_target(sw_i2c_stats_t *s, uint8_t IICID)
+{
+    IICID &= ~I2C_READ;
+    for (uint8_t i = 0; i < SW_I2C_STATS_TARGETS; i++)
     {
-        sda_out(d, addr & (1 << x));
-        d->hal_delay_us(SW_I2C_WAIT_TIME);
-        i2c_clk_data_out(d);
+        if (!s->target[i].used)
+        {
+            s->target[i].used = TRUE;
+            s->target[i].IICID = IICID;
+            return &s->target[i];
+        }
+        if (s->target[i].IICID == IICID)
+            return &s->target[i];
     }
+    return NULL;
 }
 
-static void i2c_send_ack(sw_i2c_t *d)
+static void i2c_stats_count(sw_i2c_counters_t *c, sw_i2c_t *d, sw_i2c_status_e st, uint32_t hold)
 {
-    portENTER_CRITICAL();
-    d->hal_io_ctl(HAL_IO_OPT_SET_SDA_OUTPUT, d);
-    d->hal_io_ctl(HAL_IO_OPT_SET_SDA_LOW, d);
+    c->transfers++;
+    c->bytes_out += d->xfer_out;
+    c->bytes_in += d->xfer_in;
+    c->hold_cycles += hold;
+    if (st == SW_I2C_ERR_ADDR_NACK || st == SW_I2C_ERR_REG_NACK || st == SW_I2C_ERR_DATA_NACK)
+        c->nacks++;
+    else if (st != SW_I2C_OK)
+        c->aborts++;
+}
+
+/* One finished transaction: hold from START to STOP, latency from the call */
+static void i2c_stats_record(sw_i2c_t *d, uint8_t IICID, sw_i2c_status_e st, uint32_t t_call, uint32_t t_start, uint32_t now)
+{
+    sw_i2c_counters_t *c;
+
+    portENTER_CRITICAL(); // SW_I2C_Stats_Get never sees half an update
+    c = i2c_stats_target(&d->stats, IICID);
+    i2c_stats_count(&d->stats.bus, d, st, now - t_start);
+    if (c)
+        i2c_stats_count(c, d, st, now - t_start);
+    else
+        d->stats.untracked++;
+    d->stats.latency[i2c_log2_bin(now - t_call)]++;
     portEXIT_CRITICAL();
-    d->hal_delay_us(SW_I2C_WAIT_TIME);
-    d->hal_io_ctl(HAL_IO_OPT_SET_SCL_HIGH, d);
-    d->hal_delay_us(SW_I2C_WAIT_TIME << 1);
-    d->hal_io_ctl(HAL_IO_OPT_SET_SDA_LOW, d);
-    d->hal_delay_us(SW_I2C_WAIT_TIME << 1);
+}
+
+static void i2c_stats_add(uint64_t *acc, uint32_t cycles)
+{
     portENTER_CRITICAL();
-    d->hal_io_ctl(HAL_IO_OPT_SET_SCL_LOW, d);
-    d->hal_io_ctl(HAL_IO_OPT_SET_SDA_OUTPUT, d);
+    *acc += cycles;
     portEXIT_CRITICAL();
-    d->hal_delay_us(SW_I2C_WAIT_TIME);
 }
+#else
+#define I2C_STATS(x)    do { } while (0)
+#endif
 
-static void SW_I2C_Write_Data(sw_i2c_t *d, uint8_t data)
+/* Wait of the implicit locks, d->lock_timeout_ms 0 = forever */
+static inline TickType_t i2c_lock_ticks(sw_i2c_t *d)
 {
-    int x;
-    d->hal_io_ctl(HAL_IO_OPT_SET_SCL_LOW, d);
-    for (x = 7; x >= 0; x--)
+    return d->lock_timeout_ms ? pdMS_TO_TICKS(d->lock_timeout_ms) : portMAX_DELAY;
+}
+
+static sw_i2c_status_e i2c_lock(sw_i2c_t *d, TickType_t ticks)
+{
+#if SW_I2C_STATS
+    uint32_t t0 = i2c_cycles(d);
+#endif
+
+    if (xSemaphoreTake(d->i2c_sem, ticks) != pdTRUE)
     {
-        sda_out(d, data & (1 << x));
-        d->hal_delay_us(SW_I2C_WAIT_TIME);
-        i2c_clk_data_out(d);
+        I2C_STATS(d->stats.lock_timeouts++);
+        d->status = SW_I2C_ERR_LOCK_TIMEOUT;
+        return SW_I2C_ERR_LOCK_TIMEOUT;
     }
+    I2C_STATS(d->lock_at = i2c_cycles(d));
+    I2C_STATS(i2c_stats_add(&d->stats.lock_wait_cycles, d->lock_at - t0));
+    return SW_I2C_OK;
 }
 
-static uint8_t SW_I2C_Read_Data(sw_i2c_t *d)
+static void i2c_unlock(sw_i2c_t *d)
+{
+    I2C_STATS(i2c_stats_add(&d->stats.lock_hold_cycles, i2c_cycles(d) - d->lock_at));
+    xSemaphoreGive(d->i2c_sem);
+}
+
+/* SCL released, wait up to the stretch timeout for it to rise */
+static uint8_t i2c_scl_settle(sw_i2c_t *d, uint32_t step)
 {
-    int x;
-    uint8_t readdata = 0;
-    d->hal_io_ctl(HAL_IO_OPT_SET_SDA_INPUT, d);
-    for (x = 8; x--;)
+    uint32_t waited = 0, limit;
+
+    limit = (d->stretch_timeout_us ? d->stretch_timeout_us : SW_I2C_STRETCH_TIMEOUT_US) * 1000UL;
+    while (!scl_level(d))
     {
-        d->hal_io_ctl(HAL_IO_OPT_SET_SCL_HIGH, d);
-        readdata <<= 1;
-        if (SW_I2C_ReadVal_SDA(d))
-            readdata |= 0x01;
-        d->hal_delay_us(SW_I2C_WAIT_TIME);
-        d->hal_io_ctl(HAL_IO_OPT_SET_SCL_LOW, d);
-        d->hal_delay_us(SW_I2C_WAIT_TIME);
+        if (waited >= limit)
+            return FALSE;
+        i2c_wait(d, step);
+        waited += step;
     }
-    d->hal_io_ctl(HAL_IO_OPT_SET_SDA_OUTPUT, d);
-    return readdata;
+    return TRUE;
+}
+
+/**
+ * Bus recovery with the lock held. A target reset or glitched in the middle
+ * of a read keeps driving SDA low while it waits for the rest of its byte;
+ * up to nine SCL pulses at Standard-mode speed let it shift the byte out
+ * and see a NACK, then a STOP returns every target to idle.
+ */
+static sw_i2c_status_e i2c_recover(sw_i2c_t *d)
+{
+    const uint32_t half = 500000000UL / SW_I2C_SPEED_STANDARD;
+
+    d->recoveries++;
+    i2c_port_initial(d);
+    if (!i2c_scl_settle(d, half))
+    {
+        d->recovery_failures++;         // SCL itself is held, clocks cannot help
+        return SW_I2C_ERR_BUS_BUSY;
+    }
+    for (uint8_t i = 0; i < 9 && !SW_I2C_ReadVal_SDA(d); i++)
+    {
+        scl_low(d);
+        i2c_wait(d, half);
+        scl_high(d);
+        i2c_scl_settle(d, half);
+        i2c_wait(d, half);
+    }
+
+    scl_low(d);
+    i2c_wait(d, half);
+    sda_low(d);
+    i2c_wait(d, half);
+    scl_high(d);
+    i2c_scl_settle(d, half);
+    i2c_wait(d, half);
+    sda_high(d);
+    i2c_wait(d, half);
+
+    if (!scl_level(d) || !SW_I2C_ReadVal_SDA(d))
+    {
+        d->recovery_failures++;
+        return SW_I2C_ERR_BUS_BUSY;
+    }
+    return SW_I2C_OK;
+}
+
+/* Per-transaction setup with the bus lock held: idle lines, speed, busy check */
+static sw_i2c_status_e i2c_begin(sw_i2c_t *d, uint8_t IICID)
+{
+    i2c_port_initial(d);
+    d->stretch_fault = FALSE;
+    d->nack_index = 0;
+    I2C_PEC(d->pec = 0);
+    if (!scl_level(d) || !SW_I2C_ReadVal_SDA(d))
+    {
+        if ((d->flags & SW_I2C_FLAG_NO_RECOVERY) || i2c_recover(d) != SW_I2C_OK)
+            return SW_I2C_ERR_BUS_BUSY;
+    }
+    i2c_select_speed(d, IICID);
+    return SW_I2C_OK;
+}
+
+/* STOP unless the bus never got ours, record the status */
+static sw_i2c_status_e i2c_finish(sw_i2c_t *d, sw_i2c_status_e st)
+{
+    if (st != SW_I2C_ERR_BUS_BUSY)
+        i2c_stop_condition(d);
+    if (st == SW_I2C_OK && d->stretch_fault)
+        st = SW_I2C_ERR_STRETCH_TIMEOUT;
+    d->status = st;
+    return st;
+}
+
+/* (repeated) START and address byte */
+static sw_i2c_status_e i2c_address(sw_i2c_t *d, uint8_t IICID, uint8_t readwrite, uint8_t repeated)
+{
+    uint8_t ack;
+
+    i2c_start_condition(d, repeated);
+    i2c_slave_address(d, IICID, readwrite);
+    ack = i2c_check_ack(d);
+    I2C_TRACE(i2c_trace_byte(d, readwrite ? (IICID | I2C_READ) : (IICID & ~I2C_READ), ack, 1));
+    return i2c_phase_status(d, ack, SW_I2C_ERR_ADDR_NACK);
+}
+
+static sw_i2c_status_e i2c_write_bytes(sw_i2c_t *d, const uint8_t *pdata, size_t cnt)
+{
+    uint8_t ack;
+
+    for (size_t i = 0; i < cnt; i++)
+    {
+        SW_I2C_Write_Data(d, pdata[i]);
+        I2C_STATS(d->xfer_out++);
+        ack = i2c_check_ack(d);
+        I2C_TRACE(i2c_trace_byte(d, pdata[i], ack, 0));
+        if (!ack || d->stretch_fault)
+        {
+            d->nack_index = i;
+            return i2c_phase_status(d, ack, SW_I2C_ERR_DATA_NACK);
+        }
+    }
+    return SW_I2C_OK;
+}
+
+/* ACK every byte but the last one, which gets the NACK unless more follow */
+static sw_i2c_status_e i2c_read_bytes(sw_i2c_t *d, uint8_t *pdata, size_t cnt, uint8_t more)
+{
+    for (size_t i = 0; i < cnt; i++)
+    {
+        uint8_t ack = more || i + 1 < cnt;
+
+        pdata[i] = SW_I2C_Read_Data(d);
+        I2C_STATS(d->xfer_in++);
+        I2C_TRACE(i2c_trace_byte(d, pdata[i], ack, 0));
+        i2c_send_ack(d, ack);
+        if (d->stretch_fault)
+            return SW_I2C_ERR_STRETCH_TIMEOUT;
+    }
+    return SW_I2C_OK;
+}
+
+static inline uint8_t i2c_pec(const sw_i2c_t *d)
+{
+#if SW_I2C_PEC
+    return d->pec;
+#else
+    (void)d;
+    return 0;
+#endif
+}
+
+/**
+ * Read segment with the SMBus extras: with SW_I2C_M_RECV_LEN the first
+ * byte is the count of the bytes that follow, with SW_I2C_M_PEC one more
+ * byte is read and checked against the running PEC.
+ */
+static sw_i2c_status_e i2c_read_msg(sw_i2c_t *d, sw_i2c_msg_t *m)
+{
+    uint8_t pec = (m->flags & SW_I2C_M_PEC) != 0, crc, got;
+    uint8_t *buf = m->buf;
+    size_t len = m->len;
+    sw_i2c_status_e st;
+
+    if (m->flags & SW_I2C_M_RECV_LEN)
+    {
+        st = i2c_read_bytes(d, buf, 1, TRUE);
+        if (st != SW_I2C_OK)
+            return st;
+        if (buf[0] == 0 || buf[0] > m->len - 1)
+        {
+            i2c_read_bytes(d, &got, 1, FALSE);  // the count was ACKed, end the read cleanly
+            return SW_I2C_ERR_PROTOCOL;
+        }
+        len = buf[0];
+        m->len = 1 + len;
+        buf++;
+    }
+    st = i2c_read_bytes(d, buf, len, pec);
+    if (st != SW_I2C_OK || !pec)
+        return st;
+    crc = i2c_pec(d);
+    st = i2c_read_bytes(d, &got, 1, FALSE);
+    if (st == SW_I2C_OK && got != crc)
+        st = SW_I2C_ERR_PEC;
+    return st;
+}
+
+static sw_i2c_status_e i2c_check_msgs(const sw_i2c_msg_t *msgs, uint32_t num)
+{
+    if (msgs == NULL || num == 0)
+        return SW_I2C_ERR_PARAM;
+    for (uint32_t i = 0; i < num; i++)
+    {
+        if (msgs[i].len != 0 && msgs[i].buf == NULL)
+            return SW_I2C_ERR_PARAM;
+#if !SW_I2C_PEC
+        if (msgs[i].flags & SW_I2C_M_PEC)
+            return SW_I2C_ERR_PARAM;
+#endif
+        if (msgs[i].flags & SW_I2C_M_RD)
+        {
+            if (msgs[i].len == 0 || (msgs[i].flags & SW_I2C_M_NOSTART))
+                return SW_I2C_ERR_PARAM;
+            if ((msgs[i].flags & SW_I2C_M_RECV_LEN) && msgs[i].len < 2)
+                return SW_I2C_ERR_PARAM;
+        }
+        else if (msgs[i].flags & SW_I2C_M_RECV_LEN)
+        {
+            return SW_I2C_ERR_PARAM;
+        }
+        else if ((msgs[i].flags & SW_I2C_M_NOSTART) && i > 0 && (msgs[i - 1].flags & SW_I2C_M_RD))
+        {
+            return SW_I2C_ERR_PARAM;
+        }
+    }
+    return SW_I2C_OK;
+}
+
+/* Run the segments back to back with repeated STARTs; lock held, no STOP */
+static sw_i2c_status_e i2c_transfer_locked(sw_i2c_t *d, sw_i2c_msg_t *msgs, uint32_t num)
+{
+    sw_i2c_status_e st = i2c_begin(d, msgs[0].IICID);
+
+    for (uint32_t i = 0; i < num && st == SW_I2C_OK; i++)
+    {
+        sw_i2c_msg_t *m = &msgs[i];
+
+        if (i == 0 || !(m->flags & SW_I2C_M_NOSTART))
+        {
+            i2c_select_speed(d, m->IICID);
+            st = i2c_address(d, m->IICID, (m->flags & SW_I2C_M_RD) ? READ_CMD : WRITE_CMD, i > 0);
+            if (st != SW_I2C_OK)
+                break;
+        }
+        if (m->flags & SW_I2C_M_RD)
+        {
+            st = i2c_read_msg(d, m);
+        }
+        else
+        {
+            st = i2c_write_bytes(d, m->buf, m->len);
+            if (st == SW_I2C_OK && (m->flags & SW_I2C_M_PEC))
+            {
+                uint8_t crc = i2c_pec(d);
+
+                st = i2c_write_bytes(d, &crc, 1);
+                if (st == SW_I2C_ERR_DATA_NACK)
+                    d->nack_index = m->len;
+            }
+            if (st == SW_I2C_ERR_DATA_NACK && (m->flags & SW_I2C_M_REG))
+                st = SW_I2C_ERR_REG_NACK;
+        }
+    }
+    return st;
+}
+
+/* Whole transaction with the lock held, STOP included; t_call stamps the API entry */
+static sw_i2c_status_e i2c_transact(sw_i2c_t *d, sw_i2c_msg_t *msgs, uint32_t num, uint32_t t_call)
+{
+    sw_i2c_status_e st;
+#if SW_I2C_STATS || SW_I2C_TRACE
+    uint32_t t_start = i2c_cycles(d), t_stop;
+#endif
+
+    I2C_STATS(d->xfer_out = d->xfer_in = 0);
+    I2C_TRACE(d->trace_wire = d->trace_ack = d->trace_start = 0);
+    st = i2c_finish(d, i2c_transfer_locked(d, msgs, num));
+    if (st == SW_I2C_ERR_STRETCH_TIMEOUT && !(d->flags & SW_I2C_FLAG_NO_RECOVERY))
+        i2c_recover(d);                 // a target gave up mid-byte, free the bus for the next caller
+#if SW_I2C_STATS || SW_I2C_TRACE
+    t_stop = i2c_cycles(d);
+#endif
+    I2C_STATS(i2c_stats_record(d, msgs[0].IICID, st, t_call, t_start, t_stop));
+    I2C_TRACE(if (d->trace) SW_I2C_Trace_Record(d->trace, d, msgs, num, st, t_start, t_stop - t_start));
+    return st;
+}
+
+/**
+ * Register read/write shared by the public 8/16-bit address variants. With
+ * d->chunk_len set a read comes in pieces from advancing register
+ * addresses and the lock is given back between them, so a higher priority
+ * task waiting for the bus gets it at the next chunk boundary. Writes are
+ * never split: a target may act on a write only at its STOP (an EEPROM
+ * page, a multi-byte setting), so each one stays one transaction.
+ * Chunking assumes the target auto-increments: a FIFO data register read
+ * in chunks would be read from the wrong addresses after the first one.
+ */
+static sw_i2c_status_e i2c_reg_xfer(sw_i2c_t *d, uint8_t IICID, uint16_t regaddr, uint8_t alen,
+                                    uint8_t *pdata, size_t cnt, uint8_t rd)
+{
+    size_t off = 0, n, chunk = rd && d->chunk_len ? d->chunk_len : cnt;
+    uint32_t t_call = 0;
+    sw_i2c_status_e st;
+
+    if ((rd && cnt == 0) || (cnt != 0 && pdata == NULL))
+        return SW_I2C_ERR_PARAM;
+    I2C_STATS(t_call = i2c_cycles(d));
+    st = i2c_lock(d, i2c_lock_ticks(d));
+    if (st != SW_I2C_OK)
+        return st;
+    for (;;)
+    {
+        uint16_t at = regaddr + off;
+        uint8_t reg[2] = { (uint8_t)(at >> 8), (uint8_t)at };
+        sw_i2c_msg_t msgs[2];
+
+        n = cnt - off < chunk ? cnt - off : chunk;
+        msgs[0] = (sw_i2c_msg_t){ .IICID = IICID, .flags = SW_I2C_M_REG, .len = alen, .buf = &reg[2 - alen] };
+        msgs[1] = (sw_i2c_msg_t){ .IICID = IICID, .flags = rd ? SW_I2C_M_RD : SW_I2C_M_NOSTART,
+                                  .len = n, .buf = pdata + off };
+        st = i2c_transact(d, msgs, 2, t_call);
+        if (st == SW_I2C_ERR_DATA_NACK)
+            d->nack_index += off;
+        off += n;
+        if (st != SW_I2C_OK || off >= cnt)
+            break;
+
+        i2c_unlock(d);
+        I2C_STATS(t_call = i2c_cycles(d));
+        st = i2c_lock(d, i2c_lock_ticks(d));
+        if (st != SW_I2C_OK)
+            return st;
+    }
+    i2c_unlock(d);
+    return st;
+}
+
+static sw_i2c_status_e i2c_reg_read(sw_i2c_t *d, uint8_t IICID, uint16_t regaddr, uint8_t alen, uint8_t *pdata, size_t rcnt)
+{
+    if (d == NULL)
+        return SW_I2C_ERR_PARAM;
+    return i2c_reg_xfer(d, IICID, regaddr, alen, pdata, rcnt, 1);
+}
+
+static sw_i2c_status_e i2c_reg_write(sw_i2c_t *d, uint8_t IICID, uint16_t regaddr, uint8_t alen, const uint8_t *pdata, size_t rcnt)
+{
+    if (d == NULL)
+        return SW_I2C_ERR_PARAM;
+    return i2c_reg_xfer(d, IICID, regaddr, alen, (uint8_t *)pdata, rcnt, 0);
+}
+
+/**
+ * @brief Clock a stuck bus free: up to nine SCL pulses until SDA is
+ * released, then a STOP.
+ *
+ * Runs by itself from SW_I2C_initial when the lines are busy, before a
+ * transaction that finds them low and after a clock stretch timeout,
+ * unless SW_I2C_FLAG_NO_RECOVERY is set. Counted in d->recoveries.
+ *
+ * @param[in] d Pointer to the I2C instance.
+ * @return SW_I2C_OK, SW_I2C_ERR_BUS_BUSY if a line stays low, or
+ *         SW_I2C_ERR_LOCK_TIMEOUT.
+ */
+sw_i2c_status_e SW_I2C_Recover(sw_i2c_t *d)
+{
+	sw_i2c_status_e st;
+
+	if (d == NULL)
+		return SW_I2C_ERR_PARAM;
+	st = i2c_lock(d, i2c_lock_ticks(d));
+	if (st != SW_I2C_OK)
+		return st;
+	st = i2c_recover(d);
+	i2c_unlock(d);
+	return st;
+}
+
+/**
+ * @brief SW_I2C_Recover for a caller that holds the bus lock, e.g. an
+ * engine that drives the lines itself and finds them low.
+ *
+ * @param[in] d Pointer to the I2C instance, locked with SW_I2C_Lock.
+ * @return SW_I2C_OK or SW_I2C_ERR_BUS_BUSY if a line stays low.
+ */
+sw_i2c_status_e SW_I2C_Recover_Locked(sw_i2c_t *d)
+{
+	if (d == NULL)
+		return SW_I2C_ERR_PARAM;
+	return i2c_recover(d);
+}
+
+/**
+ * @brief Execute a combined transaction.
+ *
+ * Segments are separated by repeated STARTs (unless SW_I2C_M_NOSTART
+ * continues the previous write) and the whole sequence runs under one bus
+ * lock, ending with a single STOP. Stops at the first NACK.
+ *
+ * @param[in] d Pointer to the I2C instance.
+ * @param[in,out] msgs Array of segments.
+ * @param[in] num Number of segments.
+ * @return SW_I2C_OK or the reason of the failure.
+ */
+sw_i2c_status_e SW_I2C_Transfer(sw_i2c_t *d, sw_i2c_msg_t *msgs, uint32_t num)
+{
+	sw_i2c_status_e st;
+	uint32_t t_call = 0;
+
+	if (d == NULL)
+		return SW_I2C_ERR_PARAM;
+	st = i2c_check_msgs(msgs, num);
+	if (st != SW_I2C_OK)
+		return st;
+
+	I2C_STATS(t_call = i2c_cycles(d));
+	st = i2c_lock(d, i2c_lock_ticks(d));
+	if (st != SW_I2C_OK)
+		return st;
+	st = i2c_transact(d, msgs, num, t_call);
+	i2c_unlock(d);
+	return st;
+}
+
+/**
+ * @brief Take the bus for a sequence of transactions.
+ *
+ * Between SW_I2C_Lock and SW_I2C_Unlock use SW_I2C_Transfer_Locked only;
+ * the other functions take the (non-recursive) lock themselves. Waits up
+ * to d->lock_timeout_ms. The lock is a FreeRTOS mutex: waiters are served
+ * highest task priority first and the holder inherits the priority of the
+ * most urgent one.
+ *
+ * @param[in] d Pointer to the I2C instance.
+ * @return SW_I2C_OK or SW_I2C_ERR_LOCK_TIMEOUT.
+ */
+sw_i2c_status_e SW_I2C_Lock(sw_i2c_t *d)
+{
+	if (d == NULL)
+		return SW_I2C_ERR_PARAM;
+	return i2c_lock(d, i2c_lock_ticks(d));
 }
 
+/**
+ * @brief SW_I2C_Lock with an explicit bound on the wait.
+ *
+ * @param[in] d Pointer to the I2C instance.
+ * @param[in] timeout_ms Longest wait, 0 = do not wait.
+ * @return SW_I2C_OK or SW_I2C_ERR_LOCK_TIMEOUT.
+ */
+sw_i2c_status_e SW_I2C_Lock_Timeout(sw_i2c_t *d, uint32_t timeout_ms)
+{
+	if (d == NULL)
+		return SW_I2C_ERR_PARAM;
+	return i2c_lock(d, pdMS_TO_TICKS(timeout_ms));
+}
+
+/**
+ * @brief Take the bus only if nobody holds it.
+ *
+ * @param[in] d Pointer to the I2C instance.
+ * @return SW_I2C_OK or SW_I2C_ERR_LOCK_TIMEOUT.
+ */
+sw_i2c_status_e SW_I2C_Try_Lock(sw_i2c_t *d)
+{
+	return SW_I2C_Lock_Timeout(d, 0);
+}
+
+/**
+ * @brief Release the bus taken with SW_I2C_Lock.
+ *
+ * @param[in] d Pointer to the I2C instance.
+ */
+void SW_I2C_Unlock(sw_i2c_t *d)
+{
+	if (d)
+		i2c_unlock(d);
+}
+
+/**
+ * @brief SW_I2C_Transfer for a caller that holds the bus lock.
+ *
+ * @param[in] d Pointer to the I2C instance, locked with SW_I2C_Lock.
+ * @param[in,out] msgs Array of segments.
+ * @param[in] num Number of segments.
+ * @return SW_I2C_OK or the reason of the failure.
+ */
+sw_i2c_status_e SW_I2C_Transfer_Locked(sw_i2c_t *d, sw_i2c_msg_t *msgs, uint32_t num)
+{
+	sw_i2c_status_e st;
+	uint32_t t_call = 0;
+
+	if (d == NULL)
+		return SW_I2C_ERR_PARAM;
+	I2C_STATS(t_call = i2c_cycles(d));
+	st = i2c_check_msgs(msgs, num);
+	if (st != SW_I2C_OK)
+		return st;
+	return i2c_transact(d, msgs, num, t_call);
+}
+
+/**
+ * @brief Status of the last transaction on the bus.
+ *
+ * The legacy functions return TRUE/FALSE; the reason of a FALSE is kept
+ * here until the next transaction. Only meaningful to the task that ran
+ * that transaction if several tasks share the bus.
+ *
+ * @param[in] d Pointer to the I2C instance.
+ * @param[out] nack_index Index of the data byte that was NACKed, may be NULL.
+ * @return Status of the last transaction.
+ */
+sw_i2c_status_e SW_I2C_Last_Status(sw_i2c_t *d, size_t *nack_index)
+{
+	if (d == NULL)
+		return SW_I2C_ERR_PARAM;
+	if (nack_index)
+		*nack_index = d->nack_index;
+	return d->status;
+}
+
+#if SW_I2C_STATS
+/**
+ * @brief Consistent copy of the bus statistics.
+ *
+ * Times are in hal_cycles units and stay 0 when the port has no counter.
+ *
+ * @param[in] d Pointer to the I2C instance.
+ * @param[out] out Snapshot.
+ */
+void SW_I2C_Stats_Get(sw_i2c_t *d, sw_i2c_stats_t *out)
+{
+	if (d == NULL || out == NULL)
+		return;
+	portENTER_CRITICAL();
+	*out = d->stats;
+	portEXIT_CRITICAL();
+}
+
+/**
+ * @brief Clear every counter and the target table.
+ *
+ * @param[in] d Pointer to the I2C instance.
+ */
+void SW_I2C_Stats_Reset(sw_i2c_t *d)
+{
+	if (d == NULL)
+		return;
+	portENTER_CRITICAL();
+	memset(&d->stats, 0, sizeof(d->stats));
+	portEXIT_CRITICAL();
+}
+#endif
+
 /**
  * @brief Read from I2C device with 8-bit register address.
  *
@@ -231,48 +1046,14 @@ static uint8_t SW_I2C_Read_Data(sw_i2c_t *d)
  * @param[in] regaddr Register address.
  * @param[out] pdata Pointer to buffer for storing data.
  * @param[in] rcnt Number of bytes to read.
- * @return TRUE if successful, FALSE otherwise.
+ * @return TRUE if successful, FALSE otherwise (see SW_I2C_Last_Status).
  */
 uint8_t SW_I2C_Read_8addr(sw_i2c_t *d, uint8_t IICID, uint8_t regaddr, uint8_t *pdata, uint8_t rcnt)
 {
-	uint8_t returnack = TRUE;
-
 	if (d == NULL || pdata == NULL || rcnt == 0)
 		return FALSE;
 
-	if (xSemaphoreTake(d->i2c_sem, portMAX_DELAY) == pdTRUE)
-	{
-		i2c_port_initial(d);
-		i2c_start_condition(d);
-		i2c_slave_address(d, IICID, WRITE_CMD);
-		if (!i2c_check_ack(d))
-			returnack = FALSE;
-
-		d->hal_delay_us(SW_I2C_WAIT_TIME);
-		i2c_register_address(d, regaddr);
-		if (!i2c_check_ack(d))
-			returnack = FALSE;
-
-		d->hal_delay_us(SW_I2C_WAIT_TIME);
-		i2c_start_condition(d);
-		i2c_slave_address(d, IICID, READ_CMD);
-		if (!i2c_check_ack(d))
-			returnack = FALSE;
-
-		for (uint8_t i = 0; i < rcnt - 1; i++)
-		{
-			pdata[i] = SW_I2C_Read_Data(d);
-			i2c_send_ack(d);
-		}
-
-		pdata[rcnt - 1] = SW_I2C_Read_Data(d);
-		i2c_check_not_ack(d);
-		i2c_stop_condition(d);
-
-		xSemaphoreGive(d->i2c_sem);
-	}
-
-	return returnack;
+	return i2c_reg_read(d, IICID, regaddr, 1, pdata, rcnt) == SW_I2C_OK;
 }
 
 /**
@@ -285,53 +1066,14 @@ uint8_t SW_I2C_Read_8addr(sw_i2c_t *d, uint8_t IICID, uint8_t regaddr, uint8_t *
  * @param[in] regaddr 16-bit register address.
  * @param[out] pdata Pointer to buffer for storing data.
  * @param[in] rcnt Number of bytes to read.
- * @return TRUE if successful, FALSE otherwise.
+ * @return TRUE if successful, FALSE otherwise (see SW_I2C_Last_Status).
  */
 uint8_t SW_I2C_Read_16addr(sw_i2c_t *d, uint8_t IICID, uint16_t regaddr, uint8_t *pdata, uint8_t rcnt)
 {
-	uint8_t returnack = TRUE;
-
 	if (d == NULL || pdata == NULL || rcnt == 0)
 		return FALSE;
 
-	if (xSemaphoreTake(d->i2c_sem, portMAX_DELAY) == pdTRUE)
-	{
-		i2c_port_initial(d);
-		i2c_start_condition(d);
-		i2c_slave_address(d, IICID, WRITE_CMD);
-		if (!i2c_check_ack(d))
-			returnack = FALSE;
-
-		d->hal_delay_us(SW_I2C_WAIT_TIME);
-		i2c_register_address(d, (uint8_t)(regaddr >> 8));
-		if (!i2c_check_ack(d))
-			returnack = FALSE;
-
-		d->hal_delay_us(SW_I2C_WAIT_TIME);
-		i2c_register_address(d, (uint8_t)regaddr);
-		if (!i2c_check_ack(d))
-			returnack = FALSE;
-
-		d->hal_delay_us(SW_I2C_WAIT_TIME);
-		i2c_start_condition(d);
-		i2c_slave_address(d, IICID, READ_CMD);
-		if (!i2c_check_ack(d))
-			returnack = FALSE;
-
-		for (uint8_t i = 0; i < rcnt - 1; i++)
-		{
-			pdata[i] = SW_I2C_Read_Data(d);
-			i2c_send_ack(d);
-		}
-
-		pdata[rcnt - 1] = SW_I2C_Read_Data(d);
-		i2c_check_not_ack(d);
-		i2c_stop_condition(d);
-
-		xSemaphoreGive(d->i2c_sem);
-	}
-
-	return returnack;
+	return i2c_reg_read(d, IICID, regaddr, 2, pdata, rcnt) == SW_I2C_OK;
 }
 
 /**
@@ -340,37 +1082,12 @@ uint8_t SW_I2C_Read_16addr(sw_i2c_t *d, uint8_t IICID, uint16_t regaddr, uint8_t
  */
 uint8_t SW_I2C_Read_Noaddr(sw_i2c_t *d, uint8_t IICID, uint8_t *pdata, uint8_t rcnt)
 {
-	uint8_t returnack = TRUE;
-	if (d == NULL) return FALSE;
-	if (!rcnt) return FALSE;
+	sw_i2c_msg_t msg = { .IICID = IICID, .flags = SW_I2C_M_RD, .len = rcnt, .buf = pdata };
 
-	if (xSemaphoreTake(d->i2c_sem, portMAX_DELAY) == pdTRUE)
-	{
-		i2c_port_initial(d);
-		i2c_start_condition(d);
-		i2c_slave_address(d, IICID, READ_CMD);
-		if (!i2c_check_ack(d))
-		{
-			returnack = FALSE;
-		}
-		if (rcnt > 1)
-		{
-			for (uint8_t index = 0; index < (rcnt - 1); index++)
-			{
-				d->hal_delay_us(SW_I2C_WAIT_TIME);
-				pdata[index] = SW_I2C_Read_Data(d);
-				i2c_send_ack(d);
-			}
-		}
-		d->hal_delay_us(SW_I2C_WAIT_TIME);
-		pdata[rcnt - 1] = SW_I2C_Read_Data(d);
-		i2c_check_not_ack(d);
-		i2c_stop_condition(d);
-
-		xSemaphoreGive(d->i2c_sem);
-	}
+	if (d == NULL || pdata == NULL || rcnt == 0)
+		return FALSE;
 
-	return returnack;
+	return SW_I2C_Transfer(d, &msg, 1) == SW_I2C_OK;
 }
 
 /**
@@ -383,97 +1100,136 @@ uint8_t SW_I2C_Read_Noaddr(sw_i2c_t *d, uint8_t IICID, uint8_t *pdata, uint8_t r
  * @param[in] regaddr Register address.
  * @param[in] pdata Pointer to buffer containing data to write.
  * @param[in] rcnt Number of bytes to write.
- * @return TRUE if successful, FALSE otherwise.
+ * @return TRUE if successful, FALSE otherwise (see SW_I2C_Last_Status).
  */
 uint8_t SW_I2C_Write_8addr(sw_i2c_t *d, uint8_t IICID, uint8_t regaddr, const uint8_t *pdata, uint8_t rcnt)
 {
-    uint8_t returnack = TRUE;
-
     if (d == NULL || (pdata == NULL && rcnt != 0)) 
         return FALSE;
 
-    if (xSemaphoreTake(d->i2c_sem, portMAX_DELAY) == pdTRUE)
-    {
-        i2c_port_initial(d);
-        i2c_start_condition(d);
-        i2c_slave_address(d, IICID, WRITE_CMD);
-        if (!i2c_check_ack(d)) 
-            returnack = FALSE;
-
-        d->hal_delay_us(SW_I2C_WAIT_TIME);
-        i2c_register_address(d, regaddr);
-        if (!i2c_check_ack(d)) 
-            returnack = FALSE;
-
-        d->hal_delay_us(SW_I2C_WAIT_TIME);
-        for (uint8_t i = 0; i < rcnt; i++)
-        {
-            SW_I2C_Write_Data(d, pdata[i]);
-            if (!i2c_check_ack(d)) 
-                returnack = FALSE;
+    return i2c_reg_write(d, IICID, regaddr, 1, pdata, rcnt) == SW_I2C_OK;
+}
 
-            d->hal_delay_us(SW_I2C_WAIT_TIME);
-        }
+uint8_t SW_I2C_Write_16addr(sw_i2c_t *d, uint8_t IICID, uint16_t regaddr, const uint8_t *pdata, uint8_t rcnt)
+{
+	if (d == NULL || (pdata == NULL && rcnt != 0))  return FALSE;
 
-        i2c_stop_condition(d);
-        xSemaphoreGive(d->i2c_sem);
-    }
+	return i2c_reg_write(d, IICID, regaddr, 2, pdata, rcnt) == SW_I2C_OK;
+}
 
-    return returnack;
+/**
+ * @brief Read any number of bytes from a memory-like target.
+ *
+ * @param[in] d Pointer to the I2C instance.
+ * @param[in] IICID I2C device address.
+ * @param[in] memaddr Memory/register address.
+ * @param[in] alen Address length in bytes: 0, 1 or 2.
+ * @param[out] pdata Buffer for the data.
+ * @param[in] cnt Number of bytes to read.
+ * @return SW_I2C_OK or the reason of the failure.
+ */
+sw_i2c_status_e SW_I2C_Read_Mem(sw_i2c_t *d, uint8_t IICID, uint16_t memaddr, uint8_t alen, uint8_t *pdata, size_t cnt)
+{
+	sw_i2c_msg_t msg = { .IICID = IICID, .flags = SW_I2C_M_RD, .len = cnt, .buf = pdata };
+
+	if (d == NULL || pdata == NULL || cnt == 0 || alen > 2)
+		return SW_I2C_ERR_PARAM;
+	if (alen == 0)
+		return SW_I2C_Transfer(d, &msg, 1);
+
+	return i2c_reg_read(d, IICID, memaddr, alen, pdata, cnt);
 }
 
-uint8_t SW_I2C_Write_16addr(sw_i2c_t *d, uint8_t IICID, uint16_t regaddr, const uint8_t *pdata, uint8_t rcnt)
+/**
+ * @brief Write any number of bytes to a memory-like target in one transaction.
+ *
+ * No page handling, see sw_i2c_eeprom.h for EEPROMs.
+ *
+ * @param[in] d Pointer to the I2C instance.
+ * @param[in] IICID I2C device address.
+ * @param[in] memaddr Memory/register address.
+ * @param[in] alen Address length in bytes: 0, 1 or 2.
+ * @param[in] pdata Data to write.
+ * @param[in] cnt Number of bytes to write.
+ * @return SW_I2C_OK or the reason of the failure.
+ */
+sw_i2c_status_e SW_I2C_Write_Mem(sw_i2c_t *d, uint8_t IICID, uint16_t memaddr, uint8_t alen, const uint8_t *pdata, size_t cnt)
 {
-	uint8_t returnack = TRUE;
-	uint8_t index;
+	sw_i2c_msg_t msg = { .IICID = IICID, .flags = 0, .len = cnt, .buf = (uint8_t *)pdata };
 
-	if (d == NULL || (pdata == NULL && rcnt != 0))  return FALSE;
+	if (d == NULL || (pdata == NULL && cnt != 0) || alen > 2)
+		return SW_I2C_ERR_PARAM;
+	if (alen == 0)
+		return SW_I2C_Transfer(d, &msg, 1);
 
-	if (xSemaphoreTake(d->i2c_sem, portMAX_DELAY) == pdTRUE)
-	{
-		i2c_port_initial(d);
-		i2c_start_condition(d);
-		// 写ID
-		i2c_slave_address(d, IICID, WRITE_CMD);
-		if (!i2c_check_ack(d)) { returnack = FALSE; }
-		d->hal_delay_us(SW_I2C_WAIT_TIME);
-		// 写高八位地址
-		i2c_register_address(d, (uint8_t)(regaddr >> 8));
-		if (!i2c_check_ack(d)) { returnack = FALSE; }
-		d->hal_delay_us(SW_I2C_WAIT_TIME);
-		// 写低八位地址
-		i2c_register_address(d, (uint8_t)regaddr);
-		if (!i2c_check_ack(d)) { returnack = FALSE; }
-		d->hal_delay_us(SW_I2C_WAIT_TIME);
-		// 写数据
-		for (index = 0; index < rcnt; index++)
-		{
-			SW_I2C_Write_Data(d, pdata[index]);
-			if (!i2c_check_ack(d)) { returnack = FALSE; }
-			d->hal_delay_us(SW_I2C_WAIT_TIME);
-		}
-		i2c_stop_condition(d);
-		xSemaphoreGive(d->i2c_sem);
-	}
-	return returnack;
+	return i2c_reg_write(d, IICID, memaddr, alen, pdata, cnt);
 }
 
 uint8_t SW_I2C_Check_SlaveAddr(sw_i2c_t *d, uint8_t IICID)
 {
-    uint8_t returnack = TRUE;
+	sw_i2c_msg_t msg = { .IICID = IICID, .flags = 0, .len = 0, .buf = NULL };
+
+	if (d == NULL)
+		return FALSE;
+
+	return SW_I2C_Transfer(d, &msg, 1) == SW_I2C_OK;
+}
+
+/* Probe direction of one address, SW_I2C_SCAN_AUTO follows i2cdetect */
+static uint8_t i2c_scan_reads(uint8_t mode, uint8_t addr)
+{
+    if (mode == SW_I2C_SCAN_AUTO)
+        return (addr >= 0x30 && addr <= 0x37) || (addr >= 0x50 && addr <= 0x5F);
+    return mode == SW_I2C_SCAN_READ;
+}
 
-	if (xSemaphoreTake(d->i2c_sem, portMAX_DELAY) == pdTRUE)
+/**
+ * @brief Probe a range of addresses under one bus lock.
+ *
+ * Each address costs a START, the address byte and a STOP, plus one byte
+ * for read probes, which never write to the target.
+ *
+ * @param[in] d Pointer to the I2C instance.
+ * @param[in] first First 7-bit address.
+ * @param[in] last Last 7-bit address, up to 0x7F.
+ * @param[in] mode SW_I2C_SCAN_WRITE, _READ or _AUTO.
+ * @param[out] map Presence bitmap, cleared first.
+ * @return SW_I2C_OK, or the bus/lock failure that stopped the scan; the
+ *         bitmap holds what was found until then.
+ */
+sw_i2c_status_e SW_I2C_Scan(sw_i2c_t *d, uint8_t first, uint8_t last, uint8_t mode, uint8_t map[SW_I2C_SCAN_BYTES])
+{
+	sw_i2c_status_e st;
+	uint8_t rd, dummy;
+
+	if (d == NULL || map == NULL || first > last || last > 0x7F || mode > SW_I2C_SCAN_AUTO)
+		return SW_I2C_ERR_PARAM;
+	memset(map, 0, SW_I2C_SCAN_BYTES);
+
+	st = i2c_lock(d, i2c_lock_ticks(d));
+	if (st != SW_I2C_OK)
+		return st;
+	st = i2c_begin(d, first << 1);
+	i2c_use_clock(d, d->clock_hz ? d->clock_hz : SW_I2C_CLOCK_HZ); // bus clock, not a target's
+	for (uint16_t a = first; a <= last && st == SW_I2C_OK; a++)
 	{
-		i2c_start_condition(d);
-		i2c_slave_address(d, IICID, WRITE_CMD);
-		if (!i2c_check_ack(d))
+		rd = i2c_scan_reads(mode, a);
+		st = i2c_address(d, a << 1, rd ? READ_CMD : WRITE_CMD, 0);
+		if (st == SW_I2C_OK)
 		{
-			i2c_stop_condition(d);
-			returnack = FALSE;
+			map[a >> 3] |= 1 << (a & 7);
+			if (rd)
+				st = i2c_read_bytes(d, &dummy, 1, FALSE);
+		}
+		else if (st == SW_I2C_ERR_ADDR_NACK)
+		{
+			st = SW_I2C_OK;
 		}
 		i2c_stop_condition(d);
-
-		xSemaphoreGive(d->i2c_sem);
 	}
-	return returnack;
+	if (st == SW_I2C_ERR_STRETCH_TIMEOUT && !(d->flags & SW_I2C_FLAG_NO_RECOVERY))
+		i2c_recover(d);
+	d->status = st;
+	i2c_unlock(d);
+	return st;
 }
@@ -2,19 +2,84 @@
 #define _SW_I2C_H_
 
 #include <stdint.h>
+#include <stddef.h>
 #include "at32f435_437_gpio.h"
 #include "FreeRTOS.h"
 #include "semphr.h"
 
-#define SW_I2C_CLOCK_HZ     300000
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SW_I2C_CLOCK_HZ     300000  // default when sw_i2c_t.clock_hz is 0
 #define SW_I2C_WAIT_TIME    ((uint64_t)((1.0 / SW_I2C_CLOCK_HZ)*1000000)) // 10us 400kHz
 
+/* Speed profiles for sw_i2c_t.clock_hz and sw_i2c_dev_speed_t */
+#define SW_I2C_SPEED_STANDARD   100000
+#define SW_I2C_SPEED_FAST       400000
+#define SW_I2C_SPEED_FAST_PLUS  1000000
+
+
+
+/* Register accessors of the fast path, a port may override them */
+#ifndef SW_I2C_REG_WRITE
+#define SW_I2C_REG_WRITE(reg, val)  (*(reg) = (val))
+#endif
+#ifndef SW_I2C_REG_READ
+#define SW_I2C_REG_READ(reg)        (*(reg))
+#endif
+
+/* sw_i2c_t.flags */
+#define SW_I2C_FLAG_OPEN_DRAIN  0x0001  // SDA never leaves open-drain output mode
+#define SW_I2C_FLAG_CLOCK_STRETCH 0x0002 // read SCL back after every rising edge
+#define SW_I2C_FLAG_NO_RECOVERY 0x0004  // never clock a stuck bus free automatically
+
+#define SW_I2C_STRETCH_TIMEOUT_US   10000   // default when stretch_timeout_us is 0
+
+/* SW_I2C_Calibrate: reference wait for the hal_cycles rate, rounds per measurement */
+#define SW_I2C_CAL_REF_NS       100000
+#define SW_I2C_CAL_SHORT_NS     1000
+#define SW_I2C_CAL_ROUNDS       16
 
+/* Transfer statistics per bus and target, 0 compiles them out */
+#ifndef SW_I2C_STATS
+#define SW_I2C_STATS            1
+#endif
+#define SW_I2C_STATS_TARGETS    8       // targets tracked per bus
+#define SW_I2C_STATS_BINS       24      // log2 latency bins, the last one is open-ended
+
+/* Transaction trace into a sw_i2c_trace_t ring (sw_i2c_trace.c), 0 compiles it out */
+#ifndef SW_I2C_TRACE
+#define SW_I2C_TRACE            0
+#endif
+#define SW_I2C_TRACE_BYTES      8       // wire bytes kept per transaction
+
+/* SMBus packet error checking in the core (SW_I2C_M_PEC), 0 compiles it out */
+#ifndef SW_I2C_PEC
+#define SW_I2C_PEC              1
+#endif
 
 #define I2C_READ            0x01
 #define READ_CMD            1
 #define WRITE_CMD           0
 
+typedef enum
+{
+    SW_I2C_OK = 0,
+    SW_I2C_ERR_PARAM,
+    SW_I2C_ERR_ADDR_NACK,       // no target answered the address
+    SW_I2C_ERR_REG_NACK,        // register address byte NACKed
+    SW_I2C_ERR_DATA_NACK,       // data byte NACKed, index in nack_index
+    SW_I2C_ERR_BUS_BUSY,        // SCL or SDA low before START
+    SW_I2C_ERR_STRETCH_TIMEOUT, // SCL held low longer than stretch_timeout_us
+    SW_I2C_ERR_LOCK_TIMEOUT,    // bus mutex not obtained
+    SW_I2C_ERR_QUEUE_FULL,      // async job queue has no room
+    SW_I2C_ERR_NO_DATA,         // nothing published yet
+    SW_I2C_ERR_OVERRUN,         // target mode: an edge was lost to interrupt latency
+    SW_I2C_ERR_PEC,             // SMBus PEC byte did not match
+    SW_I2C_ERR_PROTOCOL,        // SMBus block count 0 or larger than the buffer
+}sw_i2c_status_e;
+
 typedef enum
 {
     HAL_IO_OPT_SET_SDA_LOW = 0,
@@ -30,29 +95,173 @@ typedef enum
     HAL_IO_OPT_IS_LINE_BUSY,
 }hal_io_opt_e;
 
+/**
+ * Optional direct register access for line edges. When scl_set is not NULL
+ * the core writes the pin masks straight to these registers instead of
+ * calling hal_io_ctl; init, direction switches and busy detection still go
+ * through the HAL. On AT32: set = scr, clr = clr, in = idt.
+ */
+typedef struct
+{
+    volatile uint32_t * scl_set;
+    volatile uint32_t * scl_clr;
+    volatile uint32_t * scl_in;
+    volatile uint32_t * sda_set;
+    volatile uint32_t * sda_clr;
+    volatile uint32_t * sda_in;
+    uint32_t scl_mask;
+    uint32_t sda_mask;
+} sw_i2c_fast_t;
+
+/* SW_I2C_Scan probes and presence bitmap, bit (a & 7) of map[a >> 3] for 7-bit address a */
+#define SW_I2C_SCAN_WRITE       0       // address + W, STOP
+#define SW_I2C_SCAN_READ        1       // address + R, one byte NACKed, STOP
+#define SW_I2C_SCAN_AUTO        2       // READ for 0x30-0x37 and 0x50-0x5F (EEPROMs), WRITE elsewhere
+#define SW_I2C_SCAN_BYTES       16
+
+/* sw_i2c_msg_t.flags */
+#define SW_I2C_M_RD         0x0001  // read segment, otherwise write
+#define SW_I2C_M_REG        0x0100  // write segment is a register address, NACK reports SW_I2C_ERR_REG_NACK
+#define SW_I2C_M_RECV_LEN   0x0400  // read segment: first byte counts the bytes that follow, len is the room and becomes 1 + count
+#define SW_I2C_M_PEC        0x0800  // write segment: PEC byte appended; read segment: PEC byte read and checked
+#define SW_I2C_M_NOSTART    0x4000  // write continues the previous write, no repeated START
+
+/** One segment of a combined transaction, see SW_I2C_Transfer */
+typedef struct
+{
+    uint8_t IICID;          // 8-bit address, R/W bit is taken from flags
+    uint16_t flags;
+    size_t len;
+    uint8_t *buf;
+} sw_i2c_msg_t;
+
+/** Per-target clock override, IICID is the 8-bit address as passed to the API */
+typedef struct
+{
+    uint8_t IICID;
+    uint32_t clock_hz;
+} sw_i2c_dev_speed_t;
+
+#if SW_I2C_STATS
+/** Counters of one target, or of the whole bus. Times in hal_cycles units */
+typedef struct
+{
+    uint8_t IICID;                      // 8-bit write address, reads count here too
+    uint8_t used;                       // slot claimed
+    uint32_t transfers;
+    uint32_t bytes_out;                 // data bytes sent, address bytes excluded
+    uint32_t bytes_in;
+    uint32_t nacks;                     // transfers ended by a NACK
+    uint32_t aborts;                    // bus busy, stretch or lock timeout
+    uint64_t hold_cycles;               // bus time, START to STOP
+} sw_i2c_counters_t;
+
+typedef struct
+{
+    sw_i2c_counters_t bus;
+    uint64_t lock_wait_cycles;          // waiting for i2c_sem
+    uint64_t lock_hold_cycles;          // holding i2c_sem
+    uint32_t lock_timeouts;             // i2c_sem not obtained in time
+    uint32_t latency[SW_I2C_STATS_BINS]; // transfers by log2(cycles from call to STOP)
+    sw_i2c_counters_t target[SW_I2C_STATS_TARGETS];
+    uint32_t untracked;                 // transfers to targets beyond the table
+} sw_i2c_stats_t;
+#endif
+
+/** Phase waits for the active clock, derived from the I2C spec minimums by the core */
+typedef struct
+{
+    uint32_t hz;                        // clock they were derived for
+    uint32_t low_ns;                    // SCL low of a bit: tLOW, covers tSU;DAT
+    uint32_t high_ns;                   // SCL high of a bit: tHIGH plus rise time
+    uint32_t su_sta_ns;                 // SCL release to repeated START: tSU;STA plus rise time
+    uint32_t hd_sta_ns;                 // START to SCL low: tHD;STA
+    uint32_t su_sto_ns;                 // SCL release to STOP: tSU;STO plus rise time
+    uint32_t buf_ns;                    // STOP to the next START: tBUF
+} sw_i2c_timing_t;
+
 typedef struct sw_i2c_s 
 {
     int (*hal_init)(void * slot);
     int (*hal_deinit)(void * slot);
     int (*hal_io_ctl)(hal_io_opt_e opt, void * slot);
     void (*hal_delay_us)(uint32_t us);
+    void (*hal_delay_ns)(uint32_t ns);  // optional, sub-microsecond half periods
+    uint32_t (*hal_cycles)(void);       // optional free-running counter for statistics
+    int (*hal_edge_irq)(void * slot, uint8_t on); // optional, both-edge SCL/SDA interrupts for sw_i2c_slave.c
     gpio_type * scl_port;
     gpio_type * sda_port;
     uint32_t scl_pin;
     uint32_t sda_pin;
+    sw_i2c_fast_t fast;
+    uint32_t flags;
+    uint32_t clock_hz;                  // bus clock, 0 = SW_I2C_CLOCK_HZ
+    const sw_i2c_dev_speed_t * dev_speed; // optional per-target overrides
+    uint8_t dev_speed_cnt;
+    uint32_t half_ns;                   // active SCL half period, managed by the core
+    uint16_t rise_ns;                   // SCL/SDA rise time allowance, 0 = spec maximum of the mode; apply with SW_I2C_Set_Speed
+    sw_i2c_timing_t tm;                 // active phase waits, managed by the core
+    uint32_t wait_trim_ns;              // edge + delay call cost taken off each wait, see SW_I2C_Calibrate
+    uint32_t stretch_timeout_us;        // longest clock stretch accepted, 0 = default
+    uint8_t stretch_fault;              // set by the core on stretch timeout
+    sw_i2c_status_e status;             // result of the last transaction
+    size_t nack_index;                  // data byte NACKed in the last transaction
+#if SW_I2C_PEC
+    uint8_t pec;                        // CRC-8 of the wire bytes since START, managed by the core
+#endif
+    uint32_t recoveries;                // bus recoveries run, see SW_I2C_Recover
+    uint32_t recovery_failures;         // ... that left SCL or SDA low
     SemaphoreHandle_t i2c_sem;
+    uint32_t lock_timeout_ms;           // wait for i2c_sem, 0 = forever
+    size_t chunk_len;                   // register reads longer than this are split, 0 = never;
+                                        // chunk k reads from register + k * chunk_len, so leave
+                                        // it 0 on buses with FIFO or non-incrementing registers
+#if SW_I2C_STATS
+    uint32_t lock_at;                   // hal_cycles when i2c_sem was taken
+    uint32_t xfer_out, xfer_in;         // bytes of the running transfer
+    sw_i2c_stats_t stats;
+#endif
+#if SW_I2C_TRACE
+    struct sw_i2c_trace_s * trace;      // NULL = not recording
+    uint8_t trace_bus;                  // bus number in the records
+    uint8_t trace_wire, trace_ack, trace_start; // running transaction, see sw_i2c_trace_rec_t
+    uint8_t trace_bytes[SW_I2C_TRACE_BYTES];
+#endif
 } sw_i2c_t;
 
 
 /* functions */
 void SW_I2C_initial(sw_i2c_t *d);
 void SW_I2C_deinit(sw_i2c_t *d);
+void SW_I2C_Set_Speed(sw_i2c_t *d, uint32_t clock_hz);
+void SW_I2C_Calibrate(sw_i2c_t *d);
+sw_i2c_status_e SW_I2C_Recover(sw_i2c_t *d);
+sw_i2c_status_e SW_I2C_Recover_Locked(sw_i2c_t *d);
+uint32_t SW_I2C_Target_Clock(const sw_i2c_t *d, uint8_t IICID);
+sw_i2c_status_e SW_I2C_Last_Status(sw_i2c_t *d, size_t *nack_index);
+sw_i2c_status_e SW_I2C_Transfer(sw_i2c_t *d, sw_i2c_msg_t *msgs, uint32_t num);
+sw_i2c_status_e SW_I2C_Lock(sw_i2c_t *d);
+sw_i2c_status_e SW_I2C_Lock_Timeout(sw_i2c_t *d, uint32_t timeout_ms);
+sw_i2c_status_e SW_I2C_Try_Lock(sw_i2c_t *d);
+void SW_I2C_Unlock(sw_i2c_t *d);
+sw_i2c_status_e SW_I2C_Transfer_Locked(sw_i2c_t *d, sw_i2c_msg_t *msgs, uint32_t num);
+#if SW_I2C_STATS
+void SW_I2C_Stats_Get(sw_i2c_t *d, sw_i2c_stats_t *out);
+void SW_I2C_Stats_Reset(sw_i2c_t *d);
+#endif
 uint8_t SW_I2C_Read_8addr(sw_i2c_t *d, uint8_t IICID, uint8_t regaddr, uint8_t *pdata, uint8_t rcnt);
 uint8_t SW_I2C_Read_16addr(sw_i2c_t *d, uint8_t IICID, uint16_t regaddr, uint8_t *pdata, uint8_t rcnt);
 uint8_t SW_I2C_Read_Noaddr(sw_i2c_t *d, uint8_t IICID, uint8_t *pdata, uint8_t rcnt);
 uint8_t SW_I2C_Write_8addr(sw_i2c_t *d, uint8_t IICID, uint8_t regaddr, const uint8_t *pdata, uint8_t rcnt);
 uint8_t SW_I2C_Write_16addr(sw_i2c_t *d, uint8_t IICID, uint16_t regaddr, const uint8_t *pdata, uint8_t rcnt);
 uint8_t SW_I2C_Check_SlaveAddr(sw_i2c_t *d, uint8_t IICID);
+sw_i2c_status_e SW_I2C_Scan(sw_i2c_t *d, uint8_t first, uint8_t last, uint8_t mode, uint8_t map[SW_I2C_SCAN_BYTES]);
+sw_i2c_status_e SW_I2C_Read_Mem(sw_i2c_t *d, uint8_t IICID, uint16_t memaddr, uint8_t alen, uint8_t *pdata, size_t cnt);
+sw_i2c_status_e SW_I2C_Write_Mem(sw_i2c_t *d, uint8_t IICID, uint16_t memaddr, uint8_t alen, const uint8_t *pdata, size_t cnt);
+
+#ifdef __cplusplus
+}
+#endif
 
 
 #endif  /* __I2C_SW_H */
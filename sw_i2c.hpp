@@ -0,0 +1,259 @@
+/***
+ * Compile-time soft I2C bus for C++ (C++17).
+ *
+ * SoftI2c<Port, SclPin, SdaPin, SpeedProfile> runs the same protocol phases
+ * as the C core (sw_i2c_phase.h), but every hook is a constant: line edges
+ * are stores of a constant pin mask to a constant register address, and the
+ * phase waits are derived from the speed profile at compile time, so each
+ * phase compiles to straight-line code with no sw_i2c_t, no function
+ * pointers and no run-time timing arithmetic.
+ *
+ * Meant for a few hot buses. Pins are set up, recovered and shared through
+ * the C API: configure them with SW_I2C_initial (open-drain output, see
+ * SW_I2C_FLAG_OPEN_DRAIN), and when C code uses the same bus hold its lock
+ * (SW_I2C_Lock/SW_I2C_Unlock) around the calls here. No statistics, trace,
+ * PEC or per-target speed.
+ *
+ * Port provides, for an open-drain GPIO block holding both pins:
+ *
+ *   static void set(uint32_t pins);            release pins (latch high)
+ *   static void clear(uint32_t pins);          pull pins low
+ *   static uint32_t input();                   input levels
+ *   template<uint32_t Ns> static void delay(); busy wait, Ns > 0
+ *   static constexpr uint32_t wait_trim_ns;    edge plus delay entry cost,
+ *                                              taken off every wait
+ *
+ * sw_i2c_port_at32.hpp has the AT32 one.
+ */
+#ifndef _SW_I2C_HPP_
+#define _SW_I2C_HPP_
+
+#include "sw_i2c_phase.h"
+
+namespace sw_i2c
+{
+
+/* Clock and rise time (0 = the mode's maximum tr) of a bus */
+template<uint32_t Hz, uint32_t RiseNs = 0>
+struct Speed
+{
+    static constexpr uint32_t hz = Hz;
+    static constexpr uint32_t rise_ns = RiseNs;
+};
+
+using Standard = Speed<SW_I2C_SPEED_STANDARD>;
+using Fast = Speed<SW_I2C_SPEED_FAST>;
+using FastPlus = Speed<SW_I2C_SPEED_FAST_PLUS>;
+
+/**
+ * Soft I2C bus with everything known at compile time. Flags takes
+ * SW_I2C_FLAG_CLOCK_STRETCH; the pins are always driven open-drain.
+ */
+template<class Port, uint32_t SclPin, uint32_t SdaPin, class SpeedProfile, uint32_t Flags = 0>
+class SoftI2c
+{
+public:
+    static constexpr sw_i2c_timing_t timing = sw_i2c_spec_timing(SpeedProfile::hz, SpeedProfile::rise_ns);
+
+    /**
+     * @brief Run message segments joined by repeated STARTs, one STOP.
+     *
+     * Same segments and results as SW_I2C_Transfer_Locked, without the
+     * SMBus flags.
+     *
+     * @param[in,out] msgs Segments.
+     * @param[in] num Number of segments.
+     * @param[out] nack_index Byte of the segment that was NACKed, may be NULL.
+     * @return SW_I2C_OK or the reason of the failure.
+     */
+    static sw_i2c_status_e transfer(sw_i2c_msg_t *msgs, uint32_t num, size_t *nack_index = nullptr)
+    {
+        Ctx d = { 0 };
+        sw_i2c_status_e st = check(msgs, num);
+        size_t i = 0;
+
+        if (st != SW_I2C_OK)
+            return st;
+        if ((Port::input() & (SclPin | SdaPin)) != (SclPin | SdaPin))
+            return SW_I2C_ERR_BUS_BUSY;
+
+        for (uint32_t n = 0; n < num && st == SW_I2C_OK; n++)
+        {
+            sw_i2c_msg_t *m = &msgs[n];
+            uint8_t rd = (m->flags & SW_I2C_M_RD) != 0;
+
+            if (n == 0 || !(m->flags & SW_I2C_M_NOSTART))
+            {
+                i2c_start_condition(d, n > 0);
+                i2c_shift_out(d, rd ? (m->IICID | I2C_READ) : (m->IICID & ~I2C_READ));
+                if (!i2c_check_ack(d))
+                    st = SW_I2C_ERR_ADDR_NACK;
+            }
+            for (i = 0; i < m->len && st == SW_I2C_OK && !d.stretch_fault; i++)
+            {
+                if (rd)
+                {
+                    m->buf[i] = i2c_shift_in(d);
+                    i2c_send_ack(d, i + 1 < m->len);
+                }
+                else
+                {
+                    i2c_shift_out(d, m->buf[i]);
+                    if (!i2c_check_ack(d))
+                        st = (m->flags & SW_I2C_M_REG) ? SW_I2C_ERR_REG_NACK : SW_I2C_ERR_DATA_NACK;
+                }
+            }
+            if (d.stretch_fault)
+                st = SW_I2C_ERR_STRETCH_TIMEOUT;
+        }
+        if (nack_index)
+            *nack_index = st == SW_I2C_ERR_DATA_NACK ? i - 1 : 0;
+        i2c_stop_condition(d);
+        return st;
+    }
+
+    /**
+     * @brief Read from a register or memory address, as SW_I2C_Read_Mem.
+     *
+     * @param[in] IICID 8-bit target address.
+     * @param[in] memaddr Register or memory address.
+     * @param[in] alen 0, 1 or 2 address bytes, MSB first.
+     * @param[out] pdata Data.
+     * @param[in] cnt Bytes to read, at least 1.
+     * @return SW_I2C_OK or the reason of the failure.
+     */
+    static sw_i2c_status_e read_mem(uint8_t IICID, uint16_t memaddr, uint8_t alen, uint8_t *pdata, size_t cnt)
+    {
+        uint8_t a[2] = { (uint8_t)(alen == 2 ? memaddr >> 8 : memaddr), (uint8_t)memaddr };
+        sw_i2c_msg_t msgs[] =
+        {
+            { IICID, SW_I2C_M_REG, alen, a },
+            { IICID, SW_I2C_M_RD, cnt, pdata },
+        };
+
+        if (alen > 2)
+            return SW_I2C_ERR_PARAM;
+        return alen ? transfer(msgs, 2) : transfer(&msgs[1], 1);
+    }
+
+    /**
+     * @brief Write to a register or memory address, as SW_I2C_Write_Mem.
+     *
+     * @param[in] IICID 8-bit target address.
+     * @param[in] memaddr Register or memory address.
+     * @param[in] alen 0, 1 or 2 address bytes, MSB first.
+     * @param[in] pdata Data.
+     * @param[in] cnt Bytes to write.
+     * @return SW_I2C_OK or the reason of the failure.
+     */
+    static sw_i2c_status_e write_mem(uint8_t IICID, uint16_t memaddr, uint8_t alen, const uint8_t *pdata, size_t cnt)
+    {
+        uint8_t a[2] = { (uint8_t)(alen == 2 ? memaddr >> 8 : memaddr), (uint8_t)memaddr };
+        sw_i2c_msg_t msgs[] =
+        {
+            { IICID, SW_I2C_M_REG, alen, a },
+            { IICID, SW_I2C_M_NOSTART, cnt, const_cast<uint8_t *>(pdata) },
+        };
+
+        if (alen > 2)
+            return SW_I2C_ERR_PARAM;
+        return alen ? transfer(msgs, 2) : transfer(&msgs[1], 1);
+    }
+
+    /**
+     * @brief Address the target with an empty write.
+     *
+     * @param[in] IICID 8-bit target address.
+     * @return SW_I2C_OK when it ACKed.
+     */
+    static sw_i2c_status_e probe(uint8_t IICID)
+    {
+        sw_i2c_msg_t msg = { IICID, 0, 0, nullptr };
+
+        return transfer(&msg, 1);
+    }
+
+private:
+    struct Ctx
+    {
+        uint8_t stretch_fault;
+    };
+
+    template<uint32_t Ns>
+    static inline void wait()
+    {
+        constexpr uint32_t ns = Ns > Port::wait_trim_ns ? Ns - Port::wait_trim_ns : 0;
+
+        if constexpr (ns != 0)
+            Port::template delay<ns>();
+    }
+
+    /* Clock stretching: poll SCL every quarter period up to the default timeout */
+    static inline void scl_wait_high(Ctx &d)
+    {
+        if constexpr ((Flags & SW_I2C_FLAG_CLOCK_STRETCH) != 0)
+        {
+            constexpr uint32_t step = (timing.low_ns + timing.high_ns) / 8 ? (timing.low_ns + timing.high_ns) / 8 : 1;
+            constexpr uint32_t polls = SW_I2C_STRETCH_TIMEOUT_US * 1000UL / step;
+
+            for (uint32_t n = 0; !(Port::input() & SclPin); n++)
+            {
+                if (n >= polls)
+                {
+                    d.stretch_fault = 1;
+                    return;
+                }
+                Port::template delay<step>();
+            }
+        }
+        else
+        {
+            (void)d;
+        }
+    }
+
+    static sw_i2c_status_e check(const sw_i2c_msg_t *msgs, uint32_t num)
+    {
+        if (msgs == nullptr || num == 0)
+            return SW_I2C_ERR_PARAM;
+        for (uint32_t i = 0; i < num; i++)
+        {
+            if ((msgs[i].len != 0 && msgs[i].buf == nullptr) ||
+                (msgs[i].flags & (SW_I2C_M_RECV_LEN | SW_I2C_M_PEC)))
+                return SW_I2C_ERR_PARAM;
+            if ((msgs[i].flags & SW_I2C_M_RD) && (msgs[i].len == 0 || (msgs[i].flags & SW_I2C_M_NOSTART)))
+                return SW_I2C_ERR_PARAM;
+            if ((msgs[i].flags & SW_I2C_M_NOSTART) && i > 0 && (msgs[i - 1].flags & SW_I2C_M_RD))
+                return SW_I2C_ERR_PARAM;
+        }
+        return SW_I2C_OK;
+    }
+
+#define SW_I2C_PH_DECL              static
+#define SW_I2C_PH_CTX               Ctx &d
+#define SW_I2C_PH_SCL_HIGH(d)       Port::set(SclPin)
+#define SW_I2C_PH_SCL_LOW(d)        Port::clear(SclPin)
+#define SW_I2C_PH_SDA_HIGH(d)       Port::set(SdaPin)
+#define SW_I2C_PH_SDA_LOW(d)        Port::clear(SdaPin)
+#define SW_I2C_PH_SDA_INPUT(d)      Port::set(SdaPin)
+#define SW_I2C_PH_SDA_OUTPUT(d)     ((void)0)   // open-drain, SDA stays released
+#define SW_I2C_PH_SDA_GET(d)        (Port::input() & SdaPin)
+#define SW_I2C_PH_SCL_WAIT_HIGH(d)  scl_wait_high(d)
+#define SW_I2C_PH_WAIT(d, t)        wait<timing.t>()
+#include "sw_i2c_phase.h"
+#undef SW_I2C_PH_DECL
+#undef SW_I2C_PH_CTX
+#undef SW_I2C_PH_SCL_HIGH
+#undef SW_I2C_PH_SCL_LOW
+#undef SW_I2C_PH_SDA_HIGH
+#undef SW_I2C_PH_SDA_LOW
+#undef SW_I2C_PH_SDA_INPUT
+#undef SW_I2C_PH_SDA_OUTPUT
+#undef SW_I2C_PH_SDA_GET
+#undef SW_I2C_PH_SCL_WAIT_HIGH
+#undef SW_I2C_PH_WAIT
+};
+
+} // namespace sw_i2c
+
+#endif /* _SW_I2C_HPP_ */
@@ -0,0 +1,126 @@
+/***
+ * Non-blocking submission for the soft I2C core: jobs are queued per bus and
+ * executed in order by a worker task, or by whoever calls
+ * SW_I2C_Async_Process (a timer callback, a super loop).
+ */
+
+#include "sw_i2c_async.h"
+
+#define TAG "SW_I2C"
+#include "log.h"
+
+#ifndef TRUE
+	#define TRUE 1
+#endif
+#ifndef FALSE
+	#define FALSE 0
+#endif
+
+static void async_task(void * arg)
+{
+    sw_i2c_async_t * a = arg;
+    for (;;)
+    {
+        SW_I2C_Async_Process(a, portMAX_DELAY);
+    }
+}
+
+/**
+ * @brief Create the job queue of a bus.
+ *
+ * @param[out] a Async context.
+ * @param[in] bus Initialized bus.
+ * @param[in] depth Number of jobs that can wait.
+ * @return SW_I2C_OK or SW_I2C_ERR_PARAM if the queue cannot be created.
+ */
+sw_i2c_status_e SW_I2C_Async_Init(sw_i2c_async_t *a, sw_i2c_t *bus, UBaseType_t depth)
+{
+    if (a == NULL || bus == NULL || depth == 0)
+        return SW_I2C_ERR_PARAM;
+    a->bus = bus;
+    a->task = NULL;
+    a->queue = xQueueCreate(depth, sizeof(sw_i2c_job_t *));
+    if (a->queue == NULL)
+    {
+        logE("async queue alloc failed");
+        return SW_I2C_ERR_PARAM;
+    }
+    return SW_I2C_OK;
+}
+
+/**
+ * @brief Start a dedicated worker task for the bus.
+ *
+ * Not needed if SW_I2C_Async_Process is driven from elsewhere.
+ */
+sw_i2c_status_e SW_I2C_Async_Start_Task(sw_i2c_async_t *a, UBaseType_t priority, uint32_t stack_words)
+{
+    if (a == NULL || a->queue == NULL)
+        return SW_I2C_ERR_PARAM;
+    if (xTaskCreate(async_task, "sw_i2c", stack_words, a, priority, &a->task) != pdPASS)
+    {
+        logE("async task create failed");
+        return SW_I2C_ERR_PARAM;
+    }
+    return SW_I2C_OK;
+}
+
+/**
+ * @brief Queue a transaction.
+ *
+ * @param[in] a Async context.
+ * @param[in,out] job Job descriptor, owned by the queue until job->done.
+ * @param[in] wait Ticks to wait for room in the queue.
+ * @return SW_I2C_OK if queued, SW_I2C_ERR_QUEUE_FULL otherwise.
+ */
+sw_i2c_status_e SW_I2C_Async_Submit(sw_i2c_async_t *a, sw_i2c_job_t *job, TickType_t wait)
+{
+    if (a == NULL || a->queue == NULL || job == NULL || job->msgs == NULL || job->num == 0)
+        return SW_I2C_ERR_PARAM;
+    job->done = FALSE;
+    job->status = SW_I2C_OK;
+    if (xQueueSend(a->queue, &job, wait) != pdTRUE)
+        return SW_I2C_ERR_QUEUE_FULL;
+    return SW_I2C_OK;
+}
+
+/**
+ * @brief Run the next queued job and signal its completion.
+ *
+ * The callback runs before done is set, with the job still owned by the
+ * queue; the notification and the semaphore follow done and use copies
+ * taken before it, so the job is not touched once its owner may free it.
+ *
+ * @param[in] a Async context.
+ * @param[in] wait Ticks to wait for a job.
+ * @return TRUE if a job was executed.
+ */
+uint8_t SW_I2C_Async_Process(sw_i2c_async_t *a, TickType_t wait)
+{
+    sw_i2c_job_t * job;
+    sw_i2c_job_cb_t callback;
+    TaskHandle_t notify_task;
+    SemaphoreHandle_t done_sem;
+    sw_i2c_status_e status;
+
+    if (xQueueReceive(a->queue, &job, wait) != pdTRUE)
+        return FALSE;
+
+    status = SW_I2C_Transfer(a->bus, job->msgs, job->num);
+    callback = job->callback;
+    notify_task = job->notify_task;
+    done_sem = job->done_sem;
+    job->status = status;
+    if (callback)
+        callback(job);
+
+    /* The owner may free the job as soon as it sees done: publish it last
+     * and signal from the copies only */
+    SW_I2C_ASYNC_BARRIER();
+    job->done = TRUE;
+    if (notify_task)
+        xTaskNotify(notify_task, (uint32_t)status, eSetValueWithOverwrite);
+    if (done_sem)
+        xSemaphoreGive(done_sem);
+    return TRUE;
+}
@@ -0,0 +1,47 @@
+#ifndef _SW_I2C_ASYNC_H_
+#define _SW_I2C_ASYNC_H_
+
+#include "sw_i2c.h"
+#include "task.h"
+#include "queue.h"
+
+/* Orders the job's last stores against done */
+#ifndef SW_I2C_ASYNC_BARRIER
+#define SW_I2C_ASYNC_BARRIER()  __sync_synchronize()
+#endif
+
+typedef struct sw_i2c_job_s sw_i2c_job_t;
+typedef void (*sw_i2c_job_cb_t)(sw_i2c_job_t *job);
+
+/**
+ * Queued transaction. The job and its messages belong to the caller and
+ * must stay valid until done is set; the task and semaphore it names only
+ * need to outlive the signal. Any combination of the completion signals
+ * may be used; unused ones stay NULL.
+ */
+struct sw_i2c_job_s
+{
+    sw_i2c_msg_t * msgs;
+    uint32_t num;
+    sw_i2c_job_cb_t callback;       // called from the worker context
+    void * arg;                     // free for the callback
+    TaskHandle_t notify_task;       // gets the status as notification value
+    SemaphoreHandle_t done_sem;     // binary or counting semaphore, given on completion; not a mutex
+    volatile sw_i2c_status_e status;
+    volatile uint8_t done;
+};
+
+/** Per-bus queue and its worker */
+typedef struct
+{
+    sw_i2c_t * bus;
+    QueueHandle_t queue;
+    TaskHandle_t task;
+} sw_i2c_async_t;
+
+sw_i2c_status_e SW_I2C_Async_Init(sw_i2c_async_t *a, sw_i2c_t *bus, UBaseType_t depth);
+sw_i2c_status_e SW_I2C_Async_Start_Task(sw_i2c_async_t *a, UBaseType_t priority, uint32_t stack_words);
+sw_i2c_status_e SW_I2C_Async_Submit(sw_i2c_async_t *a, sw_i2c_job_t *job, TickType_t wait);
+uint8_t SW_I2C_Async_Process(sw_i2c_async_t *a, TickType_t wait);
+
+#endif /* _SW_I2C_ASYNC_H_ */
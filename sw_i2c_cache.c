@@ -0,0 +1,235 @@
+/***
+ * Register shadow cache for soft I2C targets: unchanged writes are dropped,
+ * known registers are read without bus traffic, and read-modify-write runs
+ * under a single bus lock.
+ */
+
+#include "sw_i2c_cache.h"
+
+/* A bus, and register addresses the transfer can carry */
+static inline uint8_t cache_valid(const sw_i2c_cache_t *c)
+{
+    return c != NULL && c->bus != NULL && (c->alen == 1 || c->alen == 2);
+}
+
+static uint8_t * cache_state(sw_i2c_cache_t *c, uint16_t reg)
+{
+    if (c->state == NULL || reg < c->base || reg - c->base >= c->cnt)
+        return NULL;
+    return &c->state[reg - c->base];
+}
+
+static inline uint8_t cache_kind(const uint8_t *state)
+{
+    return state ? (*state & SW_I2C_CACHE_KIND_MASK) : SW_I2C_CACHE_VOLATILE;
+}
+
+static inline uint8_t cache_known(const uint8_t *state)
+{
+    return cache_kind(state) != SW_I2C_CACHE_VOLATILE && (*state & SW_I2C_CACHE_VALID);
+}
+
+/* One register over the bus; with locked the caller holds the bus lock */
+static sw_i2c_status_e cache_xfer(sw_i2c_cache_t *c, uint16_t reg, uint8_t *val, uint8_t rd, uint8_t locked)
+{
+    uint8_t addr[2] = { (uint8_t)(reg >> 8), (uint8_t)reg };
+    sw_i2c_msg_t msgs[2] =
+    {
+        { .IICID = c->IICID, .flags = SW_I2C_M_REG, .len = c->alen, .buf = &addr[2 - c->alen] },
+        { .IICID = c->IICID, .flags = rd ? SW_I2C_M_RD : SW_I2C_M_NOSTART, .len = 1, .buf = val },
+    };
+
+    if (locked)
+        return SW_I2C_Transfer_Locked(c->bus, msgs, 2);
+    return SW_I2C_Transfer(c->bus, msgs, 2);
+}
+
+static void cache_store(sw_i2c_cache_t *c, uint8_t *state, uint16_t reg, uint8_t val, sw_i2c_status_e st)
+{
+    if (cache_kind(state) == SW_I2C_CACHE_VOLATILE)
+        return;
+    if (st == SW_I2C_OK)
+    {
+        c->value[reg - c->base] = val;
+        *state |= SW_I2C_CACHE_VALID;
+    }
+    else
+    {
+        *state &= ~SW_I2C_CACHE_VALID; // the device may or may not have it
+    }
+}
+
+/**
+ * @brief Set the kind of a range of registers and forget their values.
+ *
+ * @param[in] c Cache.
+ * @param[in] reg First register.
+ * @param[in] num Number of registers.
+ * @param[in] kind SW_I2C_CACHE_VOLATILE, _CACHED or _WRITE_ONLY.
+ */
+void SW_I2C_Cache_Set_Kind(sw_i2c_cache_t *c, uint16_t reg, uint16_t num, uint8_t kind)
+{
+    uint8_t *state;
+
+    for (uint16_t i = 0; i < num; i++)
+    {
+        state = cache_state(c, reg + i);
+        if (state)
+            *state = kind & SW_I2C_CACHE_KIND_MASK;
+    }
+}
+
+/**
+ * @brief Forget every shadow value, e.g. after a device reset.
+ */
+void SW_I2C_Cache_Invalidate(sw_i2c_cache_t *c)
+{
+    for (uint16_t i = 0; c->state && i < c->cnt; i++)
+        c->state[i] &= ~SW_I2C_CACHE_VALID;
+}
+
+/**
+ * @brief Read a register, from the shadow when it is known.
+ *
+ * @param[in] c Cache.
+ * @param[in] reg Register address.
+ * @param[out] val Register value.
+ * @return SW_I2C_OK, the bus status, SW_I2C_ERR_NO_DATA for a write-only
+ *         register that was never written, or SW_I2C_ERR_PARAM.
+ */
+sw_i2c_status_e SW_I2C_Cache_Read(sw_i2c_cache_t *c, uint16_t reg, uint8_t *val)
+{
+    uint8_t *state;
+    sw_i2c_status_e st;
+
+    if (!cache_valid(c) || val == NULL)
+        return SW_I2C_ERR_PARAM;
+    state = cache_state(c, reg);
+    if (cache_known(state))
+    {
+        *val = c->value[reg - c->base];
+        c->hits++;
+        return SW_I2C_OK;
+    }
+    if (cache_kind(state) == SW_I2C_CACHE_WRITE_ONLY)
+        return SW_I2C_ERR_NO_DATA;
+
+    st = cache_xfer(c, reg, val, 1, 0);
+    if (st == SW_I2C_OK)
+        cache_store(c, state, reg, *val, st);
+    return st;
+}
+
+/**
+ * @brief Write a register unless the shadow already holds the value.
+ *
+ * @param[in] c Cache.
+ * @param[in] reg Register address.
+ * @param[in] val New value.
+ * @return SW_I2C_OK, the bus status or SW_I2C_ERR_PARAM.
+ */
+sw_i2c_status_e SW_I2C_Cache_Write(sw_i2c_cache_t *c, uint16_t reg, uint8_t val)
+{
+    uint8_t *state;
+    sw_i2c_status_e st;
+
+    if (!cache_valid(c))
+        return SW_I2C_ERR_PARAM;
+    state = cache_state(c, reg);
+    if (cache_known(state) && c->value[reg - c->base] == val)
+    {
+        c->skipped++;
+        return SW_I2C_OK;
+    }
+    st = cache_xfer(c, reg, &val, 0, 0);
+    cache_store(c, state, reg, val, st);
+    return st;
+}
+
+/**
+ * @brief Replace the bits in mask with those of val, under one bus lock.
+ *
+ * The old value comes from the shadow when known, from the device
+ * otherwise; nothing is written if the bits already match.
+ *
+ * @param[in] c Cache.
+ * @param[in] reg Register address.
+ * @param[in] mask Bits to change.
+ * @param[in] val New bit values.
+ * @return SW_I2C_OK, the bus status, SW_I2C_ERR_NO_DATA for an unknown
+ *         write-only register, or SW_I2C_ERR_PARAM.
+ */
+sw_i2c_status_e SW_I2C_Cache_Update_Bits(sw_i2c_cache_t *c, uint16_t reg, uint8_t mask, uint8_t val)
+{
+    uint8_t *state, old, new;
+    sw_i2c_status_e st;
+
+    if (!cache_valid(c))
+        return SW_I2C_ERR_PARAM;
+    state = cache_state(c, reg);
+    if (!cache_known(state) && cache_kind(state) == SW_I2C_CACHE_WRITE_ONLY)
+        return SW_I2C_ERR_NO_DATA;
+
+    st = SW_I2C_Lock(c->bus);
+    if (st != SW_I2C_OK)
+        return st;
+
+    if (cache_known(state))
+    {
+        old = c->value[reg - c->base];
+        c->hits++;
+    }
+    else
+    {
+        st = cache_xfer(c, reg, &old, 1, 1);
+    }
+    if (st == SW_I2C_OK)
+    {
+        new = (old & ~mask) | (val & mask);
+        if (new == old)
+        {
+            c->skipped++;
+            cache_store(c, state, reg, old, st);
+        }
+        else
+        {
+            st = cache_xfer(c, reg, &new, 0, 1);
+            cache_store(c, state, reg, new, st);
+        }
+    }
+    SW_I2C_Unlock(c->bus);
+    return st;
+}
+
+/**
+ * @brief Write every known non-volatile register back to the device,
+ * e.g. after it lost power. Runs under one bus lock.
+ *
+ * @param[in] c Cache.
+ * @return SW_I2C_OK, the first failure or SW_I2C_ERR_PARAM.
+ */
+sw_i2c_status_e SW_I2C_Cache_Sync(sw_i2c_cache_t *c)
+{
+    sw_i2c_status_e st, ret = SW_I2C_OK;
+
+    if (!cache_valid(c) || c->state == NULL)
+        return SW_I2C_ERR_PARAM;
+    st = SW_I2C_Lock(c->bus);
+    if (st != SW_I2C_OK)
+        return st;
+
+    for (uint16_t i = 0; i < c->cnt; i++)
+    {
+        uint8_t *state = &c->state[i];
+        uint8_t val = c->value[i];
+
+        if (!cache_known(state))
+            continue;
+        st = cache_xfer(c, c->base + i, &val, 0, 1);
+        cache_store(c, state, c->base + i, val, st);
+        if (ret == SW_I2C_OK)
+            ret = st;
+    }
+    SW_I2C_Unlock(c->bus);
+    return ret;
+}
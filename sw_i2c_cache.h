@@ -0,0 +1,40 @@
+#ifndef _SW_I2C_CACHE_H_
+#define _SW_I2C_CACHE_H_
+
+#include "sw_i2c.h"
+
+/* Register kinds, low bits of sw_i2c_cache_t.state[] */
+#define SW_I2C_CACHE_VOLATILE   0x00    // always read from and written to the device
+#define SW_I2C_CACHE_CACHED     0x01    // reads served from the shadow once known
+#define SW_I2C_CACHE_WRITE_ONLY 0x02    // never read from the device, shadow is the value
+#define SW_I2C_CACHE_KIND_MASK  0x0F
+#define SW_I2C_CACHE_VALID      0x80    // shadow holds the device value
+
+/**
+ * Shadow of a window of 8-bit registers of one target. value[] and state[]
+ * have cnt entries and belong to the caller; state[] holds the kind of each
+ * register (all SW_I2C_CACHE_VOLATILE when zeroed). Registers outside the
+ * window are passed through as volatile. A cache without a bus or with
+ * alen other than 1 or 2 is rejected with SW_I2C_ERR_PARAM.
+ */
+typedef struct
+{
+    sw_i2c_t * bus;
+    uint8_t IICID;
+    uint8_t alen;               // register address bytes, 1 or 2
+    uint16_t base;              // first register of the window
+    uint16_t cnt;               // registers in the window
+    uint8_t * value;
+    uint8_t * state;
+    uint32_t hits;              // reads served from the shadow
+    uint32_t skipped;           // writes dropped as unchanged
+} sw_i2c_cache_t;
+
+void SW_I2C_Cache_Set_Kind(sw_i2c_cache_t *c, uint16_t reg, uint16_t num, uint8_t kind);
+void SW_I2C_Cache_Invalidate(sw_i2c_cache_t *c);
+sw_i2c_status_e SW_I2C_Cache_Read(sw_i2c_cache_t *c, uint16_t reg, uint8_t *val);
+sw_i2c_status_e SW_I2C_Cache_Write(sw_i2c_cache_t *c, uint16_t reg, uint8_t val);
+sw_i2c_status_e SW_I2C_Cache_Update_Bits(sw_i2c_cache_t *c, uint16_t reg, uint8_t mask, uint8_t val);
+sw_i2c_status_e SW_I2C_Cache_Sync(sw_i2c_cache_t *c);
+
+#endif /* _SW_I2C_CACHE_H_ */
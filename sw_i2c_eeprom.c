@@ -0,0 +1,121 @@
+/***
+ * 24Cxx EEPROM access on top of the soft I2C core: page split writes and
+ * ACK polling instead of a fixed write-cycle delay.
+ */
+
+#include "sw_i2c_eeprom.h"
+#include "task.h"
+
+/* Device address for a memory address, with block select bits if needed */
+static uint8_t eeprom_iicid(const sw_i2c_eeprom_t *e, uint32_t addr)
+{
+    return e->IICID | (uint8_t)(((addr >> (e->addr_bytes * 8)) & 0x07) << 1);
+}
+
+static sw_i2c_status_e eeprom_check(const sw_i2c_eeprom_t *e, uint32_t addr, const void *pdata, size_t cnt)
+{
+    if (e == NULL || e->bus == NULL || pdata == NULL || e->page_size == 0)
+        return SW_I2C_ERR_PARAM;
+    if (e->addr_bytes < 1 || e->addr_bytes > 2)
+        return SW_I2C_ERR_PARAM;
+    if (addr > e->size || cnt > e->size - addr)
+        return SW_I2C_ERR_PARAM;
+    return SW_I2C_OK;
+}
+
+/**
+ * @brief Wait for the end of an internal write cycle.
+ *
+ * Probes the device address every poll_ms until it is ACKed again. The
+ * task sleeps between probes with the bus lock released, so other tasks
+ * can use the bus and the bus is not flooded with address bytes.
+ *
+ * @param[in] e EEPROM descriptor.
+ * @return SW_I2C_OK when ready, SW_I2C_ERR_ADDR_NACK after write_timeout_ms,
+ *         SW_I2C_ERR_PARAM without a bus.
+ */
+sw_i2c_status_e SW_I2C_EEPROM_Wait_Ready(const sw_i2c_eeprom_t *e)
+{
+    sw_i2c_msg_t probe = { .flags = 0, .len = 0, .buf = NULL };
+    uint32_t timeout;
+    TickType_t start = xTaskGetTickCount(), poll;
+    sw_i2c_status_e st;
+
+    if (e == NULL || e->bus == NULL)
+        return SW_I2C_ERR_PARAM;
+    probe.IICID = e->IICID;
+    timeout = e->write_timeout_ms ? e->write_timeout_ms : SW_I2C_EEPROM_WRITE_TIMEOUT_MS;
+    poll = pdMS_TO_TICKS(e->poll_ms ? e->poll_ms : SW_I2C_EEPROM_POLL_MS);
+    for (;;)
+    {
+        st = SW_I2C_Transfer(e->bus, &probe, 1);
+        if (st != SW_I2C_ERR_ADDR_NACK)
+            return st;
+        // +1: the first tick may be almost over
+        if ((xTaskGetTickCount() - start) > pdMS_TO_TICKS(timeout) + 1)
+            return st;
+        vTaskDelay(poll ? poll : 1);
+    }
+}
+
+/**
+ * @brief Sequential read, any length, crossing block boundaries.
+ *
+ * @param[in] e EEPROM descriptor.
+ * @param[in] addr Memory address.
+ * @param[out] pdata Buffer for the data.
+ * @param[in] cnt Number of bytes.
+ * @return SW_I2C_OK or the reason of the failure.
+ */
+sw_i2c_status_e SW_I2C_EEPROM_Read(const sw_i2c_eeprom_t *e, uint32_t addr, uint8_t *pdata, size_t cnt)
+{
+    uint32_t block;
+    sw_i2c_status_e st = eeprom_check(e, addr, pdata, cnt);
+
+    if (st != SW_I2C_OK)
+        return st;
+    block = 1UL << (e->addr_bytes * 8);
+    while (st == SW_I2C_OK && cnt)
+    {
+        size_t chunk = block - (addr & (block - 1));
+        if (chunk > cnt)
+            chunk = cnt;
+        st = SW_I2C_Read_Mem(e->bus, eeprom_iicid(e, addr), (uint16_t)addr, e->addr_bytes, pdata, chunk);
+        addr += chunk;
+        pdata += chunk;
+        cnt -= chunk;
+    }
+    return st;
+}
+
+/**
+ * @brief Write any length, split on page boundaries.
+ *
+ * Each page is written in one transaction and the next one starts as soon
+ * as the device ACKs its address again. Returns after the last write cycle
+ * has finished.
+ *
+ * @param[in] e EEPROM descriptor.
+ * @param[in] addr Memory address.
+ * @param[in] pdata Data to write.
+ * @param[in] cnt Number of bytes.
+ * @return SW_I2C_OK or the reason of the failure.
+ */
+sw_i2c_status_e SW_I2C_EEPROM_Write(const sw_i2c_eeprom_t *e, uint32_t addr, const uint8_t *pdata, size_t cnt)
+{
+    sw_i2c_status_e st = eeprom_check(e, addr, pdata, cnt);
+
+    while (st == SW_I2C_OK && cnt)
+    {
+        size_t chunk = e->page_size - (addr % e->page_size);
+        if (chunk > cnt)
+            chunk = cnt;
+        st = SW_I2C_Write_Mem(e->bus, eeprom_iicid(e, addr), (uint16_t)addr, e->addr_bytes, pdata, chunk);
+        if (st == SW_I2C_OK)
+            st = SW_I2C_EEPROM_Wait_Ready(e);
+        addr += chunk;
+        pdata += chunk;
+        cnt -= chunk;
+    }
+    return st;
+}
@@ -0,0 +1,29 @@
+#ifndef _SW_I2C_EEPROM_H_
+#define _SW_I2C_EEPROM_H_
+
+#include "sw_i2c.h"
+
+#define SW_I2C_EEPROM_WRITE_TIMEOUT_MS  10  // default when write_timeout_ms is 0
+#define SW_I2C_EEPROM_POLL_MS           1   // default when poll_ms is 0
+
+/**
+ * 24Cxx-style EEPROM on a soft I2C bus.
+ * Address bits above addr_bytes*8 go to the block select bits of IICID
+ * (24C04..24C16, 24CM01/02).
+ */
+typedef struct
+{
+    sw_i2c_t * bus;
+    uint8_t IICID;              // 8-bit base address, e.g. 0xA0
+    uint8_t addr_bytes;         // 1 or 2
+    uint16_t page_size;         // bytes per page write
+    uint32_t size;              // total bytes
+    uint32_t write_timeout_ms;  // longest write cycle accepted by ACK polling
+    uint32_t poll_ms;           // pause between ACK polls, at least a tick; 0 = SW_I2C_EEPROM_POLL_MS
+} sw_i2c_eeprom_t;
+
+sw_i2c_status_e SW_I2C_EEPROM_Read(const sw_i2c_eeprom_t *e, uint32_t addr, uint8_t *pdata, size_t cnt);
+sw_i2c_status_e SW_I2C_EEPROM_Write(const sw_i2c_eeprom_t *e, uint32_t addr, const uint8_t *pdata, size_t cnt);
+sw_i2c_status_e SW_I2C_EEPROM_Wait_Ready(const sw_i2c_eeprom_t *e);
+
+#endif /* _SW_I2C_EEPROM_H_ */
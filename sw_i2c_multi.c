@@ -0,0 +1,438 @@
+/***
+ * Lockstep engine for soft I2C buses sharing one GPIO port: the same
+ * transaction shape runs on every bus of a group at once, so N identical
+ * sensors cost one transaction time instead of N.
+ *
+ * A bus that fails (NACK, stretch timeout) gets a STOP in the next SCL high
+ * phase and leaves the run, its SCL stops unless another bus shares the pin;
+ * a busy bus is left alone. The others continue.
+ */
+
+#include "sw_i2c_multi.h"
+#include "sw_i2c_phase.h"
+
+#ifndef TRUE
+	#define TRUE 1
+#endif
+#ifndef FALSE
+	#define FALSE 0
+#endif
+
+/* State of one lockstep run, pins as port masks */
+typedef struct
+{
+    sw_i2c_multi_t * g;
+    sw_i2c_t * d;           // delay hooks
+    uint32_t scl;           // SCL pins clocked in this run
+    uint32_t sda;           // SDA pins of the buses that got their bus and are not stopped
+    uint32_t active;        // SDA pins of the buses without a failure yet
+    uint32_t stopping;      // SDA pins of failed buses owed a STOP
+    sw_i2c_timing_t tm;     // longest phase waits of the group
+    uint8_t stretch;        // some bus allows clock stretching
+    sw_i2c_status_e * status;
+} multi_run_t;
+
+static inline void multi_out(multi_run_t *r, uint32_t set, uint32_t reset)
+{
+    SW_I2C_REG_WRITE(r->g->set, set | (reset << 16));
+}
+
+static void multi_wait(multi_run_t *r, uint32_t ns)
+{
+    if (ns <= r->d->wait_trim_ns)
+        return;
+    ns -= r->d->wait_trim_ns;
+    if (r->d->hal_delay_ns)
+        r->d->hal_delay_ns(ns);
+    else
+        r->d->hal_delay_us((ns + 999) / 1000);
+}
+
+static void multi_fail(multi_run_t *r, uint8_t i, sw_i2c_status_e st, size_t idx)
+{
+    sw_i2c_t *d = r->g->bus[i];
+
+    if (r->status[i] == SW_I2C_OK)
+    {
+        r->status[i] = st;
+        d->nack_index = idx;
+    }
+    r->stopping |= r->active & d->fast.sda_mask;
+    r->active &= ~d->fast.sda_mask;
+}
+
+/* Failed buses: SDA low while SCL is low, before the rise that starts their STOP */
+static uint32_t multi_stop_setup(multi_run_t *r)
+{
+    uint32_t stop = r->stopping;
+
+    if (stop)
+        multi_out(r, 0, stop);
+    return stop;
+}
+
+/**
+ * SDA released with SCL high: the STOP. The buses leave the run; SCL pins
+ * no running bus shares stay high from now on.
+ */
+static void multi_stop_done(multi_run_t *r, uint32_t stop)
+{
+    uint32_t scl = 0;
+
+    if (!stop)
+        return;
+    multi_out(r, stop, 0);
+    r->stopping &= ~stop;
+    r->sda &= ~stop;
+    for (uint8_t i = 0; i < r->g->cnt; i++)
+    {
+        if (r->sda & r->g->bus[i]->fast.sda_mask)
+            scl |= r->g->bus[i]->fast.scl_mask;
+    }
+    r->scl = scl;
+}
+
+/* Release SCL; with stretching, wait until every clocked SCL is high */
+static void multi_scl_high(multi_run_t *r)
+{
+    uint32_t step, limit, waited = 0, level;
+
+    multi_out(r, r->scl, 0);
+    if (!r->stretch)
+        return;
+
+    step = (r->tm.low_ns + r->tm.high_ns) >> 3;
+    if (step == 0)
+        step = 1;
+    limit = (r->d->stretch_timeout_us ? r->d->stretch_timeout_us : SW_I2C_STRETCH_TIMEOUT_US) * 1000UL;
+    while (((level = SW_I2C_REG_READ(r->g->in)) & r->scl) != r->scl)
+    {
+        if (waited >= limit)
+        {
+            for (uint8_t i = 0; i < r->g->cnt; i++)
+            {
+                if (!(level & r->g->bus[i]->fast.scl_mask))
+                    multi_fail(r, i, SW_I2C_ERR_STRETCH_TIMEOUT, 0);
+            }
+            return;
+        }
+        multi_wait(r, step);
+        waited += step;
+    }
+}
+
+/* One clock with the data already on SDA, optionally sampled at the end of SCL high */
+static uint32_t multi_clock(multi_run_t *r, uint8_t sample)
+{
+    uint32_t level = 0, stop = multi_stop_setup(r);
+
+    multi_wait(r, r->tm.low_ns);
+    multi_scl_high(r);
+    multi_wait(r, r->tm.high_ns);
+    if (sample)
+        level = SW_I2C_REG_READ(r->g->in);
+    multi_stop_done(r, stop);           // tSU;STO: a whole tHIGH
+    multi_out(r, 0, r->scl);
+    return level;
+}
+
+/* From an idle bus (tBUF served by the last STOP), or repeated with SCL low */
+static void multi_start(multi_run_t *r, uint8_t repeated)
+{
+    if (repeated)
+    {
+        uint32_t stop = multi_stop_setup(r);
+
+        multi_out(r, r->active, 0);
+        multi_wait(r, r->tm.low_ns);
+        multi_scl_high(r);
+        multi_wait(r, r->tm.su_sta_ns);
+        multi_stop_done(r, stop);       // tSU;STA covers tSU;STO
+    }
+    multi_out(r, 0, r->active);
+    multi_wait(r, r->tm.hd_sta_ns);
+    multi_out(r, 0, r->scl);
+}
+
+static void multi_stop(multi_run_t *r)
+{
+    multi_out(r, 0, r->sda);
+    multi_wait(r, r->tm.low_ns);
+    multi_scl_high(r);
+    multi_wait(r, r->tm.su_sto_ns);
+    multi_out(r, r->sda, 0);
+    multi_wait(r, r->tm.buf_ns);
+}
+
+/* Every wait the longest of the buses, so each target gets its own minimums */
+static void multi_timing_max(sw_i2c_timing_t *tm, const sw_i2c_timing_t *t)
+{
+    if (t->low_ns > tm->low_ns)
+        tm->low_ns = t->low_ns;
+    if (t->high_ns > tm->high_ns)
+        tm->high_ns = t->high_ns;
+    if (t->su_sta_ns > tm->su_sta_ns)
+        tm->su_sta_ns = t->su_sta_ns;
+    if (t->hd_sta_ns > tm->hd_sta_ns)
+        tm->hd_sta_ns = t->hd_sta_ns;
+    if (t->su_sto_ns > tm->su_sto_ns)
+        tm->su_sto_ns = t->su_sto_ns;
+    if (t->buf_ns > tm->buf_ns)
+        tm->buf_ns = t->buf_ns;
+}
+
+/* data[i] goes to bus i; a NACK drops the bus from the run */
+static void multi_write_byte(multi_run_t *r, const uint8_t *data, sw_i2c_status_e err, size_t idx)
+{
+    uint32_t ones[8] = {0}, level;
+
+    for (uint8_t i = 0; i < r->g->cnt; i++)
+    {
+        for (int x = 0; x < 8; x++)
+        {
+            if (data[i] & (1 << x))
+                ones[x] |= r->g->bus[i]->fast.sda_mask;
+        }
+    }
+    for (int x = 7; x >= 0; x--)
+    {
+        multi_out(r, ones[x] & r->active, ~ones[x] & r->active);
+        multi_clock(r, FALSE);
+    }
+    multi_out(r, r->active, 0);
+    level = multi_clock(r, TRUE);
+    for (uint8_t i = 0; i < r->g->cnt; i++)
+    {
+        if ((r->active & r->g->bus[i]->fast.sda_mask) && (level & r->g->bus[i]->fast.sda_mask))
+            multi_fail(r, i, err, idx);
+    }
+}
+
+/* Samples are kept per bit and sorted into bytes after the ACK clock */
+static void multi_read_byte(multi_run_t *r, uint8_t *data, uint8_t ack)
+{
+    uint32_t level[8];
+
+    multi_out(r, r->active, 0);
+    for (int x = 7; x >= 0; x--)
+        level[x] = multi_clock(r, TRUE);
+    if (ack)
+        multi_out(r, 0, r->active);
+    multi_clock(r, FALSE);
+
+    for (uint8_t i = 0; i < r->g->cnt; i++)
+    {
+        uint32_t sda = r->g->bus[i]->fast.sda_mask;
+        uint8_t v = 0;
+
+        for (int x = 7; x >= 0; x--)
+            v = (v << 1) | ((level[x] & sda) ? 1 : 0);
+        data[i] = v;
+    }
+}
+
+/* Every bus must run the same shape: segment flags and lengths */
+static sw_i2c_status_e multi_check_msgs(const sw_i2c_multi_t *g, sw_i2c_msg_t * const *msgs, uint32_t num)
+{
+    if (msgs == NULL || num == 0)
+        return SW_I2C_ERR_PARAM;
+    for (uint8_t i = 0; i < g->cnt; i++)
+    {
+        if (msgs[i] == NULL)
+            return SW_I2C_ERR_PARAM;
+        for (uint32_t k = 0; k < num; k++)
+        {
+            const sw_i2c_msg_t *m = &msgs[i][k];
+
+            if (m->flags != msgs[0][k].flags || m->len != msgs[0][k].len)
+                return SW_I2C_ERR_PARAM;
+            if (m->flags & (SW_I2C_M_RECV_LEN | SW_I2C_M_PEC))
+                return SW_I2C_ERR_PARAM;    // lengths and checksums differ per bus
+            if (m->len != 0 && m->buf == NULL)
+                return SW_I2C_ERR_PARAM;
+            if ((m->flags & SW_I2C_M_RD) && (m->len == 0 || (m->flags & SW_I2C_M_NOSTART)))
+                return SW_I2C_ERR_PARAM;
+        }
+    }
+    return SW_I2C_OK;
+}
+
+static void multi_unlock(sw_i2c_multi_t *g, uint8_t cnt)
+{
+    while (cnt--)
+        SW_I2C_Unlock(g->bus[cnt]);
+}
+
+/**
+ * @brief Group buses for lockstep transfers.
+ *
+ * @param[out] g Group.
+ * @param[in] bus Initialized buses with SW_I2C_FLAG_OPEN_DRAIN and the
+ *            register fast path, all pins on the same port.
+ * @param[in] cnt Number of buses, 1..SW_I2C_MULTI_MAX.
+ * @return SW_I2C_OK or SW_I2C_ERR_PARAM.
+ */
+sw_i2c_status_e SW_I2C_Multi_Init(sw_i2c_multi_t *g, sw_i2c_t * const *bus, uint8_t cnt)
+{
+	if (g == NULL || bus == NULL || cnt == 0 || cnt > SW_I2C_MULTI_MAX)
+		return SW_I2C_ERR_PARAM;
+	for (uint8_t i = 0; i < cnt; i++)
+	{
+		if (bus[i] == NULL || bus[i]->fast.scl_set == NULL || !(bus[i]->flags & SW_I2C_FLAG_OPEN_DRAIN))
+			return SW_I2C_ERR_PARAM;
+	}
+
+	g->set = bus[0]->fast.scl_set;
+	g->in = bus[0]->fast.scl_in;
+	for (uint8_t i = 0; i < cnt; i++)
+	{
+		sw_i2c_t *d = bus[i];
+
+		if (d->fast.scl_set != g->set || d->fast.sda_set != g->set || d->fast.sda_in != g->in)
+			return SW_I2C_ERR_PARAM;
+		g->bus[i] = d;
+	}
+	g->cnt = cnt;
+	return SW_I2C_OK;
+}
+
+/**
+ * @brief Run the same transaction shape on every bus of the group.
+ *
+ * Targets, write data and read buffers may differ per bus, segment flags
+ * and lengths may not. Each phase waits as long as the slowest of the
+ * addressed targets needs (the spec minimums of SW_I2C_Transfer).
+ * Bus locks are taken in group order, each waiting up to the bus's
+ * lock_timeout_ms; when one times out nothing runs and every bus reports
+ * SW_I2C_ERR_LOCK_TIMEOUT.
+ *
+ * @param[in] g Group.
+ * @param[in,out] msgs msgs[i] is the segment array of bus i.
+ * @param[in] num Segments per bus.
+ * @param[out] status Result per bus, also kept for SW_I2C_Last_Status.
+ * @return SW_I2C_OK if every bus succeeded, the first failure otherwise.
+ */
+sw_i2c_status_e SW_I2C_Multi_Transfer(sw_i2c_multi_t *g, sw_i2c_msg_t * const *msgs, uint32_t num, sw_i2c_status_e *status)
+{
+	multi_run_t r = { .g = g, .status = status };
+	uint8_t data[SW_I2C_MULTI_MAX];
+	uint32_t level, ran;
+	sw_i2c_status_e st;
+
+	if (g == NULL || g->cnt == 0 || status == NULL)
+		return SW_I2C_ERR_PARAM;
+	st = multi_check_msgs(g, msgs, num);
+	if (st != SW_I2C_OK)
+		return st;
+
+	for (uint8_t i = 0; i < g->cnt; i++)
+	{
+		st = SW_I2C_Lock(g->bus[i]);
+		if (st != SW_I2C_OK)
+		{
+			multi_unlock(g, i);
+			for (i = 0; i < g->cnt; i++)
+				status[i] = st;
+			return st;
+		}
+	}
+
+	r.d = g->bus[0];
+	level = SW_I2C_REG_READ(g->in);
+	for (uint8_t i = 0; i < g->cnt; i++)
+	{
+		sw_i2c_t *d = g->bus[i];
+		sw_i2c_timing_t tm = sw_i2c_spec_timing(SW_I2C_Target_Clock(d, msgs[i][0].IICID), d->rise_ns);
+
+		multi_timing_max(&r.tm, &tm);
+		if (d->flags & SW_I2C_FLAG_CLOCK_STRETCH)
+			r.stretch = TRUE;
+		d->nack_index = 0;
+		status[i] = SW_I2C_OK;
+		if (!(level & d->fast.scl_mask) || !(level & d->fast.sda_mask))
+		{
+			status[i] = SW_I2C_ERR_BUS_BUSY;
+			continue;
+		}
+		r.scl |= d->fast.scl_mask;
+		r.sda |= d->fast.sda_mask;
+	}
+	r.active = ran = r.sda;
+
+	for (uint32_t k = 0; k < num && r.active; k++)
+	{
+		const sw_i2c_msg_t *m = &msgs[0][k];
+
+		if (k == 0 || !(m->flags & SW_I2C_M_NOSTART))
+		{
+			multi_start(&r, k > 0);
+			for (uint8_t i = 0; i < g->cnt; i++)
+				data[i] = (m->flags & SW_I2C_M_RD) ? (msgs[i][k].IICID | I2C_READ) : (msgs[i][k].IICID & ~I2C_READ);
+			multi_write_byte(&r, data, SW_I2C_ERR_ADDR_NACK, 0);
+		}
+		for (size_t j = 0; j < m->len && r.active; j++)
+		{
+			if (m->flags & SW_I2C_M_RD)
+			{
+				uint32_t active = r.active;
+
+				multi_read_byte(&r, data, j + 1 < m->len);
+				for (uint8_t i = 0; i < g->cnt; i++)
+				{
+					if (active & g->bus[i]->fast.sda_mask)
+						msgs[i][k].buf[j] = data[i];
+				}
+			}
+			else
+			{
+				for (uint8_t i = 0; i < g->cnt; i++)
+					data[i] = msgs[i][k].buf[j];
+				multi_write_byte(&r, data, (m->flags & SW_I2C_M_REG) ? SW_I2C_ERR_REG_NACK : SW_I2C_ERR_DATA_NACK, j);
+			}
+		}
+	}
+	if (r.sda)
+		multi_stop(&r);                 // the running buses and those still owed a STOP
+	else if (ran)
+		multi_wait(&r, r.tm.buf_ns);    // every bus got its STOP early
+
+	st = SW_I2C_OK;
+	for (uint8_t i = 0; i < g->cnt; i++)
+	{
+		g->bus[i]->status = status[i];
+		if (st == SW_I2C_OK)
+			st = status[i];
+	}
+	multi_unlock(g, g->cnt);
+	return st;
+}
+
+/**
+ * @brief Read the same register of the same target type on every bus.
+ *
+ * @param[in] g Group.
+ * @param[in] IICID 8-bit target address, identical on every bus.
+ * @param[in] memaddr Register address.
+ * @param[in] alen Register address bytes, 0..2.
+ * @param[out] pdata pdata[i] receives cnt bytes from bus i.
+ * @param[in] cnt Bytes per bus.
+ * @param[out] status Result per bus.
+ * @return SW_I2C_OK if every bus succeeded, the first failure otherwise.
+ */
+sw_i2c_status_e SW_I2C_Multi_Read_Mem(sw_i2c_multi_t *g, uint8_t IICID, uint16_t memaddr, uint8_t alen, uint8_t * const *pdata, size_t cnt, sw_i2c_status_e *status)
+{
+	uint8_t reg[2] = { (uint8_t)(memaddr >> 8), (uint8_t)memaddr };
+	sw_i2c_msg_t m[SW_I2C_MULTI_MAX][2];
+	sw_i2c_msg_t *msgs[SW_I2C_MULTI_MAX];
+
+	if (g == NULL || pdata == NULL || alen > 2)
+		return SW_I2C_ERR_PARAM;
+
+	for (uint8_t i = 0; i < g->cnt; i++)
+	{
+		m[i][0] = (sw_i2c_msg_t){ .IICID = IICID, .flags = SW_I2C_M_REG, .len = alen, .buf = &reg[2 - alen] };
+		m[i][1] = (sw_i2c_msg_t){ .IICID = IICID, .flags = SW_I2C_M_RD, .len = cnt, .buf = pdata[i] };
+		msgs[i] = alen ? m[i] : &m[i][1];
+	}
+	return SW_I2C_Multi_Transfer(g, msgs, alen ? 2 : 1, status);
+}
@@ -0,0 +1,25 @@
+#ifndef _SW_I2C_MULTI_H_
+#define _SW_I2C_MULTI_H_
+
+#include "sw_i2c.h"
+
+#define SW_I2C_MULTI_MAX    8       // buses in one group
+
+/**
+ * Buses whose SCL and SDA pins all sit on one GPIO port, clocked in
+ * lockstep: every edge is one store to the port's set/reset register and
+ * every sample one load of its input register. SCL pins may be shared.
+ */
+typedef struct
+{
+    sw_i2c_t * bus[SW_I2C_MULTI_MAX];
+    uint8_t cnt;
+    volatile uint32_t * set;    // bit set/reset register of the port
+    volatile uint32_t * in;     // input register of the port
+} sw_i2c_multi_t;
+
+sw_i2c_status_e SW_I2C_Multi_Init(sw_i2c_multi_t *g, sw_i2c_t * const *bus, uint8_t cnt);
+sw_i2c_status_e SW_I2C_Multi_Transfer(sw_i2c_multi_t *g, sw_i2c_msg_t * const *msgs, uint32_t num, sw_i2c_status_e *status);
+sw_i2c_status_e SW_I2C_Multi_Read_Mem(sw_i2c_multi_t *g, uint8_t IICID, uint16_t memaddr, uint8_t alen, uint8_t * const *pdata, size_t cnt, sw_i2c_status_e *status);
+
+#endif /* _SW_I2C_MULTI_H_ */
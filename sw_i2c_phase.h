@@ -0,0 +1,185 @@
+/***
+ * I2C protocol phases shared by the C core (sw_i2c.c) and the C++ front end
+ * (sw_i2c.hpp).
+ *
+ * The first part derives the phase waits for a clock from the spec and is
+ * an ordinary header. The second part is the bit level of the protocol,
+ * written against hooks the includer defines before including this file
+ * again; it is compiled once per set of hooks, so the C core gets it on
+ * top of its runtime line primitives and every C++ bus on top of constant
+ * register stores and delays:
+ *
+ *   SW_I2C_PH_DECL               storage of the functions, e.g. static inline
+ *   SW_I2C_PH_CTX                first parameter, named d, passed to the hooks
+ *   SW_I2C_PH_SCL_HIGH(d)        release SCL
+ *   SW_I2C_PH_SCL_LOW(d)         pull SCL low
+ *   SW_I2C_PH_SDA_HIGH(d)        release SDA
+ *   SW_I2C_PH_SDA_LOW(d)         pull SDA low
+ *   SW_I2C_PH_SDA_INPUT(d)       hand SDA to the target
+ *   SW_I2C_PH_SDA_OUTPUT(d)      take SDA back
+ *   SW_I2C_PH_SDA_GET(d)         SDA level, non-zero when high
+ *   SW_I2C_PH_SCL_WAIT_HIGH(d)   after a release, wait out a stretching target
+ *   SW_I2C_PH_WAIT(d, t)         wait sw_i2c_timing_t member t (low_ns ...)
+ *
+ * Every phase starts and ends right after SCL falls.
+ */
+#ifndef _SW_I2C_PHASE_H_
+#define _SW_I2C_PHASE_H_
+
+#include "sw_i2c.h"
+
+#ifdef __cplusplus
+#define SW_I2C_CONSTEXPR    constexpr
+#else
+#define SW_I2C_CONSTEXPR
+#endif
+
+/* UM10204 timing minimums per speed mode in ns; rise is the spec's maximum tr */
+typedef struct
+{
+    uint32_t max_hz;
+    uint16_t low, high, su_sta, hd_sta, su_sto, buf, rise;
+} sw_i2c_spec_t;
+
+/**
+ * Phase waits for a clock: the minimums of the slowest mode that allows
+ * it, SCL high times extended by the rise time (rise_ns, 0 for the mode's
+ * maximum), and whatever the clock period leaves over split between SCL
+ * low and high. A clock beyond the mode's minimums runs at the minimums.
+ * tSU;DAT is shorter than tLOW in every mode, so data set right after SCL
+ * falls always meets it. Constant in C++, so a bus template gets its waits
+ * at compile time.
+ */
+static SW_I2C_CONSTEXPR inline sw_i2c_timing_t sw_i2c_spec_timing(uint32_t hz, uint32_t rise_ns)
+{
+    const sw_i2c_spec_t spec[] =
+    {
+        { SW_I2C_SPEED_STANDARD,  4700, 4000, 4700, 4000, 4000, 4700, 1000 },
+        { SW_I2C_SPEED_FAST,      1300,  600,  600,  600,  600, 1300,  300 },
+        { SW_I2C_SPEED_FAST_PLUS,  500,  260,  260,  260,  260,  500,  120 },
+    };
+    uint32_t m = 0;
+
+    while (m + 1 < sizeof(spec) / sizeof(spec[0]) && hz > spec[m].max_hz)
+        m++;
+
+    const uint32_t rise = rise_ns ? rise_ns : spec[m].rise;
+    const uint32_t low = spec[m].low, high = spec[m].high + rise;
+    const uint32_t period = 1000000000UL / hz;
+    const uint32_t spare = period > low + high ? period - low - high : 0;
+    const sw_i2c_timing_t t =
+    {
+        hz,
+        low + spare / 2,
+        high + spare - spare / 2,
+        spec[m].su_sta + rise,
+        spec[m].hd_sta,
+        spec[m].su_sto + rise,
+        spec[m].buf,
+    };
+    return t;
+}
+
+#endif /* _SW_I2C_PHASE_H_ */
+
+#ifdef SW_I2C_PH_DECL
+
+/* One clock with SDA already set: low time, release, high time, fall */
+SW_I2C_PH_DECL void i2c_clk_data_out(SW_I2C_PH_CTX)
+{
+    SW_I2C_PH_WAIT(d, low_ns);
+    SW_I2C_PH_SCL_HIGH(d);
+    SW_I2C_PH_SCL_WAIT_HIGH(d);
+    SW_I2C_PH_WAIT(d, high_ns);
+    SW_I2C_PH_SCL_LOW(d);
+}
+
+/* From an idle bus (tBUF served by the last STOP), or repeated with SCL low */
+SW_I2C_PH_DECL void i2c_start_condition(SW_I2C_PH_CTX, uint8_t repeated)
+{
+    if (repeated)
+    {
+        SW_I2C_PH_SDA_HIGH(d);
+        SW_I2C_PH_WAIT(d, low_ns);
+        SW_I2C_PH_SCL_HIGH(d);
+        SW_I2C_PH_SCL_WAIT_HIGH(d);
+        SW_I2C_PH_WAIT(d, su_sta_ns);
+    }
+    SW_I2C_PH_SDA_LOW(d);
+    SW_I2C_PH_WAIT(d, hd_sta_ns);
+    SW_I2C_PH_SCL_LOW(d);
+}
+
+SW_I2C_PH_DECL void i2c_stop_condition(SW_I2C_PH_CTX)
+{
+    SW_I2C_PH_SDA_LOW(d);
+    SW_I2C_PH_WAIT(d, low_ns);
+    SW_I2C_PH_SCL_HIGH(d);
+    SW_I2C_PH_SCL_WAIT_HIGH(d);
+    SW_I2C_PH_WAIT(d, su_sto_ns);
+    SW_I2C_PH_SDA_HIGH(d);
+    SW_I2C_PH_WAIT(d, buf_ns);
+}
+
+/* Ninth clock of a write: SDA released, sampled at the end of SCL high */
+SW_I2C_PH_DECL uint8_t i2c_check_ack(SW_I2C_PH_CTX)
+{
+    uint8_t ack;
+
+    SW_I2C_PH_SDA_INPUT(d);
+    SW_I2C_PH_WAIT(d, low_ns);
+    SW_I2C_PH_SCL_HIGH(d);
+    SW_I2C_PH_SCL_WAIT_HIGH(d);
+    SW_I2C_PH_WAIT(d, high_ns);
+    ack = !SW_I2C_PH_SDA_GET(d);
+    SW_I2C_PH_SCL_LOW(d);
+    SW_I2C_PH_SDA_OUTPUT(d);
+    return ack;
+}
+
+/* Ninth clock of a read: ACK for more data, NACK after the last byte */
+SW_I2C_PH_DECL void i2c_send_ack(SW_I2C_PH_CTX, uint8_t ack)
+{
+    SW_I2C_PH_SDA_OUTPUT(d);
+    if (ack)
+        SW_I2C_PH_SDA_LOW(d);
+    else
+        SW_I2C_PH_SDA_HIGH(d);
+    i2c_clk_data_out(d);
+    SW_I2C_PH_SDA_HIGH(d);
+}
+
+/* Eight data bits, MSB first; the ACK clock is the caller's */
+SW_I2C_PH_DECL void i2c_shift_out(SW_I2C_PH_CTX, uint8_t data)
+{
+    for (int x = 7; x >= 0; x--)
+    {
+        if (data & (1 << x))
+            SW_I2C_PH_SDA_HIGH(d);
+        else
+            SW_I2C_PH_SDA_LOW(d);
+        i2c_clk_data_out(d);
+    }
+}
+
+/* Eight bits sampled at the end of SCL high, SDA left to the target */
+SW_I2C_PH_DECL uint8_t i2c_shift_in(SW_I2C_PH_CTX)
+{
+    uint8_t data = 0;
+
+    SW_I2C_PH_SDA_INPUT(d);
+    for (int x = 8; x--;)
+    {
+        SW_I2C_PH_WAIT(d, low_ns);
+        SW_I2C_PH_SCL_HIGH(d);
+        SW_I2C_PH_SCL_WAIT_HIGH(d);
+        SW_I2C_PH_WAIT(d, high_ns);
+        data <<= 1;
+        if (SW_I2C_PH_SDA_GET(d))
+            data |= 0x01;
+        SW_I2C_PH_SCL_LOW(d);
+    }
+    return data;
+}
+
+#endif /* SW_I2C_PH_DECL */
@@ -0,0 +1,264 @@
+/***
+ * Periodic register polling on one soft I2C bus.
+ *
+ * Due reads run earliest deadline first. Due blocks of the same target that
+ * border each other are merged into one transfer. Each item publishes into
+ * a double-buffered snapshot guarded by a sequence counter, so consumers in
+ * other tasks never wait for the bus.
+ */
+
+#include <string.h>
+#include "sw_i2c_poll.h"
+
+#define TAG "SW_I2C"
+#include "log.h"
+
+#ifndef TRUE
+	#define TRUE 1
+#endif
+#ifndef FALSE
+	#define FALSE 0
+#endif
+
+#define POLL_MERGE_MAX      8   // items one transfer may serve
+
+/* Tick comparison that survives counter wrap */
+static inline uint8_t poll_reached(TickType_t now, TickType_t t)
+{
+    return (int32_t)(now - t) >= 0;
+}
+
+static void poll_schedule(sw_i2c_poll_item_t *it, TickType_t now)
+{
+    TickType_t period = pdMS_TO_TICKS(it->period_ms);
+
+    if (period == 0)
+        period = 1;
+    do
+    {
+        it->release += period;
+    } while (poll_reached(now, it->release));
+    it->deadline = it->release + pdMS_TO_TICKS(it->deadline_ms ? it->deadline_ms : it->period_ms);
+}
+
+/* Writer side: fill the spare slot, then make it current */
+static void poll_publish(sw_i2c_poll_item_t *it, const uint8_t *pdata, sw_i2c_status_e st, TickType_t stamp)
+{
+    uint32_t slot = (it->seq + 1) & 1;
+
+    memcpy(it->data[slot], pdata, it->len);
+    it->status[slot] = st;
+    it->stamp[slot] = stamp;
+    SW_I2C_POLL_BARRIER();
+    it->seq++;
+}
+
+/* Due item with the earliest absolute deadline */
+static sw_i2c_poll_item_t * poll_next_due(sw_i2c_poll_t *p, TickType_t now)
+{
+    sw_i2c_poll_item_t *best = NULL;
+
+    for (sw_i2c_poll_item_t *it = p->items; it; it = it->next)
+    {
+        if (!poll_reached(now, it->release))
+            continue;
+        if (best == NULL || (int32_t)(it->deadline - best->deadline) < 0)
+            best = it;
+    }
+    return best;
+}
+
+static uint8_t poll_is_served(sw_i2c_poll_item_t * const *served, uint8_t n, const sw_i2c_poll_item_t *it)
+{
+    for (uint8_t i = 0; i < n; i++)
+    {
+        if (served[i] == it)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* Due item of the same target whose block touches the merged range */
+static sw_i2c_poll_item_t * poll_neighbour(sw_i2c_poll_t *p, sw_i2c_poll_item_t * const *served, uint8_t n,
+                                          uint32_t start, uint32_t end, TickType_t now)
+{
+    const sw_i2c_poll_item_t *first = served[0];
+
+    for (sw_i2c_poll_item_t *it = p->items; it; it = it->next)
+    {
+        if (!poll_reached(now, it->release) || poll_is_served(served, n, it))
+            continue;
+        if (it->IICID != first->IICID || it->alen != first->alen)
+            continue;
+        if ((it->regaddr == end || it->regaddr + it->len == start)
+            && end - start + it->len <= SW_I2C_POLL_BATCH_MAX)
+            return it;
+    }
+    return NULL;
+}
+
+static void poll_execute(sw_i2c_poll_t *p, sw_i2c_poll_item_t *first, TickType_t now)
+{
+    sw_i2c_poll_item_t *served[POLL_MERGE_MAX];
+    uint8_t buf[SW_I2C_POLL_BATCH_MAX];
+    uint32_t start = first->regaddr, end = first->regaddr + first->len;
+    uint8_t n = 1;
+    sw_i2c_status_e st;
+    TickType_t done;
+
+    served[0] = first;
+    while (first->alen && n < POLL_MERGE_MAX)
+    {
+        sw_i2c_poll_item_t *it = poll_neighbour(p, served, n, start, end, now);
+        if (it == NULL)
+            break;
+        served[n++] = it;
+        if (it->regaddr == end)
+            end += it->len;
+        else
+            start = it->regaddr;
+    }
+
+    st = SW_I2C_Read_Mem(p->bus, first->IICID, start, first->alen, buf, end - start);
+    done = xTaskGetTickCount();
+    p->reads++;
+    p->coalesced += n - 1;
+
+    for (uint8_t i = 0; i < n; i++)
+    {
+        sw_i2c_poll_item_t *it = served[i];
+
+        poll_publish(it, &buf[it->regaddr - start], st, done);
+        if (!poll_reached(it->deadline, done))
+            it->misses++;
+        poll_schedule(it, done);
+    }
+}
+
+static void poll_task(void * arg)
+{
+    sw_i2c_poll_t * p = arg;
+    for (;;)
+    {
+        vTaskDelay(SW_I2C_Poll_Run(p));
+    }
+}
+
+/**
+ * @brief Prepare a scheduler for a bus.
+ *
+ * @param[out] p Scheduler.
+ * @param[in] bus Initialized bus.
+ * @return SW_I2C_OK or SW_I2C_ERR_PARAM.
+ */
+sw_i2c_status_e SW_I2C_Poll_Init(sw_i2c_poll_t *p, sw_i2c_t *bus)
+{
+    if (p == NULL || bus == NULL)
+        return SW_I2C_ERR_PARAM;
+    memset(p, 0, sizeof(*p));
+    p->bus = bus;
+    return SW_I2C_OK;
+}
+
+/**
+ * @brief Register a block; its first read is due immediately.
+ *
+ * Add items before the scheduler runs or from the scheduler's own task.
+ *
+ * @param[in] p Scheduler.
+ * @param[in,out] item Block description, owned by the scheduler from now on.
+ * @return SW_I2C_OK or SW_I2C_ERR_PARAM.
+ */
+sw_i2c_status_e SW_I2C_Poll_Add(sw_i2c_poll_t *p, sw_i2c_poll_item_t *item)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    if (p == NULL || item == NULL || item->len == 0 || item->len > SW_I2C_POLL_MAX_LEN)
+        return SW_I2C_ERR_PARAM;
+    if (item->alen > 2 || item->period_ms == 0)
+        return SW_I2C_ERR_PARAM;
+
+    item->release = now;
+    item->deadline = now + pdMS_TO_TICKS(item->deadline_ms ? item->deadline_ms : item->period_ms);
+    item->misses = 0;
+    item->seq = 0;
+    item->next = p->items;
+    p->items = item;
+    return SW_I2C_OK;
+}
+
+/**
+ * @brief Run every due read, earliest deadline first.
+ *
+ * For callers with their own loop; SW_I2C_Poll_Start_Task does this in a task.
+ *
+ * @param[in] p Scheduler.
+ * @return Ticks until the next release.
+ */
+TickType_t SW_I2C_Poll_Run(sw_i2c_poll_t *p)
+{
+    sw_i2c_poll_item_t *it;
+    TickType_t now, sleep = pdMS_TO_TICKS(SW_I2C_POLL_IDLE_MS);
+
+    for (;;)
+    {
+        now = xTaskGetTickCount();
+        it = poll_next_due(p, now);
+        if (it == NULL)
+            break;
+        poll_execute(p, it, now);
+    }
+
+    for (it = p->items; it; it = it->next)
+    {
+        if ((TickType_t)(it->release - now) < sleep)
+            sleep = it->release - now;
+    }
+    return sleep ? sleep : 1;
+}
+
+/**
+ * @brief Run the scheduler in a dedicated task.
+ */
+sw_i2c_status_e SW_I2C_Poll_Start_Task(sw_i2c_poll_t *p, UBaseType_t priority, uint32_t stack_words)
+{
+    if (p == NULL)
+        return SW_I2C_ERR_PARAM;
+    if (xTaskCreate(poll_task, "sw_i2c_poll", stack_words, p, priority, &p->task) != pdPASS)
+    {
+        logE("poll task create failed");
+        return SW_I2C_ERR_PARAM;
+    }
+    return SW_I2C_OK;
+}
+
+/**
+ * @brief Copy the latest snapshot of a block, from any task, without locking.
+ *
+ * @param[in] item Registered block.
+ * @param[out] pdata Receives item->len bytes.
+ * @param[out] stamp Tick count of the read, may be NULL.
+ * @return Status of that read, SW_I2C_ERR_NO_DATA before the first one.
+ */
+sw_i2c_status_e SW_I2C_Poll_Get(const sw_i2c_poll_item_t *item, uint8_t *pdata, TickType_t *stamp)
+{
+    sw_i2c_status_e st;
+    uint32_t seq, slot;
+
+    if (item == NULL || pdata == NULL)
+        return SW_I2C_ERR_PARAM;
+    do
+    {
+        seq = item->seq;
+        if (seq == 0)
+            return SW_I2C_ERR_NO_DATA;
+        SW_I2C_POLL_BARRIER();
+        slot = seq & 1;
+        memcpy(pdata, item->data[slot], item->len);
+        st = item->status[slot];
+        if (stamp)
+            *stamp = item->stamp[slot];
+        SW_I2C_POLL_BARRIER();
+    } while (item->seq != seq);
+    return st;
+}
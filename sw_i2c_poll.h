@@ -0,0 +1,59 @@
+#ifndef _SW_I2C_POLL_H_
+#define _SW_I2C_POLL_H_
+
+#include "sw_i2c.h"
+#include "task.h"
+
+#define SW_I2C_POLL_MAX_LEN     16  // bytes per register block
+#define SW_I2C_POLL_BATCH_MAX   32  // bytes one coalesced read may cover
+#define SW_I2C_POLL_IDLE_MS     100 // sleep with no items registered
+
+/* Orders the snapshot stores against the index publish */
+#ifndef SW_I2C_POLL_BARRIER
+#define SW_I2C_POLL_BARRIER()   __sync_synchronize()
+#endif
+
+typedef struct sw_i2c_poll_item_s sw_i2c_poll_item_t;
+
+/**
+ * Register block read every period_ms. The result is published into one of
+ * two snapshot slots; readers take the other one without locking.
+ */
+struct sw_i2c_poll_item_s
+{
+    uint8_t IICID;
+    uint16_t regaddr;
+    uint8_t alen;                   // register address bytes, 0..2
+    uint8_t len;                    // 1..SW_I2C_POLL_MAX_LEN
+    uint32_t period_ms;
+    uint32_t deadline_ms;           // after release, 0 = period
+
+    /* scheduler state */
+    sw_i2c_poll_item_t * next;
+    TickType_t release;
+    TickType_t deadline;            // absolute
+    uint32_t misses;                // reads finished after their deadline
+
+    /* snapshots, slot (seq & 1) is the current one */
+    volatile uint32_t seq;
+    uint8_t data[2][SW_I2C_POLL_MAX_LEN];
+    sw_i2c_status_e status[2];
+    TickType_t stamp[2];
+};
+
+typedef struct
+{
+    sw_i2c_t * bus;
+    sw_i2c_poll_item_t * items;
+    TaskHandle_t task;
+    uint32_t reads;                 // transfers issued
+    uint32_t coalesced;             // items served by another item's transfer
+} sw_i2c_poll_t;
+
+sw_i2c_status_e SW_I2C_Poll_Init(sw_i2c_poll_t *p, sw_i2c_t *bus);
+sw_i2c_status_e SW_I2C_Poll_Add(sw_i2c_poll_t *p, sw_i2c_poll_item_t *item);
+TickType_t SW_I2C_Poll_Run(sw_i2c_poll_t *p);
+sw_i2c_status_e SW_I2C_Poll_Start_Task(sw_i2c_poll_t *p, UBaseType_t priority, uint32_t stack_words);
+sw_i2c_status_e SW_I2C_Poll_Get(const sw_i2c_poll_item_t *item, uint8_t *pdata, TickType_t *stamp);
+
+#endif /* _SW_I2C_POLL_H_ */
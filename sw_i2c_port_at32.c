@@ -23,6 +23,23 @@
 #define SW_I2C1_SCL_PIN     GPIO_PINS_10
 #define SW_I2C1_SDA_PIN     GPIO_PINS_9
 
+/* NVIC priority of the target mode edge interrupts; keep it above every
+ * other interrupt, its latency decides the fastest host clock */
+#define SW_I2C_EXINT_PRIORITY   0
+
+/* Direct register descriptor for the core's edge fast path */
+#define SW_I2C_AT32_FAST(scl_port, scl_pin, sda_port, sda_pin) \
+{                                   \
+    .scl_set = &(scl_port)->scr,    \
+    .scl_clr = &(scl_port)->clr,    \
+    .scl_in = &(scl_port)->idt,     \
+    .sda_set = &(sda_port)->scr,    \
+    .sda_clr = &(sda_port)->clr,    \
+    .sda_in = &(sda_port)->idt,     \
+    .scl_mask = (scl_pin),          \
+    .sda_mask = (sda_pin),          \
+}
+
 /**
  * Static functions prototypes
  */
@@ -34,6 +51,10 @@ static void scl_out_mode(void * arg);
 static int sw_i2c_port_initial(void * arg);
 static int sw_i2c_port_deinit(void * arg);
 static void sw_i2c_port_delay_us(uint32_t us);
+static void sw_i2c_port_delay_ns(uint32_t ns);
+static uint32_t sw_i2c_port_cycles(void);
+static void sw_i2c_port_dwt_enable(void);
+static int sw_i2c_port_edge_irq(void * arg, uint8_t on);
 static int sw_i2c_port_io_ctl(uint8_t opt, void * param);
 
 
@@ -147,6 +168,7 @@ static int sw_i2c_port_initial(void * arg)
         bus->i2c_sem = xSemaphoreCreateMutex();
     xSemaphoreGive(bus->i2c_sem);
 
+    sw_i2c_port_dwt_enable();
     return 0;
 }
 
@@ -173,6 +195,18 @@ static int sw_i2c_port_deinit(void * arg)
 #define DWT_CONTROL    (*(volatile uint32_t *)(DWT_BASE)) /**< Регистр управления DWT */
 #define SCB_DEMCR      (*(volatile uint32_t *)0xE000EDFC) /**< Регистр управления и отслеживания (Debug Exception and Monitor Control Register) */
 
+static uint32_t cycles_per_us;   // SystemCoreClock at the last init
+
+/**
+ * Start CYCCNT once; the delays and the statistics only read it
+ */
+static void sw_i2c_port_dwt_enable(void)
+{
+    SCB_DEMCR |= 0x01000000; // Разрешаем использование DWT
+    DWT_CONTROL |= 1;        // Включаем CYCCNT
+    cycles_per_us = SystemCoreClock / 1000000;
+}
+
 static void sw_i2c_port_delay_us(uint32_t us)
 {
 
@@ -183,23 +217,86 @@ static void sw_i2c_port_delay_us(uint32_t us)
     }
     else
 	{
-		uint32_t cpu_freq_mhz = SystemCoreClock / 1000000;
-
-		// Включаем DWT и CYCCNT
-		SCB_DEMCR |= 0x01000000; // Разрешаем использование DWT
-		DWT_CONTROL |= 1;		 // Включаем CYCCNT
-
 		uint32_t start_ticks = DWT_CYCCNT;
-		uint32_t delay_ticks = us * cpu_freq_mhz;
+		uint32_t delay_ticks = us * cycles_per_us;
 
 		// Ждем, пока не пройдет нужное количество тактов
 		while ((DWT_CYCCNT - start_ticks) < delay_ticks);
-
-		// Отключаем CYCCNT для экономии энергии (по желанию)
-		DWT_CONTROL &= ~1;
 	}
 }
 
+/**
+ * Busy wait with CPU cycle resolution, used for SCL half periods. The core
+ * subtracts the cost of this call measured by SW_I2C_Calibrate.
+ * @param ns nanoseconds, up to ~14 ms at 288 MHz
+ */
+static void sw_i2c_port_delay_ns(uint32_t ns)
+{
+    uint32_t start_ticks = DWT_CYCCNT;
+    uint32_t delay_ticks = ns * cycles_per_us / 1000;
+
+    while ((DWT_CYCCNT - start_ticks) < delay_ticks);
+}
+
+/**
+ * CPU cycle counter for the bus statistics and SW_I2C_Calibrate
+ */
+static uint32_t sw_i2c_port_cycles(void)
+{
+    return DWT_CYCCNT;
+}
+
+static IRQn_Type sw_i2c_port_exint_irqn(uint32_t pin)
+{
+    uint32_t n = __builtin_ctz(pin);
+
+    if (n <= 4)
+        return (IRQn_Type)(EXINT0_IRQn + n);
+    return n <= 9 ? EXINT9_5_IRQn : EXINT15_10_IRQn;
+}
+
+/**
+ * Both-edge EXINT on SCL and SDA for target mode (sw_i2c_slave.c). EXINT
+ * line n is pin n of one port, so the pins' numbers must not be used by
+ * another port's EXINT. The application's handler passes the lines on:
+ *
+ *   void EXINT15_10_IRQHandler(void)
+ *   {
+ *       uint32_t lines = EXINT->intsts & (SW_I2C0_SCL_PIN | SW_I2C0_SDA_PIN);
+ *       EXINT->intsts = lines;
+ *       SW_I2C_Slave_Irq(&slave0, lines);
+ *   }
+ *
+ * @param arg pointer to sw_i2c_t
+ * @param on enable or disable
+ */
+static int sw_i2c_port_edge_irq(void * arg, uint8_t on)
+{
+    sw_i2c_t * bus = arg;
+    exint_init_type exint_init_struct;
+
+    crm_periph_clock_enable(CRM_SCFG_PERIPH_CLOCK, TRUE);
+    scfg_exint_line_config((scfg_port_source_type)(((uint32_t)bus->scl_port - GPIOA_BASE) / 0x400),
+                           (scfg_pins_source_type)__builtin_ctz(bus->scl_pin));
+    scfg_exint_line_config((scfg_port_source_type)(((uint32_t)bus->sda_port - GPIOA_BASE) / 0x400),
+                           (scfg_pins_source_type)__builtin_ctz(bus->sda_pin));
+
+    exint_default_para_init(&exint_init_struct);
+    exint_init_struct.line_enable = on ? TRUE : FALSE;
+    exint_init_struct.line_mode = EXINT_LINE_INTERRUPUT;
+    exint_init_struct.line_select = bus->scl_pin | bus->sda_pin;
+    exint_init_struct.line_polarity = EXINT_TRIGGER_BOTH_EDGE;
+    exint_init(&exint_init_struct);
+    exint_flag_clear(bus->scl_pin | bus->sda_pin);
+
+    if (on)
+    {
+        nvic_irq_enable(sw_i2c_port_exint_irqn(bus->scl_pin), SW_I2C_EXINT_PRIORITY, 0);
+        nvic_irq_enable(sw_i2c_port_exint_irqn(bus->sda_pin), SW_I2C_EXINT_PRIORITY, 0);
+    }
+    return 0;
+}
+
 static int sw_i2c_port_io_ctl(uint8_t opt, void * arg)
 {
     sw_i2c_t * bus = arg;
@@ -256,11 +353,16 @@ sw_i2c_t i2c_bus0 =
     .hal_deinit = sw_i2c_port_deinit,
     .hal_io_ctl = sw_i2c_port_io_ctl,
     .hal_delay_us = sw_i2c_port_delay_us,
+    .hal_delay_ns = sw_i2c_port_delay_ns,
+    .hal_cycles = sw_i2c_port_cycles,
+    .hal_edge_irq = sw_i2c_port_edge_irq,
 
     .scl_pin = SW_I2C0_SCL_PIN,
     .scl_port = SW_I2C0_SCL_PORT,
     .sda_pin = SW_I2C0_SDA_PIN,
     .sda_port = SW_I2C0_SDA_PORT,
+    .fast = SW_I2C_AT32_FAST(SW_I2C0_SCL_PORT, SW_I2C0_SCL_PIN, SW_I2C0_SDA_PORT, SW_I2C0_SDA_PIN),
+    .flags = SW_I2C_FLAG_OPEN_DRAIN,
     .i2c_sem = NULL
 },
 i2c_bus1 =
@@ -269,11 +371,16 @@ i2c_bus1 =
     .hal_deinit = sw_i2c_port_deinit,
     .hal_io_ctl = sw_i2c_port_io_ctl,
     .hal_delay_us = sw_i2c_port_delay_us,
+    .hal_delay_ns = sw_i2c_port_delay_ns,
+    .hal_cycles = sw_i2c_port_cycles,
+    .hal_edge_irq = sw_i2c_port_edge_irq,
 
     .scl_pin = SW_I2C1_SCL_PIN,
     .scl_port = SW_I2C1_SCL_PORT,
     .sda_pin = SW_I2C1_SDA_PIN,
     .sda_port = SW_I2C1_SDA_PORT,
+    .fast = SW_I2C_AT32_FAST(SW_I2C1_SCL_PORT, SW_I2C1_SCL_PIN, SW_I2C1_SDA_PORT, SW_I2C1_SDA_PIN),
+    .flags = SW_I2C_FLAG_OPEN_DRAIN,
     .i2c_sem = NULL
 };
 
@@ -0,0 +1,70 @@
+/***
+ * AT32 port of the compile-time soft I2C bus (sw_i2c.hpp).
+ *
+ * Edges are single stores to the set/clear registers of one GPIO block,
+ * waits spin on the DWT cycle counter, which the C port starts at
+ * SW_I2C_initial. Pins are configured by the C port as usual:
+ *
+ *   using HotBus = sw_i2c::SoftI2c<sw_i2c::At32Port<GPIOA_BASE>,
+ *                                  GPIO_PINS_10, GPIO_PINS_9, sw_i2c::FastPlus>;
+ *
+ *   SW_I2C_Lock(&i2c_bus1);
+ *   st = HotBus::read_mem(0x90, 0x00, 1, buf, 2);
+ *   SW_I2C_Unlock(&i2c_bus1);
+ */
+#ifndef _SW_I2C_PORT_AT32_HPP_
+#define _SW_I2C_PORT_AT32_HPP_
+
+#include "sw_i2c.hpp"
+
+namespace sw_i2c
+{
+
+/**
+ * GPIO block at Base, CPU at CpuHz. TrimNs is taken off every wait for
+ * the edge and the counter read before it; sw_i2c_t.wait_trim_ns as
+ * measured by SW_I2C_Calibrate on the same build is the value to use.
+ */
+template<uintptr_t Base, uint32_t CpuHz = 288000000, uint32_t TrimNs = 0>
+struct At32Port
+{
+    static constexpr uintptr_t scr = Base + offsetof(gpio_type, scr);
+    static constexpr uintptr_t clr = Base + offsetof(gpio_type, clr);
+    static constexpr uintptr_t idt = Base + offsetof(gpio_type, idt);
+    static constexpr uintptr_t dwt_cyccnt = 0xE0001004UL;
+    static constexpr uint32_t wait_trim_ns = TrimNs;
+
+    static inline volatile uint32_t * reg(uintptr_t addr)
+    {
+        return reinterpret_cast<volatile uint32_t *>(addr);
+    }
+
+    static inline void set(uint32_t pins)
+    {
+        SW_I2C_REG_WRITE(reg(scr), pins);
+    }
+
+    static inline void clear(uint32_t pins)
+    {
+        SW_I2C_REG_WRITE(reg(clr), pins);
+    }
+
+    static inline uint32_t input()
+    {
+        return SW_I2C_REG_READ(reg(idt));
+    }
+
+    template<uint32_t Ns>
+    static inline void delay()
+    {
+        constexpr uint32_t ticks = (uint32_t)((uint64_t)Ns * CpuHz / 1000000000UL);
+        uint32_t start = *reg(dwt_cyccnt);
+
+        while (*reg(dwt_cyccnt) - start < ticks)
+            ;
+    }
+};
+
+} // namespace sw_i2c
+
+#endif /* _SW_I2C_PORT_AT32_HPP_ */
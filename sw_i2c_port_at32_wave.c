@@ -0,0 +1,153 @@
+/***
+ * Timer + DMA player for the soft I2C waveform engine on Artery AT32F435/437
+ *
+ * TMR1 overflows once per tick. A software overflow event moves out[0] to
+ * the port's scr register and every overflow after it the next set/reset
+ * word (DMA1 channel 1), so word i is on the port for all of tick i. The
+ * channel 1 compare request on the last timer clock of the tick copies idt
+ * into in[i] (DMA1 channel 2), a full tick after the word, as
+ * SW_I2C_Wave_Play samples. The output channel's transfer complete wakes the
+ * calling task, which waits out the last tick before it returns; the CPU is
+ * free for the whole transfer.
+ *
+ * Usage: SW_I2C_AT32_Wave_Init() once, then
+ * SW_I2C_Wave_Transfer(&i2c_bus0, &wave, msgs, num, SW_I2C_AT32_Wave_Run).
+ */
+
+#include "sw_i2c_wave.h"
+#include "at32f435_437_crm.h"
+#include "at32f435_437_tmr.h"
+#include "at32f435_437_dma.h"
+#include "at32f435_437_misc.h"
+
+#define TAG "I2Cwave"
+#include "log.h"
+
+/**
+ * Macroses
+ */
+#define SW_I2C_WAVE_TMR             TMR1
+#define SW_I2C_WAVE_TMR_CLOCK       CRM_TMR1_PERIPH_CLOCK
+#define SW_I2C_WAVE_DMA             DMA1
+#define SW_I2C_WAVE_DMA_CLOCK       CRM_DMA1_PERIPH_CLOCK
+#define SW_I2C_WAVE_OUT_CH          DMA1_CHANNEL1
+#define SW_I2C_WAVE_OUT_MUX         DMA1MUX_CHANNEL1
+#define SW_I2C_WAVE_OUT_FLAG        DMA1_FDT1_FLAG
+#define SW_I2C_WAVE_OUT_IRQ         DMA1_Channel1_IRQn
+#define SW_I2C_WAVE_IN_CH           DMA1_CHANNEL2
+#define SW_I2C_WAVE_IN_MUX          DMA1MUX_CHANNEL2
+#define SW_I2C_WAVE_IRQ_PRIO        5   // must allow FreeRTOS API calls
+#define SW_I2C_WAVE_IRQHandler      DMA1_Channel1_IRQHandler
+
+/* TMR1 sits on APB2 and runs at the core clock with the default tree */
+#ifndef SW_I2C_WAVE_TMR_HZ
+#define SW_I2C_WAVE_TMR_HZ          SystemCoreClock
+#endif
+
+static SemaphoreHandle_t wave_lock = NULL;
+static SemaphoreHandle_t wave_done = NULL;
+
+static void wave_dma_channel(dma_channel_type *ch, uint8_t to_periph, volatile uint32_t *reg, uint32_t *mem, uint32_t len)
+{
+    dma_init_type dma_init_struct;
+
+    dma_reset(ch);
+    dma_default_para_init(&dma_init_struct);
+    dma_init_struct.buffer_size = len;
+    dma_init_struct.direction = to_periph ? DMA_DIR_MEMORY_TO_PERIPHERAL : DMA_DIR_PERIPHERAL_TO_MEMORY;
+    dma_init_struct.memory_base_addr = (uint32_t)mem;
+    dma_init_struct.memory_data_width = DMA_MEMORY_DATA_WIDTH_WORD;
+    dma_init_struct.memory_inc_enable = TRUE;
+    dma_init_struct.peripheral_base_addr = (uint32_t)reg;
+    dma_init_struct.peripheral_data_width = DMA_PERIPHERAL_DATA_WIDTH_WORD;
+    dma_init_struct.peripheral_inc_enable = FALSE;
+    dma_init_struct.priority = DMA_PRIORITY_VERY_HIGH;
+    dma_init_struct.loop_mode_enable = FALSE;
+    dma_init(ch, &dma_init_struct);
+}
+
+void SW_I2C_WAVE_IRQHandler(void)
+{
+    BaseType_t woken = pdFALSE;
+
+    /* the last word is on the port; the timer runs on for its sample */
+    if (dma_flag_get(SW_I2C_WAVE_OUT_FLAG) != RESET)
+    {
+        dma_flag_clear(SW_I2C_WAVE_OUT_FLAG);
+        xSemaphoreGiveFromISR(wave_done, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+/**
+ * @brief Enable the timer and DMA clocks and create the engine's semaphores.
+ */
+void SW_I2C_AT32_Wave_Init(void)
+{
+	crm_periph_clock_enable(SW_I2C_WAVE_TMR_CLOCK, TRUE);
+	crm_periph_clock_enable(SW_I2C_WAVE_DMA_CLOCK, TRUE);
+	dmamux_enable(SW_I2C_WAVE_DMA, TRUE);
+	dmamux_init(SW_I2C_WAVE_OUT_MUX, DMAMUX_DMAREQ_ID_TMR1_OVERFLOW);
+	dmamux_init(SW_I2C_WAVE_IN_MUX, DMAMUX_DMAREQ_ID_TMR1_CH1);
+	nvic_irq_enable(SW_I2C_WAVE_OUT_IRQ, SW_I2C_WAVE_IRQ_PRIO, 0);
+
+	if (wave_lock == NULL)
+		wave_lock = xSemaphoreCreateMutex();
+	if (wave_done == NULL)
+		wave_done = xSemaphoreCreateBinary();
+}
+
+/**
+ * @brief Play a compiled waveform with TMR1 and DMA1, blocking the caller.
+ *
+ * One engine serves all buses; concurrent callers are serialized.
+ *
+ * @param[in] d Bus the waveform was compiled for.
+ * @param[in,out] w Compiled waveform, in[] is filled.
+ * @return SW_I2C_OK, or SW_I2C_ERR_LOCK_TIMEOUT if the engine is missing or did not finish.
+ */
+sw_i2c_status_e SW_I2C_AT32_Wave_Run(sw_i2c_t *d, sw_i2c_wave_t *w)
+{
+	uint32_t period = (uint32_t)(((uint64_t)SW_I2C_WAVE_TMR_HZ * w->tick_ns) / 1000000000ULL);
+	TickType_t timeout = pdMS_TO_TICKS((uint64_t)w->len * w->tick_ns / 1000000ULL) + 2;
+	sw_i2c_status_e st = SW_I2C_OK;
+	uint32_t spin;
+
+	if (wave_lock == NULL || xSemaphoreTake(wave_lock, portMAX_DELAY) != pdTRUE)
+		return SW_I2C_ERR_LOCK_TIMEOUT;
+
+	wave_dma_channel(SW_I2C_WAVE_OUT_CH, TRUE, d->fast.scl_set, w->out, w->len);
+	wave_dma_channel(SW_I2C_WAVE_IN_CH, FALSE, d->fast.sda_in, w->in, w->len);
+	dma_interrupt_enable(SW_I2C_WAVE_OUT_CH, DMA_FDT_INT, TRUE);
+
+	tmr_base_init(SW_I2C_WAVE_TMR, period - 1, 0);
+	tmr_cnt_dir_set(SW_I2C_WAVE_TMR, TMR_COUNT_UP);
+	tmr_channel_value_set(SW_I2C_WAVE_TMR, TMR_SELECT_CHANNEL_1, SW_I2C_WAVE_SAMPLE_CLK(period));
+	tmr_dma_request_enable(SW_I2C_WAVE_TMR, TMR_OVERFLOW_DMA_REQUEST, TRUE);
+	tmr_dma_request_enable(SW_I2C_WAVE_TMR, TMR_C1_DMA_REQUEST, TRUE);
+
+	dma_channel_enable(SW_I2C_WAVE_OUT_CH, TRUE);
+	dma_channel_enable(SW_I2C_WAVE_IN_CH, TRUE);
+	tmr_event_sw_trigger(SW_I2C_WAVE_TMR, TMR_OVERFLOW_SWTRIG);  // out[0] now, counter from 0
+	tmr_counter_enable(SW_I2C_WAVE_TMR, TRUE);
+
+	if (xSemaphoreTake(wave_done, timeout) != pdTRUE)
+	{
+		logE("waveform of %u ticks did not complete", (unsigned)w->len);
+		st = SW_I2C_ERR_LOCK_TIMEOUT;
+	}
+	else
+	{
+		/* out[len-1] holds for its tick, the compare at its end takes the last sample */
+		for (spin = 2 * period; spin && dma_data_number_get(SW_I2C_WAVE_IN_CH) != 0; spin--)
+			;
+	}
+	tmr_counter_enable(SW_I2C_WAVE_TMR, FALSE);
+	dma_channel_enable(SW_I2C_WAVE_OUT_CH, FALSE);
+	dma_channel_enable(SW_I2C_WAVE_IN_CH, FALSE);
+	tmr_dma_request_enable(SW_I2C_WAVE_TMR, TMR_OVERFLOW_DMA_REQUEST, FALSE);
+	tmr_dma_request_enable(SW_I2C_WAVE_TMR, TMR_C1_DMA_REQUEST, FALSE);
+
+	xSemaphoreGive(wave_lock);
+	return st;
+}
@@ -0,0 +1,354 @@
+/***
+ * Prepared transactions for the soft I2C core: the bit-level work of
+ * address, register and write phases is done once, a replay runs a flat
+ * list of edge ops through the register fast path with no per-bit
+ * decisions, so every replay has the same timing.
+ */
+
+#include "sw_i2c_prog.h"
+#include "sw_i2c_phase.h"
+
+#ifndef TRUE
+	#define TRUE 1
+#endif
+#ifndef FALSE
+	#define FALSE 0
+#endif
+
+/* Ops in the low nibble, the high nibble picks the phase wait after the op */
+#define PROG_END            0
+#define PROG_SCL_LOW        1
+#define PROG_SCL_HIGH       2
+#define PROG_SDA_LOW        3
+#define PROG_SDA_HIGH       4
+#define PROG_NOP            5
+#define PROG_SAMPLE         6   // shift SDA into the read byte
+#define PROG_STORE          7   // append the read byte to rbuf
+#define PROG_MSG            8   // new segment, restarts the NACK index
+#define PROG_ACK_ADDR       9   // sample ACK, jump to STOP on NACK
+#define PROG_ACK_REG        10
+#define PROG_ACK_DATA       11
+#define PROG_OP_MASK        0x0F
+#define PROG_W_LOW          0x10    // tLOW
+#define PROG_W_HIGH         0x20    // tHIGH
+#define PROG_W_SU_STA       0x30
+#define PROG_W_HD_STA       0x40
+#define PROG_W_SU_STO       0x50
+#define PROG_W_BUF          0x60
+
+typedef struct
+{
+    sw_i2c_prog_t * p;
+    uint32_t pc;
+} prog_builder_t;
+
+static void prog_op(prog_builder_t *b, uint8_t op)
+{
+    if (b->pc < b->p->cap)
+        b->p->ops[b->pc] = op;
+    b->pc++;
+}
+
+/* From an idle bus, or repeated right after an ACK clock with SCL low */
+static void prog_start(prog_builder_t *b)
+{
+    prog_op(b, PROG_SDA_HIGH | PROG_W_LOW);
+    prog_op(b, PROG_SCL_HIGH | PROG_W_SU_STA);
+    prog_op(b, PROG_SDA_LOW | PROG_W_HD_STA);
+    prog_op(b, PROG_SCL_LOW);
+}
+
+static void prog_write_byte(prog_builder_t *b, uint8_t data, uint8_t ack_op)
+{
+    for (int x = 7; x >= 0; x--)
+    {
+        prog_op(b, ((data >> x) & 1 ? PROG_SDA_HIGH : PROG_SDA_LOW) | PROG_W_LOW);
+        prog_op(b, PROG_SCL_HIGH | PROG_W_HIGH);
+        prog_op(b, PROG_SCL_LOW);
+    }
+    prog_op(b, PROG_SDA_HIGH | PROG_W_LOW);
+    prog_op(b, PROG_SCL_HIGH | PROG_W_HIGH);
+    prog_op(b, ack_op);
+    prog_op(b, PROG_SCL_LOW);
+}
+
+static void prog_read_byte(prog_builder_t *b, uint8_t ack)
+{
+    for (int x = 7; x >= 0; x--)
+    {
+        prog_op(b, (x == 7 ? PROG_SDA_HIGH : PROG_NOP) | PROG_W_LOW);
+        prog_op(b, PROG_SCL_HIGH | PROG_W_HIGH);
+        prog_op(b, PROG_SAMPLE);
+        prog_op(b, PROG_SCL_LOW);
+    }
+    prog_op(b, PROG_STORE);
+    prog_op(b, (ack ? PROG_SDA_LOW : PROG_SDA_HIGH) | PROG_W_LOW);
+    prog_op(b, PROG_SCL_HIGH | PROG_W_HIGH);
+    prog_op(b, PROG_SCL_LOW);
+}
+
+/* Starts with SCL low so a failed ACK can jump here from the ninth clock */
+static void prog_stop(prog_builder_t *b)
+{
+    prog_op(b, PROG_SCL_LOW);
+    prog_op(b, PROG_SDA_LOW | PROG_W_LOW);
+    prog_op(b, PROG_SCL_HIGH | PROG_W_SU_STO);
+    prog_op(b, PROG_SDA_HIGH | PROG_W_BUF);
+    prog_op(b, PROG_END);
+}
+
+static sw_i2c_status_e prog_check_msgs(const sw_i2c_msg_t *msgs, uint32_t num)
+{
+    if (msgs == NULL || num == 0)
+        return SW_I2C_ERR_PARAM;
+    for (uint32_t i = 0; i < num; i++)
+    {
+        if (msgs[i].flags & (SW_I2C_M_RECV_LEN | SW_I2C_M_PEC))
+            return SW_I2C_ERR_PARAM;    // the count and the PEC are not known when preparing
+        if (msgs[i].flags & SW_I2C_M_RD)
+        {
+            if (msgs[i].len == 0 || (msgs[i].flags & SW_I2C_M_NOSTART))
+                return SW_I2C_ERR_PARAM;
+        }
+        else if (msgs[i].len != 0 && msgs[i].buf == NULL)
+        {
+            return SW_I2C_ERR_PARAM;
+        }
+    }
+    return SW_I2C_OK;
+}
+
+static uint8_t prog_scl_level(sw_i2c_t *d)
+{
+    return (SW_I2C_REG_READ(d->fast.scl_in) & d->fast.scl_mask) ? 1 : 0;
+}
+
+static uint8_t prog_sda_level(sw_i2c_t *d)
+{
+    return (SW_I2C_REG_READ(d->fast.sda_in) & d->fast.sda_mask) ? 1 : 0;
+}
+
+static void prog_wait(sw_i2c_t *d, uint32_t ns)
+{
+    if (ns <= d->wait_trim_ns)
+        return;
+    ns -= d->wait_trim_ns;
+    if (d->hal_delay_ns)
+        d->hal_delay_ns(ns);
+    else
+        d->hal_delay_us((ns + 999) / 1000);
+}
+
+/* Clock stretching as in the core: poll every quarter of a half period, bounded */
+static uint8_t prog_scl_wait_high(sw_i2c_t *d, const sw_i2c_timing_t *tm)
+{
+    uint32_t step, limit, waited = 0;
+
+    if (!(d->flags & SW_I2C_FLAG_CLOCK_STRETCH) || prog_scl_level(d))
+        return TRUE;
+
+    step = (tm->low_ns + tm->high_ns) >> 3;
+    if (step == 0)
+        step = 1;
+    limit = (d->stretch_timeout_us ? d->stretch_timeout_us : SW_I2C_STRETCH_TIMEOUT_US) * 1000UL;
+    while (!prog_scl_level(d))
+    {
+        if (waited >= limit)
+            return FALSE;
+        prog_wait(d, step);
+        waited += step;
+    }
+    return TRUE;
+}
+
+static sw_i2c_status_e prog_run(sw_i2c_t *d, const sw_i2c_prog_t *p, uint8_t *rbuf)
+{
+    sw_i2c_status_e st = SW_I2C_OK;
+    const uint8_t *ops = p->ops;
+    const uint32_t wait[] =
+    {
+        0, p->tm.low_ns, p->tm.high_ns, p->tm.su_sta_ns, p->tm.hd_sta_ns, p->tm.su_sto_ns, p->tm.buf_ns,
+    };
+    uint32_t pc = 0;
+    size_t n = 0, idx = 0;
+    uint8_t acc = 0, op;
+
+    for (;;)
+    {
+        op = ops[pc++];
+        switch (op & PROG_OP_MASK)
+        {
+        case PROG_END:
+            return st;
+        case PROG_SCL_LOW:
+            SW_I2C_REG_WRITE(d->fast.scl_clr, d->fast.scl_mask);
+            break;
+        case PROG_SCL_HIGH:
+            SW_I2C_REG_WRITE(d->fast.scl_set, d->fast.scl_mask);
+            if (!prog_scl_wait_high(d, &p->tm) && st == SW_I2C_OK)
+            {
+                st = SW_I2C_ERR_STRETCH_TIMEOUT;
+                pc = p->stop_pc;
+                continue;
+            }
+            break;
+        case PROG_SDA_LOW:
+            SW_I2C_REG_WRITE(d->fast.sda_clr, d->fast.sda_mask);
+            break;
+        case PROG_SDA_HIGH:
+            SW_I2C_REG_WRITE(d->fast.sda_set, d->fast.sda_mask);
+            break;
+        case PROG_SAMPLE:
+            acc = (acc << 1) | prog_sda_level(d);
+            break;
+        case PROG_STORE:
+            rbuf[n++] = acc;
+            break;
+        case PROG_MSG:
+            idx = 0;
+            break;
+        case PROG_ACK_ADDR:
+        case PROG_ACK_REG:
+        case PROG_ACK_DATA:
+            if (prog_sda_level(d))
+            {
+                st = (op == PROG_ACK_ADDR) ? SW_I2C_ERR_ADDR_NACK :
+                     (op == PROG_ACK_REG) ? SW_I2C_ERR_REG_NACK : SW_I2C_ERR_DATA_NACK;
+                d->nack_index = idx;
+                pc = p->stop_pc;
+                continue;
+            }
+            if (op != PROG_ACK_ADDR)
+                idx++;
+            break;
+        default:
+            break;
+        }
+        if (op & ~PROG_OP_MASK)
+            prog_wait(d, wait[op >> 4]);
+    }
+}
+
+/**
+ * @brief Prepare a transaction for replay.
+ *
+ * Write data is copied into the program; read segments only contribute
+ * their length, the data goes to the buffer given to SW_I2C_Prog_Replay in
+ * segment order. The clock of the first target is fixed at this point,
+ * with the same phase waits as SW_I2C_Transfer at that clock.
+ *
+ * @param[out] p Program with ops/cap set by the caller, see SW_I2C_PROG_OPS.
+ * @param[in] d Bus with the register fast path and SW_I2C_FLAG_OPEN_DRAIN.
+ * @param[in] msgs Array of segments, as for SW_I2C_Transfer.
+ * @param[in] num Number of segments.
+ * @return SW_I2C_OK or SW_I2C_ERR_PARAM.
+ */
+sw_i2c_status_e SW_I2C_Prog_Prepare(sw_i2c_prog_t *p, const sw_i2c_t *d, const sw_i2c_msg_t *msgs, uint32_t num)
+{
+	prog_builder_t b = { .p = p, .pc = 0 };
+
+	if (p == NULL || d == NULL || p->ops == NULL || d->fast.scl_set == NULL)
+		return SW_I2C_ERR_PARAM;
+	if (!(d->flags & SW_I2C_FLAG_OPEN_DRAIN))
+		return SW_I2C_ERR_PARAM;
+	if (prog_check_msgs(msgs, num) != SW_I2C_OK)
+		return SW_I2C_ERR_PARAM;
+
+	p->rlen = 0;
+	for (uint32_t i = 0; i < num; i++)
+	{
+		const sw_i2c_msg_t *m = &msgs[i];
+
+		if (i == 0 || !(m->flags & SW_I2C_M_NOSTART))
+		{
+			prog_start(&b);
+			prog_write_byte(&b, (m->flags & SW_I2C_M_RD) ? (m->IICID | I2C_READ) : (m->IICID & ~I2C_READ), PROG_ACK_ADDR);
+		}
+		prog_op(&b, PROG_MSG);
+		for (size_t j = 0; j < m->len; j++)
+		{
+			if (m->flags & SW_I2C_M_RD)
+				prog_read_byte(&b, j + 1 < m->len);
+			else
+				prog_write_byte(&b, m->buf[j], (m->flags & SW_I2C_M_REG) ? PROG_ACK_REG : PROG_ACK_DATA);
+		}
+		if (m->flags & SW_I2C_M_RD)
+			p->rlen += m->len;
+	}
+	p->stop_pc = b.pc;
+	prog_stop(&b);
+	if (b.pc > p->cap)
+		return SW_I2C_ERR_PARAM;
+
+	p->len = b.pc;
+	p->tm = sw_i2c_spec_timing(SW_I2C_Target_Clock(d, msgs[0].IICID), d->rise_ns);
+	return SW_I2C_OK;
+}
+
+/**
+ * @brief Prepare the equivalent of SW_I2C_Read_Mem.
+ *
+ * @param[out] p Program with ops/cap set by the caller.
+ * @param[in] d Bus with the register fast path.
+ * @param[in] IICID 8-bit target address.
+ * @param[in] regaddr Register address.
+ * @param[in] alen Register address bytes, 0..2.
+ * @param[in] rcnt Bytes to read, at least 1.
+ * @return SW_I2C_OK or SW_I2C_ERR_PARAM.
+ */
+sw_i2c_status_e SW_I2C_Prog_Prepare_Reg_Read(sw_i2c_prog_t *p, const sw_i2c_t *d, uint8_t IICID, uint16_t regaddr, uint8_t alen, size_t rcnt)
+{
+	uint8_t reg[2] = { (uint8_t)(regaddr >> 8), (uint8_t)regaddr };
+	sw_i2c_msg_t msgs[2] =
+	{
+		{ .IICID = IICID, .flags = SW_I2C_M_REG, .len = alen, .buf = &reg[2 - alen] },
+		{ .IICID = IICID, .flags = SW_I2C_M_RD, .len = rcnt, .buf = NULL },
+	};
+
+	if (alen > 2)
+		return SW_I2C_ERR_PARAM;
+	if (alen == 0)
+		return SW_I2C_Prog_Prepare(p, d, &msgs[1], 1);
+	return SW_I2C_Prog_Prepare(p, d, msgs, 2);
+}
+
+/**
+ * @brief Run a prepared transaction.
+ *
+ * Fails fast like SW_I2C_Transfer: a NACK jumps to STOP. Bus recovery runs
+ * as in the core, on lines found low and after a stretch timeout, unless
+ * SW_I2C_FLAG_NO_RECOVERY is set. Replays are not counted in d->stats and
+ * not recorded by the trace: the program keeps no segments to describe,
+ * and the per-transaction bookkeeping would cost a fixed poll more than
+ * the edges it saves.
+ *
+ * @param[in] d Pointer to the I2C instance the program was prepared for.
+ * @param[in] p Prepared program.
+ * @param[out] rbuf Receives p->rlen bytes, may be NULL if there are none.
+ * @return SW_I2C_OK or the reason of the failure, also kept for SW_I2C_Last_Status.
+ */
+sw_i2c_status_e SW_I2C_Prog_Replay(sw_i2c_t *d, const sw_i2c_prog_t *p, uint8_t *rbuf)
+{
+	sw_i2c_status_e st;
+	uint8_t recover;
+
+	if (d == NULL || p == NULL || p->len == 0 || (p->rlen && rbuf == NULL))
+		return SW_I2C_ERR_PARAM;
+
+	st = SW_I2C_Lock(d);
+	if (st != SW_I2C_OK)
+		return st;
+	recover = !(d->flags & SW_I2C_FLAG_NO_RECOVERY);
+	d->nack_index = 0;
+	d->stretch_fault = FALSE;
+	if ((!prog_scl_level(d) || !prog_sda_level(d))
+		&& (!recover || SW_I2C_Recover_Locked(d) != SW_I2C_OK))
+		st = SW_I2C_ERR_BUS_BUSY;
+	else
+		st = prog_run(d, p, rbuf);
+	if (st == SW_I2C_ERR_STRETCH_TIMEOUT && recover)
+		SW_I2C_Recover_Locked(d);       // a target gave up mid-byte, free the bus for the next caller
+	d->status = st;
+	SW_I2C_Unlock(d);
+	return st;
+}
@@ -0,0 +1,30 @@
+#ifndef _SW_I2C_PROG_H_
+#define _SW_I2C_PROG_H_
+
+#include "sw_i2c.h"
+
+/* Program size in ops for 'bytes' payload bytes in 'segments' segments */
+#define SW_I2C_PROG_OPS(bytes, segments) \
+    (((bytes) + (segments)) * 36 + (segments) * 5 + 6)
+
+/**
+ * Transaction prepared once and replayed many times, e.g. a sensor poll.
+ * Address and write bytes are baked into a list of one-byte edge ops; a
+ * replay only executes the edges, samples and ACK checks, and stores the
+ * read bytes. The op buffer belongs to the caller.
+ */
+typedef struct
+{
+    uint8_t * ops;
+    uint32_t cap;           // size of ops
+    uint32_t len;           // ops used
+    uint32_t stop_pc;       // STOP sequence, target of a failed ACK
+    size_t rlen;            // bytes a replay stores
+    sw_i2c_timing_t tm;     // phase waits when prepared
+} sw_i2c_prog_t;
+
+sw_i2c_status_e SW_I2C_Prog_Prepare(sw_i2c_prog_t *p, const sw_i2c_t *d, const sw_i2c_msg_t *msgs, uint32_t num);
+sw_i2c_status_e SW_I2C_Prog_Prepare_Reg_Read(sw_i2c_prog_t *p, const sw_i2c_t *d, uint8_t IICID, uint16_t regaddr, uint8_t alen, size_t rcnt);
+sw_i2c_status_e SW_I2C_Prog_Replay(sw_i2c_t *d, const sw_i2c_prog_t *p, uint8_t *rbuf);
+
+#endif /* _SW_I2C_PROG_H_ */
@@ -0,0 +1,345 @@
+/***
+ * Interrupt-driven soft I2C target.
+ *
+ * Every SCL or SDA edge raises an interrupt whose handler passes the pending
+ * pin mask to SW_I2C_Slave_Irq. The handler compares both line levels with
+ * the ones seen last time and steps a bit-level state machine: SDA moving
+ * with SCL high is START or STOP, SCL rising samples SDA, SCL falling is
+ * where the target drives SDA for ACKs and read data. Nothing is copied:
+ * received bytes land in the register map and read bytes are taken from it.
+ */
+
+#include "sw_i2c_slave.h"
+
+#define TAG "SW_I2C"
+#include "log.h"
+
+#ifndef TRUE
+	#define TRUE 1
+#endif
+#ifndef FALSE
+	#define FALSE 0
+#endif
+
+enum
+{
+    SLAVE_ST_IDLE = 0,      // bus free
+    SLAVE_ST_ADDR,          // shifting in the address byte
+    SLAVE_ST_RX,            // shifting in a pointer or data byte
+    SLAVE_ST_ACK_WAIT,      // byte complete, ACK decided, SCL still high
+    SLAVE_ST_ACK,           // driving the ACK clock
+    SLAVE_ST_TX,            // shifting out a data byte
+    SLAVE_ST_TX_ACK,        // host answers the ninth clock
+    SLAVE_ST_IGNORE,        // not for us or lost, wait for START/STOP
+};
+
+static inline uint8_t slave_scl(sw_i2c_t *d)
+{
+    if (d->fast.scl_in)
+        return (SW_I2C_REG_READ(d->fast.scl_in) & d->fast.scl_mask) != 0;
+    return d->hal_io_ctl(HAL_IO_OPT_GET_SCL_LEVEL, d) ? 1 : 0;
+}
+
+static inline uint8_t slave_sda(sw_i2c_t *d)
+{
+    if (d->fast.sda_in)
+        return (SW_I2C_REG_READ(d->fast.sda_in) & d->fast.sda_mask) != 0;
+    return d->hal_io_ctl(HAL_IO_OPT_GET_SDA_LEVEL, d) ? 1 : 0;
+}
+
+/* Drive SDA low or release it; a release reads back what the host drives */
+static void slave_drive(sw_i2c_slave_t *s, uint8_t level)
+{
+    sw_i2c_t *d = s->d;
+
+    if (d->fast.sda_set)
+        SW_I2C_REG_WRITE(level ? d->fast.sda_set : d->fast.sda_clr, d->fast.sda_mask);
+    else
+        d->hal_io_ctl(level ? HAL_IO_OPT_SET_SDA_HIGH : HAL_IO_OPT_SET_SDA_LOW, d);
+    s->sda = level ? slave_sda(d) : 0;
+}
+
+static inline uint16_t slave_next(const sw_i2c_slave_t *s, uint16_t r)
+{
+    return r + 1 < s->size ? r + 1 : 0;
+}
+
+static void slave_tx_load(sw_i2c_slave_t *s)
+{
+    s->shift = s->regs[s->ptr];
+    s->ptr = slave_next(s, s->ptr);
+    s->rd_len++;
+    s->bit = 0;
+    s->state = SLAVE_ST_TX;
+    slave_drive(s, s->shift >> 7);
+}
+
+/* Pointer byte or register data received: store it and pick the answer */
+static uint8_t slave_rx(sw_i2c_slave_t *s, uint8_t b)
+{
+    if (s->got < s->alen)
+    {
+        s->ptr = s->got ? (uint16_t)((s->ptr << 8) | b) : b;
+        if (++s->got == s->alen && s->ptr >= s->size)
+            s->ptr %= s->size;
+        return TRUE;
+    }
+    if (s->status != SW_I2C_OK)
+        return FALSE;               // refused until the overrun is cleared
+    if (s->wr_mask && !(s->wr_mask[s->ptr >> 3] & (1 << (s->ptr & 7))))
+    {
+        s->nacks++;
+        return FALSE;
+    }
+    s->regs[s->ptr] = b;
+    if (s->wr_len++ == 0)
+        s->wr_reg = s->ptr;
+    s->ptr = slave_next(s, s->ptr);
+    return TRUE;
+}
+
+static void slave_start(sw_i2c_slave_t *s)
+{
+    if (!s->addressed)
+    {
+        s->wr_len = 0;
+        s->rd_len = 0;
+    }
+    s->state = SLAVE_ST_ADDR;
+    s->bit = 0;
+    s->shift = 0;
+}
+
+static void slave_stop(sw_i2c_slave_t *s)
+{
+    s->state = SLAVE_ST_IDLE;
+    if (!s->addressed)
+        return;
+    s->addressed = FALSE;
+    s->xfers++;
+    if (s->on_stop)
+        s->on_stop(s);
+}
+
+static void slave_overrun(sw_i2c_slave_t *s)
+{
+    s->overruns++;
+    s->status = SW_I2C_ERR_OVERRUN;
+    if (s->state == SLAVE_ST_ACK || s->state == SLAVE_ST_TX)
+        slave_drive(s, 1);
+    s->state = SLAVE_ST_IGNORE;
+}
+
+static void slave_scl_rise(sw_i2c_slave_t *s, uint8_t sda)
+{
+    switch (s->state)
+    {
+    case SLAVE_ST_ADDR:
+    case SLAVE_ST_RX:
+        s->shift = (uint8_t)((s->shift << 1) | sda);
+        if (++s->bit < 8)
+            break;
+        if (s->state == SLAVE_ST_RX)
+        {
+            s->ack = slave_rx(s, s->shift);
+        }
+        else if ((s->shift ^ s->IICID) & ~I2C_READ)
+        {
+            s->state = SLAVE_ST_IGNORE;
+            break;
+        }
+        else
+        {
+            s->rw = s->shift & I2C_READ;
+            s->addressed = TRUE;
+            if (!s->rw)
+                s->got = 0;
+            if (s->on_start)
+                s->on_start(s, s->rw);
+            s->ack = TRUE;
+        }
+        s->state = SLAVE_ST_ACK_WAIT;
+        break;
+    case SLAVE_ST_TX_ACK:
+        s->ack = !sda;
+        break;
+    default:
+        break;
+    }
+}
+
+static void slave_scl_fall(sw_i2c_slave_t *s)
+{
+    switch (s->state)
+    {
+    case SLAVE_ST_ACK_WAIT:
+        if (s->ack)
+        {
+            slave_drive(s, 0);
+            s->state = SLAVE_ST_ACK;
+        }
+        else
+        {
+            s->state = SLAVE_ST_IGNORE;
+        }
+        break;
+    case SLAVE_ST_ACK:
+        if (s->rw)
+        {
+            slave_tx_load(s);
+            break;
+        }
+        slave_drive(s, 1);
+        s->state = SLAVE_ST_RX;
+        s->bit = 0;
+        s->shift = 0;
+        break;
+    case SLAVE_ST_TX:
+        if (++s->bit < 8)
+        {
+            slave_drive(s, (s->shift >> (7 - s->bit)) & 1);
+            break;
+        }
+        slave_drive(s, 1);
+        s->state = SLAVE_ST_TX_ACK;
+        break;
+    case SLAVE_ST_TX_ACK:
+        if (s->ack)
+            slave_tx_load(s);
+        else
+            s->state = SLAVE_ST_IGNORE;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Attach the target to its lines and enable the edge interrupts.
+ *
+ * @param[in] s Target with d, IICID, alen, regs and size filled in.
+ * @return SW_I2C_OK, or SW_I2C_ERR_PARAM for a bad map or a port without
+ *         hal_edge_irq.
+ */
+sw_i2c_status_e SW_I2C_Slave_Init(sw_i2c_slave_t *s)
+{
+    sw_i2c_t *d;
+
+    if (s == NULL || s->d == NULL || s->regs == NULL || s->size == 0 || s->alen < 1 || s->alen > 2)
+        return SW_I2C_ERR_PARAM;
+    d = s->d;
+    if (d->hal_edge_irq == NULL)
+    {
+        logE("no edge interrupts on port %p", (void *)d->scl_port);
+        return SW_I2C_ERR_PARAM;
+    }
+    d->hal_init(d);
+    d->hal_io_ctl(HAL_IO_OPT_SET_SCL_HIGH, d);
+    d->hal_io_ctl(HAL_IO_OPT_SET_SDA_HIGH, d);
+    s->ptr = 0;
+    s->got = 0;
+    s->addressed = FALSE;
+    s->status = SW_I2C_OK;
+    s->scl = slave_scl(d);
+    s->sda = slave_sda(d);
+    s->state = (s->scl && s->sda) ? SLAVE_ST_IDLE : SLAVE_ST_IGNORE;
+    d->hal_edge_irq(d, TRUE);
+    return SW_I2C_OK;
+}
+
+/**
+ * @brief Disable the edge interrupts and release the lines.
+ *
+ * @param[in] s Target.
+ */
+void SW_I2C_Slave_Deinit(sw_i2c_slave_t *s)
+{
+    if (s == NULL || s->d == NULL || s->d->hal_edge_irq == NULL)
+        return;
+    s->d->hal_edge_irq(s->d, FALSE);
+    slave_drive(s, 1);
+    s->state = SLAVE_ST_IDLE;
+    s->addressed = FALSE;
+}
+
+/**
+ * @brief Edge interrupt handler, called with the pending flags cleared.
+ *
+ * Levels are read once and compared with the previous call. When both
+ * lines moved, SCL rising is taken as data set up before it, and SCL
+ * falling as a START (bus idle) or the next bit's data. A flag set without
+ * a level change means two edges were merged: a pair of SDA edges with SCL
+ * high is STOP+START or START+STOP, a lost SCL pulse is an overrun.
+ *
+ * @param[in] s Target.
+ * @param[in] pending Pending edge flags as pin masks; scl_pin/sda_pin bits
+ *            are used (EXINT line n is GPIO_PINS_n on AT32).
+ */
+void SW_I2C_Slave_Irq(sw_i2c_slave_t *s, uint32_t pending)
+{
+    sw_i2c_t *d = s->d;
+    uint8_t scl = slave_scl(d), sda = slave_sda(d);
+    uint8_t was_sda = s->sda;
+
+    if (scl == s->scl)
+    {
+        s->sda = sda;
+        if (pending & d->scl_pin)
+        {
+            slave_overrun(s);
+        }
+        else if (scl && sda != was_sda)
+        {
+            if (sda)
+                slave_stop(s);
+            else
+                slave_start(s);
+        }
+        else if (scl && (pending & d->sda_pin))
+        {
+            if (sda)
+            {
+                slave_start(s);
+                slave_stop(s);
+            }
+            else
+            {
+                slave_stop(s);
+                slave_start(s);
+            }
+        }
+        return;
+    }
+
+    s->scl = scl;
+    s->sda = sda;
+    if (scl)
+    {
+        slave_scl_rise(s, sda);
+        return;
+    }
+    if (!sda && was_sda && s->state == SLAVE_ST_IDLE)
+        slave_start(s);
+    slave_scl_fall(s);
+}
+
+/**
+ * @brief Take the latched status and accept register writes again.
+ *
+ * Call from the application once it has dealt with a possibly incomplete
+ * write, e.g. after checking or reloading the register map.
+ *
+ * @param[in] s Target.
+ * @return SW_I2C_OK, SW_I2C_ERR_OVERRUN if an edge was lost since the last
+ *         call, or SW_I2C_ERR_PARAM.
+ */
+sw_i2c_status_e SW_I2C_Slave_Clear_Status(sw_i2c_slave_t *s)
+{
+    sw_i2c_status_e st;
+
+    if (s == NULL)
+        return SW_I2C_ERR_PARAM;
+    st = s->status;
+    s->status = SW_I2C_OK;
+    return st;
+}
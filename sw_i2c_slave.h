@@ -0,0 +1,70 @@
+#ifndef _SW_I2C_SLAVE_H_
+#define _SW_I2C_SLAVE_H_
+
+#include "sw_i2c.h"
+
+typedef struct sw_i2c_slave_s sw_i2c_slave_t;
+
+/**
+ * Soft I2C target on the pins of a sw_i2c_t, run from both-edge interrupts
+ * on SCL and SDA (sw_i2c_t.hal_edge_irq). The host reads and writes regs in
+ * place: the first alen bytes of a write set the register pointer, further
+ * bytes are stored from there on, reads return bytes from the pointer on;
+ * the pointer wraps at size. A write to a register cleared in wr_mask is
+ * NACKed and dropped.
+ *
+ * The interrupt must see every edge: its latency plus run time has to stay
+ * below the shortest phase of the host's clock (tHD;STA, tLOW). In the
+ * simulator (sw_i2c_bench target, 60 ns handler + 35 ns per HAL call) a
+ * 16-byte write and read-back works at 100 kHz at every latency tried
+ * (up to 1.6 us), at 400 kHz up to 400 ns and at 1 MHz up to 200 ns; it
+ * fails at 400 kHz from 800 ns and at 1 MHz from 400 ns.
+ *
+ * An edge the interrupt loses drops the transaction until the next START or
+ * STOP, counts in overruns and latches status to SW_I2C_ERR_OVERRUN. While
+ * it is latched, register data writes are NACKed and not stored (pointer
+ * bytes and reads still work), so a host sees SW_I2C_ERR_DATA_NACK instead
+ * of a map written from misaligned bits; SW_I2C_Slave_Clear_Status
+ * accepts writes again. Callbacks run in the interrupt.
+ */
+struct sw_i2c_slave_s
+{
+    sw_i2c_t * d;                   // lines and HAL, SDA/SCL as open-drain outputs
+    uint8_t IICID;                  // own 8-bit address, R/W bit ignored
+    uint8_t alen;                   // register pointer bytes, 1 or 2
+    uint8_t * regs;                 // register map, read and written in place
+    uint16_t size;
+    const uint8_t * wr_mask;        // bit (r & 7) of wr_mask[r >> 3]: register r writable, NULL = all
+    void (*on_start)(sw_i2c_slave_t *s, uint8_t rw); // own address matched, before the first data byte
+    void (*on_stop)(sw_i2c_slave_t *s);              // STOP closed a transaction addressed to us
+    void * arg;
+
+    /* last transaction, valid in on_stop */
+    uint16_t ptr;                   // register pointer
+    uint16_t wr_reg;                // first register written
+    uint16_t wr_len;                // registers written, 0 = none
+    uint16_t rd_len;                // bytes read by the host
+    sw_i2c_status_e status;         // SW_I2C_OK or SW_I2C_ERR_OVERRUN, latched
+
+    /* counters */
+    uint32_t xfers;                 // transactions addressed to us
+    uint32_t nacks;                 // writes to read-only registers
+    uint32_t overruns;              // edges lost to interrupt latency
+
+    /* interrupt state */
+    uint8_t state;
+    uint8_t bit;
+    uint8_t shift;
+    uint8_t rw;
+    uint8_t ack;
+    uint8_t got;                    // register pointer bytes received
+    uint8_t addressed;
+    uint8_t scl, sda;               // levels seen by the last interrupt
+};
+
+sw_i2c_status_e SW_I2C_Slave_Init(sw_i2c_slave_t *s);
+void SW_I2C_Slave_Deinit(sw_i2c_slave_t *s);
+void SW_I2C_Slave_Irq(sw_i2c_slave_t *s, uint32_t pending);
+sw_i2c_status_e SW_I2C_Slave_Clear_Status(sw_i2c_slave_t *s);
+
+#endif /* _SW_I2C_SLAVE_H_ */
@@ -0,0 +1,213 @@
+/***
+ * SMBus protocols on top of the soft I2C core. Each one is a single
+ * SW_I2C_Transfer; the PEC and the block count are handled by the core
+ * while the bytes are on the wire (SW_I2C_M_PEC, SW_I2C_M_RECV_LEN).
+ */
+
+#include <string.h>
+#include "sw_i2c_smbus.h"
+
+/* PEC on the last segment covers the whole transaction */
+static sw_i2c_status_e smbus_xfer(const sw_i2c_smbus_t *s, sw_i2c_msg_t *msgs, uint32_t num)
+{
+    if (s == NULL || s->bus == NULL)
+        return SW_I2C_ERR_PARAM;
+    if (s->pec)
+        msgs[num - 1].flags |= SW_I2C_M_PEC;
+    return SW_I2C_Transfer(s->bus, msgs, num);
+}
+
+/* Command byte, then a read of len bytes after a repeated START */
+static sw_i2c_status_e smbus_read(const sw_i2c_smbus_t *s, uint8_t cmd, uint8_t *pdata, size_t len)
+{
+    sw_i2c_msg_t msgs[] =
+    {
+        { .IICID = s ? s->IICID : 0, .flags = SW_I2C_M_REG, .len = 1, .buf = &cmd },
+        { .IICID = s ? s->IICID : 0, .flags = SW_I2C_M_RD, .len = len, .buf = pdata },
+    };
+
+    return smbus_xfer(s, msgs, 2);
+}
+
+static sw_i2c_status_e smbus_write(const sw_i2c_smbus_t *s, uint8_t *pdata, size_t len)
+{
+    sw_i2c_msg_t msg = { .IICID = s ? s->IICID : 0, .flags = 0, .len = len, .buf = pdata };
+
+    return smbus_xfer(s, &msg, 1);
+}
+
+/**
+ * @brief Send Byte: one data byte without a command.
+ *
+ * @param[in] s SMBus device.
+ * @param[in] data Byte to send.
+ * @return SW_I2C_OK or the reason of the failure.
+ */
+sw_i2c_status_e SW_I2C_SMBus_Send_Byte(const sw_i2c_smbus_t *s, uint8_t data)
+{
+    return smbus_write(s, &data, 1);
+}
+
+/**
+ * @brief Receive Byte: one data byte without a command.
+ *
+ * @param[in] s SMBus device.
+ * @param[out] data Received byte.
+ * @return SW_I2C_OK or the reason of the failure.
+ */
+sw_i2c_status_e SW_I2C_SMBus_Receive_Byte(const sw_i2c_smbus_t *s, uint8_t *data)
+{
+    sw_i2c_msg_t msg = { .IICID = s ? s->IICID : 0, .flags = SW_I2C_M_RD, .len = 1, .buf = data };
+
+    return smbus_xfer(s, &msg, 1);
+}
+
+/**
+ * @brief Write Byte: command and one data byte.
+ *
+ * @param[in] s SMBus device.
+ * @param[in] cmd Command code.
+ * @param[in] data Byte to write.
+ * @return SW_I2C_OK or the reason of the failure.
+ */
+sw_i2c_status_e SW_I2C_SMBus_Write_Byte(const sw_i2c_smbus_t *s, uint8_t cmd, uint8_t data)
+{
+    uint8_t buf[2] = { cmd, data };
+
+    return smbus_write(s, buf, sizeof(buf));
+}
+
+/**
+ * @brief Read Byte: command, then one data byte.
+ *
+ * @param[in] s SMBus device.
+ * @param[in] cmd Command code.
+ * @param[out] data Received byte.
+ * @return SW_I2C_OK or the reason of the failure.
+ */
+sw_i2c_status_e SW_I2C_SMBus_Read_Byte(const sw_i2c_smbus_t *s, uint8_t cmd, uint8_t *data)
+{
+    return smbus_read(s, cmd, data, 1);
+}
+
+/**
+ * @brief Write Word: command and two data bytes, low byte first.
+ *
+ * @param[in] s SMBus device.
+ * @param[in] cmd Command code.
+ * @param[in] data Word to write.
+ * @return SW_I2C_OK or the reason of the failure.
+ */
+sw_i2c_status_e SW_I2C_SMBus_Write_Word(const sw_i2c_smbus_t *s, uint8_t cmd, uint16_t data)
+{
+    uint8_t buf[3] = { cmd, (uint8_t)data, (uint8_t)(data >> 8) };
+
+    return smbus_write(s, buf, sizeof(buf));
+}
+
+/**
+ * @brief Read Word: command, then two data bytes, low byte first.
+ *
+ * @param[in] s SMBus device.
+ * @param[in] cmd Command code.
+ * @param[out] data Received word.
+ * @return SW_I2C_OK or the reason of the failure.
+ */
+sw_i2c_status_e SW_I2C_SMBus_Read_Word(const sw_i2c_smbus_t *s, uint8_t cmd, uint16_t *data)
+{
+    uint8_t buf[2];
+    sw_i2c_status_e st;
+
+    if (data == NULL)
+        return SW_I2C_ERR_PARAM;
+    st = smbus_read(s, cmd, buf, sizeof(buf));
+    if (st == SW_I2C_OK)
+        *data = buf[0] | (buf[1] << 8);
+    return st;
+}
+
+/**
+ * @brief Process Call: write a word and read the reply word in one
+ * transaction joined by a repeated START.
+ *
+ * @param[in] s SMBus device.
+ * @param[in] cmd Command code.
+ * @param[in] data Word to write.
+ * @param[out] reply Received word.
+ * @return SW_I2C_OK or the reason of the failure.
+ */
+sw_i2c_status_e SW_I2C_SMBus_Process_Call(const sw_i2c_smbus_t *s, uint8_t cmd, uint16_t data, uint16_t *reply)
+{
+    uint8_t out[3] = { cmd, (uint8_t)data, (uint8_t)(data >> 8) }, in[2];
+    sw_i2c_msg_t msgs[] =
+    {
+        { .IICID = s ? s->IICID : 0, .flags = SW_I2C_M_REG, .len = 3, .buf = out },
+        { .IICID = s ? s->IICID : 0, .flags = SW_I2C_M_RD, .len = 2, .buf = in },
+    };
+    sw_i2c_status_e st;
+
+    if (reply == NULL)
+        return SW_I2C_ERR_PARAM;
+    st = smbus_xfer(s, msgs, 2);
+    if (st == SW_I2C_OK)
+        *reply = in[0] | (in[1] << 8);
+    return st;
+}
+
+/**
+ * @brief Block Write: command, byte count and the data.
+ *
+ * The data goes out from the caller's buffer as a continuation of the
+ * command segment, without a copy.
+ *
+ * @param[in] s SMBus device.
+ * @param[in] cmd Command code.
+ * @param[in] pdata Data.
+ * @param[in] cnt 1..SW_I2C_SMBUS_BLOCK_MAX bytes.
+ * @return SW_I2C_OK or the reason of the failure.
+ */
+sw_i2c_status_e SW_I2C_SMBus_Write_Block(const sw_i2c_smbus_t *s, uint8_t cmd, const uint8_t *pdata, uint8_t cnt)
+{
+    uint8_t hdr[2] = { cmd, cnt };
+    sw_i2c_msg_t msgs[] =
+    {
+        { .IICID = s ? s->IICID : 0, .flags = SW_I2C_M_REG, .len = 2, .buf = hdr },
+        { .IICID = s ? s->IICID : 0, .flags = SW_I2C_M_NOSTART, .len = cnt, .buf = (uint8_t *)pdata },
+    };
+
+    if (pdata == NULL || cnt == 0 || cnt > SW_I2C_SMBUS_BLOCK_MAX)
+        return SW_I2C_ERR_PARAM;
+    return smbus_xfer(s, msgs, 2);
+}
+
+/**
+ * @brief Block Read: command, then the device's byte count and that many
+ * bytes.
+ *
+ * @param[in] s SMBus device.
+ * @param[in] cmd Command code.
+ * @param[out] pdata Room for SW_I2C_SMBUS_BLOCK_MAX bytes.
+ * @param[out] cnt Bytes received.
+ * @return SW_I2C_OK, SW_I2C_ERR_PROTOCOL for a count of 0 or above
+ *         SW_I2C_SMBUS_BLOCK_MAX, or another reason of the failure.
+ */
+sw_i2c_status_e SW_I2C_SMBus_Read_Block(const sw_i2c_smbus_t *s, uint8_t cmd, uint8_t *pdata, uint8_t *cnt)
+{
+    uint8_t buf[1 + SW_I2C_SMBUS_BLOCK_MAX];
+    sw_i2c_msg_t msgs[] =
+    {
+        { .IICID = s ? s->IICID : 0, .flags = SW_I2C_M_REG, .len = 1, .buf = &cmd },
+        { .IICID = s ? s->IICID : 0, .flags = SW_I2C_M_RD | SW_I2C_M_RECV_LEN, .len = sizeof(buf), .buf = buf },
+    };
+    sw_i2c_status_e st;
+
+    if (pdata == NULL || cnt == NULL)
+        return SW_I2C_ERR_PARAM;
+    st = smbus_xfer(s, msgs, 2);
+    if (st == SW_I2C_OK)
+    {
+        *cnt = buf[0];
+        memcpy(pdata, &buf[1], buf[0]);
+    }
+    return st;
+}
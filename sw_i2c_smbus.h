@@ -0,0 +1,31 @@
+#ifndef _SW_I2C_SMBUS_H_
+#define _SW_I2C_SMBUS_H_
+
+#include "sw_i2c.h"
+
+#define SW_I2C_SMBUS_BLOCK_MAX  32  // bytes in a block transfer (SMBus 2.0)
+
+/**
+ * SMBus device on a soft I2C bus. With pec set every transfer carries a
+ * Packet Error Code: appended to writes, read and checked after reads
+ * (SW_I2C_ERR_PEC). The core folds each byte into the PEC while it is
+ * shifted, see SW_I2C_M_PEC. Words are sent low byte first.
+ */
+typedef struct
+{
+    sw_i2c_t * bus;
+    uint8_t IICID;              // 8-bit address
+    uint8_t pec;
+} sw_i2c_smbus_t;
+
+sw_i2c_status_e SW_I2C_SMBus_Send_Byte(const sw_i2c_smbus_t *s, uint8_t data);
+sw_i2c_status_e SW_I2C_SMBus_Receive_Byte(const sw_i2c_smbus_t *s, uint8_t *data);
+sw_i2c_status_e SW_I2C_SMBus_Write_Byte(const sw_i2c_smbus_t *s, uint8_t cmd, uint8_t data);
+sw_i2c_status_e SW_I2C_SMBus_Read_Byte(const sw_i2c_smbus_t *s, uint8_t cmd, uint8_t *data);
+sw_i2c_status_e SW_I2C_SMBus_Write_Word(const sw_i2c_smbus_t *s, uint8_t cmd, uint16_t data);
+sw_i2c_status_e SW_I2C_SMBus_Read_Word(const sw_i2c_smbus_t *s, uint8_t cmd, uint16_t *data);
+sw_i2c_status_e SW_I2C_SMBus_Process_Call(const sw_i2c_smbus_t *s, uint8_t cmd, uint16_t data, uint16_t *reply);
+sw_i2c_status_e SW_I2C_SMBus_Write_Block(const sw_i2c_smbus_t *s, uint8_t cmd, const uint8_t *pdata, uint8_t cnt);
+sw_i2c_status_e SW_I2C_SMBus_Read_Block(const sw_i2c_smbus_t *s, uint8_t cmd, uint8_t *pdata, uint8_t *cnt);
+
+#endif /* _SW_I2C_SMBUS_H_ */
@@ -0,0 +1,165 @@
+/***
+ * Transaction trace for soft I2C buses.
+ *
+ * The core hands every finished transaction to SW_I2C_Trace_Record, which
+ * claims a ring slot with one atomic add and copies a 32-byte summary: no
+ * lock, no loop over the payload. A task drains the ring with
+ * SW_I2C_Trace_Read, or the whole rec array is dumped from a debugger; the
+ * host tool sim/sw_i2c_trace2vcd turns either into VCD or sigrok I2C
+ * annotations.
+ */
+
+#include <string.h>
+#include "sw_i2c_trace.h"
+
+#if !SW_I2C_TRACE
+#error "sw_i2c_trace.c needs SW_I2C_TRACE=1"
+#endif
+
+/**
+ * @brief Prepare a ring.
+ *
+ * @param[out] t Ring.
+ * @param[in] rec Record storage.
+ * @param[in] cnt Number of records, a power of two.
+ * @return SW_I2C_OK or SW_I2C_ERR_PARAM.
+ */
+sw_i2c_status_e SW_I2C_Trace_Init(sw_i2c_trace_t *t, sw_i2c_trace_rec_t *rec, uint32_t cnt)
+{
+	if (t == NULL || rec == NULL || cnt == 0 || (cnt & (cnt - 1)))
+		return SW_I2C_ERR_PARAM;
+	memset(rec, 0, cnt * sizeof(*rec));
+	t->rec = rec;
+	t->cnt = cnt;
+	t->head = 0;
+	t->tail = 0;
+	t->lost = 0;
+	return SW_I2C_OK;
+}
+
+/**
+ * @brief Start or stop recording the transactions of a bus.
+ *
+ * @param[in] d Pointer to the I2C instance.
+ * @param[in] t Ring, NULL stops recording.
+ * @param[in] bus Bus number stored in the records.
+ */
+void SW_I2C_Trace_Attach(sw_i2c_t *d, sw_i2c_trace_t *t, uint8_t bus)
+{
+	if (d == NULL)
+		return;
+	d->trace_bus = bus;
+	d->trace = t;
+}
+
+/**
+ * @brief Store one finished transaction. Called by the core.
+ *
+ * Safe from several buses at once; a slot is only shared when the ring
+ * wraps around during a single record.
+ *
+ * @param[in] t Ring.
+ * @param[in] d Bus, its trace_* fields hold the wire bytes.
+ * @param[in] msgs Segments of the transaction.
+ * @param[in] num Number of segments.
+ * @param[in] st Result.
+ * @param[in] stamp hal_cycles at START.
+ * @param[in] duration hal_cycles from START to STOP.
+ */
+void SW_I2C_Trace_Record(sw_i2c_trace_t *t, const sw_i2c_t *d, const sw_i2c_msg_t *msgs, uint32_t num,
+                         sw_i2c_status_e st, uint32_t stamp, uint32_t duration)
+{
+	uint32_t idx = __atomic_fetch_add(&t->head, 1, __ATOMIC_RELAXED);
+	sw_i2c_trace_rec_t *r = &t->rec[idx & (t->cnt - 1)];
+	uint8_t flags = 0;
+	uint16_t len = 0;
+
+	for (uint32_t i = 0; i < num; i++)
+	{
+		if (msgs[i].flags & SW_I2C_M_RD)
+			flags |= SW_I2C_TRACE_F_RD;
+		else if (i > 0 || !(msgs[i].flags & SW_I2C_M_REG))
+			flags |= SW_I2C_TRACE_F_WR;
+		else
+			continue;
+		len += msgs[i].len;
+	}
+
+	r->seq = 0;
+	SW_I2C_TRACE_BARRIER();
+	r->stamp = stamp;
+	r->duration = duration;
+	r->bus = d->trace_bus;
+	r->IICID = msgs[0].IICID;
+	r->status = st;
+	r->len = len;
+	r->reg = 0;
+	if ((msgs[0].flags & SW_I2C_M_REG) && (msgs[0].len == 1 || msgs[0].len == 2))
+	{
+		flags |= SW_I2C_TRACE_F_REG;
+		r->reg = msgs[0].buf[0];
+		if (msgs[0].len == 2)
+		{
+			flags |= SW_I2C_TRACE_F_REG16;
+			r->reg = (r->reg << 8) | msgs[0].buf[1];
+		}
+	}
+	r->flags = flags;
+	r->wire = d->trace_wire;
+	r->ack = d->trace_ack;
+	r->start = d->trace_start;
+	r->reserved = 0;
+	memcpy(r->bytes, d->trace_bytes, SW_I2C_TRACE_BYTES);
+	SW_I2C_TRACE_BARRIER();
+	r->seq = idx + 1;
+}
+
+/**
+ * @brief Take the oldest unread records, from one task at a time.
+ *
+ * Records overwritten before they could be read are counted in t->lost.
+ *
+ * @param[in] t Ring.
+ * @param[out] out Receives up to max records, oldest first.
+ * @param[in] max Room in out.
+ * @return Number of records copied.
+ */
+uint32_t SW_I2C_Trace_Read(sw_i2c_trace_t *t, sw_i2c_trace_rec_t *out, uint32_t max)
+{
+	uint32_t n = 0, head, seq;
+	sw_i2c_trace_rec_t *r;
+
+	if (t == NULL || out == NULL)
+		return 0;
+	while (n < max)
+	{
+		head = t->head;
+		if (head == t->tail)
+			break;
+		if (head - t->tail > t->cnt)
+		{
+			t->lost += head - t->tail - t->cnt;
+			t->tail = head - t->cnt;
+		}
+
+		r = &t->rec[t->tail & (t->cnt - 1)];
+		seq = r->seq;
+		if (seq == 0)
+			break;                      // its writer is still busy
+		if (seq == t->tail + 1)
+		{
+			SW_I2C_TRACE_BARRIER();
+			out[n] = *r;
+			SW_I2C_TRACE_BARRIER();
+			if (r->seq == seq)
+			{
+				n++;
+				t->tail++;
+				continue;
+			}
+		}
+		t->lost++;                      // a newer claim took the slot
+		t->tail++;
+	}
+	return n;
+}
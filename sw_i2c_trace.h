@@ -0,0 +1,61 @@
+#ifndef _SW_I2C_TRACE_H_
+#define _SW_I2C_TRACE_H_
+
+#include "sw_i2c.h"
+
+/* sw_i2c_trace_rec_t.flags */
+#define SW_I2C_TRACE_F_WR       0x01    // has a write segment
+#define SW_I2C_TRACE_F_RD       0x02    // has a read segment
+#define SW_I2C_TRACE_F_REG      0x04    // reg is valid
+#define SW_I2C_TRACE_F_REG16    0x08    // reg is two bytes wide
+
+/* Orders the record stores against the seq publish */
+#ifndef SW_I2C_TRACE_BARRIER
+#define SW_I2C_TRACE_BARRIER()  __sync_synchronize()
+#endif
+
+/**
+ * One transaction, 32 bytes, little-endian as stored by the MCU. The first
+ * SW_I2C_TRACE_BYTES bytes of the wire are kept verbatim, address bytes
+ * included, with the ACK bit that followed each one and whether a (repeated)
+ * START preceded it. Times are in hal_cycles units.
+ */
+typedef struct
+{
+    uint32_t seq;                   // claim number + 1, 0 while being written
+    uint32_t stamp;                 // START
+    uint32_t duration;              // START to STOP
+    uint8_t bus;                    // sw_i2c_t.trace_bus
+    uint8_t IICID;                  // 8-bit address of the first segment
+    uint8_t flags;                  // SW_I2C_TRACE_F_*
+    uint8_t status;                 // sw_i2c_status_e
+    uint16_t len;                   // payload bytes of all segments, address bytes excluded
+    uint16_t reg;                   // register address when SW_I2C_TRACE_F_REG
+    uint8_t wire;                   // bytes clocked, saturates at 255
+    uint8_t ack;                    // bit i: byte i was ACKed (by the target on writes, by us on reads)
+    uint8_t start;                  // bit i: byte i follows a START
+    uint8_t reserved;
+    uint8_t bytes[SW_I2C_TRACE_BYTES];
+} sw_i2c_trace_rec_t;
+
+/**
+ * Flight recorder shared by any number of buses. Writers never block: a
+ * slot is claimed with one atomic add and the oldest records are
+ * overwritten when the reader falls behind.
+ */
+typedef struct sw_i2c_trace_s
+{
+    sw_i2c_trace_rec_t * rec;
+    uint32_t cnt;                   // slots, power of two
+    volatile uint32_t head;         // slots claimed so far
+    uint32_t tail;                  // next claim SW_I2C_Trace_Read returns
+    uint32_t lost;                  // records overwritten before they were read
+} sw_i2c_trace_t;
+
+sw_i2c_status_e SW_I2C_Trace_Init(sw_i2c_trace_t *t, sw_i2c_trace_rec_t *rec, uint32_t cnt);
+void SW_I2C_Trace_Attach(sw_i2c_t *d, sw_i2c_trace_t *t, uint8_t bus);
+void SW_I2C_Trace_Record(sw_i2c_trace_t *t, const sw_i2c_t *d, const sw_i2c_msg_t *msgs, uint32_t num,
+                         sw_i2c_status_e st, uint32_t stamp, uint32_t duration);
+uint32_t SW_I2C_Trace_Read(sw_i2c_trace_t *t, sw_i2c_trace_rec_t *out, uint32_t max);
+
+#endif /* _SW_I2C_TRACE_H_ */
@@ -0,0 +1,354 @@
+/***
+ * Waveform engine for the soft I2C core: a transaction is compiled into one
+ * GPIO set/reset word per tick (a quarter bit), played back by hardware
+ * (timer-triggered DMA, see sw_i2c_port_at32_wave.c) or by the CPU, and the
+ * sampled input words are decoded into read data and ACK status afterwards.
+ *
+ * The program is fixed once compiled, so a NACK does not abort the wire
+ * sequence (it still ends with STOP) and clock stretching cannot be honoured;
+ * both are reported by the decoder.
+ */
+
+#include "sw_i2c_wave.h"
+#include "sw_i2c_phase.h"
+
+#ifndef TRUE
+	#define TRUE 1
+#endif
+#ifndef FALSE
+	#define FALSE 0
+#endif
+
+#define WAVE_SET(mask)      (mask)
+#define WAVE_RESET(mask)    ((mask) << 16)
+
+/**
+ * One pass over the messages. Compiling fills out[]; decoding reads in[] at
+ * the same tick positions, so both share the walk.
+ */
+typedef struct
+{
+    uint32_t * out;         // NULL while decoding
+    const uint32_t * in;    // NULL while compiling
+    uint32_t cap;
+    uint32_t tick;
+    uint32_t scl;
+    uint32_t sda;
+    uint8_t su_sta, hd_sta, su_sto, buf;
+    uint8_t stretched;
+    uint8_t overrun;        // decoding went past the played ticks
+} wave_walk_t;
+
+static void wave_emit(wave_walk_t *k, uint32_t word)
+{
+    if (k->out && k->tick < k->cap)
+        k->out[k->tick] = word;
+    k->tick++;
+}
+
+/* SCL low, SDA to the bit, SCL high, hold; SDA is sampled in the hold tick */
+static uint8_t wave_bit(wave_walk_t *k, uint8_t bit)
+{
+    uint32_t t;
+
+    wave_emit(k, WAVE_RESET(k->scl));
+    wave_emit(k, bit ? WAVE_SET(k->sda) : WAVE_RESET(k->sda));
+    wave_emit(k, WAVE_SET(k->scl));
+    t = k->tick;
+    wave_emit(k, 0);
+    if (k->in == NULL)
+        return 0;
+    if (t >= k->cap)
+    {
+        k->overrun = TRUE;
+        return 1;                       // reads as a NACK, which ends the walk
+    }
+    if (!(k->in[t] & k->scl))
+        k->stretched = TRUE;
+    return (k->in[t] & k->sda) ? 1 : 0;
+}
+
+/* An edge held for 'ticks' ticks */
+static void wave_hold(wave_walk_t *k, uint32_t word, uint8_t ticks)
+{
+    wave_emit(k, word);
+    while (--ticks)
+        wave_emit(k, 0);
+}
+
+/* (repeated) START: works from idle and from SCL high after an ACK bit */
+static void wave_start(wave_walk_t *k)
+{
+    wave_emit(k, WAVE_RESET(k->scl));
+    wave_emit(k, WAVE_SET(k->sda));
+    wave_hold(k, WAVE_SET(k->scl), k->su_sta);
+    wave_hold(k, WAVE_RESET(k->sda), k->hd_sta);
+}
+
+/* Ends with tBUF, so the next transaction may start right after playback */
+static void wave_stop(wave_walk_t *k)
+{
+    wave_emit(k, WAVE_RESET(k->scl));
+    wave_emit(k, WAVE_RESET(k->sda));
+    wave_hold(k, WAVE_SET(k->scl), k->su_sto);
+    wave_hold(k, WAVE_SET(k->sda), k->buf);
+}
+
+/* Whole ticks covering ns, at least one */
+static uint8_t wave_ticks(uint32_t ns, uint32_t tick_ns)
+{
+    uint32_t n = (ns + tick_ns - 1) / tick_ns;
+
+    return n ? (uint8_t)n : 1;
+}
+
+/* Returns TRUE if the byte was ACKed; always TRUE while compiling */
+static uint8_t wave_write_byte(wave_walk_t *k, uint8_t data)
+{
+    for (int x = 7; x >= 0; x--)
+        wave_bit(k, (data >> x) & 1);
+    return wave_bit(k, 1) == 0;
+}
+
+static uint8_t wave_read_byte(wave_walk_t *k, uint8_t ack)
+{
+    uint8_t data = 0;
+
+    for (int x = 0; x < 8; x++)
+        data = (data << 1) | wave_bit(k, 1);
+    wave_bit(k, ack ? 0 : 1);
+    return data;
+}
+
+/**
+ * Same segment rules as SW_I2C_Transfer, stops decoding at the first NACK.
+ * Decoding never reads past cap: segments longer than the compiled ones
+ * give SW_I2C_ERR_PARAM.
+ */
+static sw_i2c_status_e wave_walk(wave_walk_t *k, const sw_i2c_msg_t *msgs, uint32_t num, size_t *nack_index)
+{
+    sw_i2c_status_e st = SW_I2C_OK;
+
+    for (uint32_t i = 0; i < num && st == SW_I2C_OK; i++)
+    {
+        const sw_i2c_msg_t *m = &msgs[i];
+
+        if (i == 0 || !(m->flags & SW_I2C_M_NOSTART))
+        {
+            uint8_t addr = (m->flags & SW_I2C_M_RD) ? (m->IICID | I2C_READ) : (m->IICID & ~I2C_READ);
+
+            wave_start(k);
+            if (!wave_write_byte(k, addr))
+            {
+                st = SW_I2C_ERR_ADDR_NACK;
+                break;
+            }
+        }
+        for (size_t j = 0; j < m->len; j++)
+        {
+            if (m->flags & SW_I2C_M_RD)
+            {
+                uint8_t data = wave_read_byte(k, j + 1 < m->len);
+                if (k->in && !k->overrun)
+                    m->buf[j] = data;
+            }
+            else if (!wave_write_byte(k, m->buf[j]))
+            {
+                if (nack_index)
+                    *nack_index = j;
+                st = (m->flags & SW_I2C_M_REG) ? SW_I2C_ERR_REG_NACK : SW_I2C_ERR_DATA_NACK;
+                break;
+            }
+        }
+    }
+    if (k->overrun)
+        return SW_I2C_ERR_PARAM;
+    if (k->stretched)
+        return SW_I2C_ERR_STRETCH_TIMEOUT;
+    if (k->in == NULL)
+        wave_stop(k);
+    return st;
+}
+
+static sw_i2c_status_e wave_check_msgs(const sw_i2c_msg_t *msgs, uint32_t num)
+{
+    if (msgs == NULL || num == 0)
+        return SW_I2C_ERR_PARAM;
+    for (uint32_t i = 0; i < num; i++)
+    {
+        if (msgs[i].len != 0 && msgs[i].buf == NULL)
+            return SW_I2C_ERR_PARAM;
+        if (msgs[i].flags & (SW_I2C_M_RECV_LEN | SW_I2C_M_PEC))
+            return SW_I2C_ERR_PARAM;    // the waveform is fixed before any byte is read
+        if ((msgs[i].flags & SW_I2C_M_RD) && (msgs[i].len == 0 || (msgs[i].flags & SW_I2C_M_NOSTART)))
+            return SW_I2C_ERR_PARAM;
+    }
+    return SW_I2C_OK;
+}
+
+/**
+ * @brief Compile a transaction into a waveform.
+ *
+ * Write data is taken now; read buffers are filled by SW_I2C_Wave_Decode.
+ * Size the buffers with SW_I2C_WAVE_TICKS.
+ *
+ * @param[out] w Waveform with out/in/cap set by the caller.
+ * @param[in] d Bus with SW_I2C_FLAG_OPEN_DRAIN and the register fast path,
+ *            SCL and SDA on one port.
+ * @param[in] msgs Array of segments, as for SW_I2C_Transfer.
+ * @param[in] num Number of segments.
+ * @return SW_I2C_OK or SW_I2C_ERR_PARAM if the buffers are too small.
+ */
+sw_i2c_status_e SW_I2C_Wave_Compile(sw_i2c_wave_t *w, const sw_i2c_t *d, const sw_i2c_msg_t *msgs, uint32_t num)
+{
+	wave_walk_t k = {0};
+	sw_i2c_timing_t tm;
+	uint32_t tick_ns;
+
+	if (w == NULL || d == NULL || w->out == NULL)
+		return SW_I2C_ERR_PARAM;
+	if (d->fast.scl_set == NULL || d->fast.scl_set != d->fast.sda_set)
+		return SW_I2C_ERR_PARAM;
+	if (!(d->flags & SW_I2C_FLAG_OPEN_DRAIN))
+		return SW_I2C_ERR_PARAM;
+	if (wave_check_msgs(msgs, num) != SW_I2C_OK)
+		return SW_I2C_ERR_PARAM;
+
+	/* two ticks cover the longer of tLOW and tHIGH, the conditions whole ticks */
+	tm = sw_i2c_spec_timing(SW_I2C_Target_Clock(d, msgs[0].IICID), d->rise_ns);
+	tick_ns = ((tm.low_ns > tm.high_ns ? tm.low_ns : tm.high_ns) + 1) / 2;
+	k.su_sta = wave_ticks(tm.su_sta_ns, tick_ns);
+	k.hd_sta = wave_ticks(tm.hd_sta_ns, tick_ns);
+	k.su_sto = wave_ticks(tm.su_sto_ns, tick_ns);
+	k.buf = wave_ticks(tm.buf_ns, tick_ns);
+
+	k.out = w->out;
+	k.cap = w->cap;
+	k.scl = d->fast.scl_mask;
+	k.sda = d->fast.sda_mask;
+	wave_walk(&k, msgs, num, NULL);
+	if (k.tick > w->cap)
+		return SW_I2C_ERR_PARAM;
+
+	w->len = k.tick;
+	w->tick_ns = tick_ns;
+	w->scl_mask = k.scl;
+	w->sda_mask = k.sda;
+	w->su_sta = k.su_sta;
+	w->hd_sta = k.hd_sta;
+	w->su_sto = k.su_sto;
+	w->buf = k.buf;
+	return SW_I2C_OK;
+}
+
+/**
+ * @brief Extract read data and ACK status from a played waveform.
+ *
+ * @param[in] w Waveform whose in[] was filled by playback.
+ * @param[in,out] msgs The segments it was compiled from.
+ * @param[in] num Number of segments.
+ * @param[out] nack_index Byte index of a data NACK, may be NULL.
+ * @return SW_I2C_OK, the first NACK, SW_I2C_ERR_STRETCH_TIMEOUT if a
+ *         target held SCL low at a sample point, or SW_I2C_ERR_PARAM if
+ *         msgs need more ticks than w played.
+ */
+sw_i2c_status_e SW_I2C_Wave_Decode(const sw_i2c_wave_t *w, sw_i2c_msg_t *msgs, uint32_t num, size_t *nack_index)
+{
+	wave_walk_t k = {0};
+
+	if (w == NULL || w->in == NULL || wave_check_msgs(msgs, num) != SW_I2C_OK)
+		return SW_I2C_ERR_PARAM;
+
+	k.in = w->in;
+	k.cap = w->len;
+	k.scl = w->scl_mask;
+	k.sda = w->sda_mask;
+	k.su_sta = w->su_sta;
+	k.hd_sta = w->hd_sta;
+	k.su_sto = w->su_sto;
+	k.buf = w->buf;
+	return wave_walk(&k, msgs, num, nack_index);
+}
+
+/**
+ * @brief Play a waveform with the CPU.
+ *
+ * Reference player for ports without timer/DMA glue and for the host
+ * simulator: writes each word to the set/reset register, waits one tick and
+ * samples the input register.
+ */
+sw_i2c_status_e SW_I2C_Wave_Play(sw_i2c_t *d, sw_i2c_wave_t *w)
+{
+	uint32_t tick;
+
+	if (d == NULL || w == NULL || w->in == NULL)
+		return SW_I2C_ERR_PARAM;
+	tick = w->tick_ns > d->wait_trim_ns ? w->tick_ns - d->wait_trim_ns : 0;
+
+	for (uint32_t i = 0; i < w->len; i++)
+	{
+		if (w->out[i])
+			SW_I2C_REG_WRITE(d->fast.scl_set, w->out[i]);
+		if (tick && d->hal_delay_ns)
+			d->hal_delay_ns(tick);
+		else if (tick)
+			d->hal_delay_us((tick + 999) / 1000);
+		w->in[i] = SW_I2C_REG_READ(d->fast.sda_in);
+	}
+	return SW_I2C_OK;
+}
+
+/**
+ * @brief Play and decode a compiled waveform under the bus lock.
+ *
+ * The waveform can be executed any number of times; read data lands in the
+ * buffers of msgs on every run.
+ *
+ * @param[in] d Pointer to the I2C instance, pins in open-drain output mode.
+ * @param[in] w Waveform compiled from msgs.
+ * @param[in,out] msgs Array of segments.
+ * @param[in] num Number of segments.
+ * @param[in] run Player, e.g. the port's DMA engine; NULL for SW_I2C_Wave_Play.
+ * @return SW_I2C_OK or the reason of the failure, also kept for SW_I2C_Last_Status.
+ */
+sw_i2c_status_e SW_I2C_Wave_Execute(sw_i2c_t *d, sw_i2c_wave_t *w, sw_i2c_msg_t *msgs, uint32_t num, sw_i2c_wave_run_t run)
+{
+	sw_i2c_status_e st;
+
+	if (d == NULL || w == NULL || w->len == 0)
+		return SW_I2C_ERR_PARAM;
+
+	st = SW_I2C_Lock(d);
+	if (st != SW_I2C_OK)
+		return st;
+	d->nack_index = 0;
+	if (!(SW_I2C_REG_READ(d->fast.scl_in) & d->fast.scl_mask) || !(SW_I2C_REG_READ(d->fast.sda_in) & d->fast.sda_mask))
+		st = SW_I2C_ERR_BUS_BUSY;
+	else
+		st = run ? run(d, w) : SW_I2C_Wave_Play(d, w);
+	if (st == SW_I2C_OK)
+		st = SW_I2C_Wave_Decode(w, msgs, num, &d->nack_index);
+	d->status = st;
+	SW_I2C_Unlock(d);
+	return st;
+}
+
+/**
+ * @brief Compile, play and decode a transaction under the bus lock.
+ *
+ * @param[in] d Pointer to the I2C instance, pins in open-drain output mode.
+ * @param[in] w Waveform buffers.
+ * @param[in,out] msgs Array of segments.
+ * @param[in] num Number of segments.
+ * @param[in] run Player, e.g. the port's DMA engine; NULL for SW_I2C_Wave_Play.
+ * @return SW_I2C_OK or the reason of the failure, also kept for SW_I2C_Last_Status.
+ */
+sw_i2c_status_e SW_I2C_Wave_Transfer(sw_i2c_t *d, sw_i2c_wave_t *w, sw_i2c_msg_t *msgs, uint32_t num, sw_i2c_wave_run_t run)
+{
+	sw_i2c_status_e st;
+
+	st = SW_I2C_Wave_Compile(w, d, msgs, num);
+	if (st != SW_I2C_OK)
+		return st;
+	return SW_I2C_Wave_Execute(d, w, msgs, num, run);
+}
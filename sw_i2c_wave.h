@@ -0,0 +1,61 @@
+#ifndef _SW_I2C_WAVE_H_
+#define _SW_I2C_WAVE_H_
+
+#include "sw_i2c.h"
+
+/**
+ * Every bit is four equal ticks, SCL low for two and high for two. The tick
+ * is as long as the spec's tLOW and tHIGH (plus rise time) of the clock
+ * need, so a bit meets both and the clock runs at or below the nominal rate
+ * (400 kHz plays at about 345 kHz, 1 MHz at about 890 kHz). START and STOP
+ * hold their edges for as many ticks as tSU;STA, tHD;STA, tSU;STO and tBUF
+ * need, at most SW_I2C_WAVE_COND_TICKS. The compiled program is one
+ * set/reset word per tick for the port's bit set/reset register
+ * (fast.scl_set), so SCL and SDA must share a port.
+ */
+#define SW_I2C_WAVE_TICKS_PER_BIT   4
+#define SW_I2C_WAVE_COND_TICKS      8
+
+/* Ticks for a transaction of 'bytes' payload bytes in 'segments' segments */
+#define SW_I2C_WAVE_TICKS(bytes, segments) \
+    (SW_I2C_WAVE_TICKS_PER_BIT * ((bytes) + (segments)) * 9 + SW_I2C_WAVE_COND_TICKS * ((segments) + 1))
+
+/**
+ * Transaction compiled to a waveform. Buffers belong to the caller; in[i]
+ * receives the port input register sampled at the end of tick i.
+ */
+typedef struct
+{
+    uint32_t * out;         // set/reset word per tick, 0 = no change
+    uint32_t * in;          // sampled input register per tick
+    uint32_t cap;           // ticks both buffers hold
+    uint32_t len;           // ticks of the compiled transaction
+    uint32_t tick_ns;       // quarter bit
+    uint32_t scl_mask;
+    uint32_t sda_mask;
+    uint8_t su_sta, hd_sta; // ticks of the START waits
+    uint8_t su_sto, buf;    // ticks of the STOP waits
+} sw_i2c_wave_t;
+
+/** Plays a compiled waveform on the bus and returns when it is done */
+typedef sw_i2c_status_e (*sw_i2c_wave_run_t)(sw_i2c_t *d, sw_i2c_wave_t *w);
+
+sw_i2c_status_e SW_I2C_Wave_Compile(sw_i2c_wave_t *w, const sw_i2c_t *d, const sw_i2c_msg_t *msgs, uint32_t num);
+sw_i2c_status_e SW_I2C_Wave_Decode(const sw_i2c_wave_t *w, sw_i2c_msg_t *msgs, uint32_t num, size_t *nack_index);
+sw_i2c_status_e SW_I2C_Wave_Play(sw_i2c_t *d, sw_i2c_wave_t *w);
+sw_i2c_status_e SW_I2C_Wave_Execute(sw_i2c_t *d, sw_i2c_wave_t *w, sw_i2c_msg_t *msgs, uint32_t num, sw_i2c_wave_run_t run);
+sw_i2c_status_e SW_I2C_Wave_Transfer(sw_i2c_t *d, sw_i2c_wave_t *w, sw_i2c_msg_t *msgs, uint32_t num, sw_i2c_wave_run_t run);
+
+/**
+ * Timer + DMA players put word i on the port at the start of tick i and
+ * sample in[i] on the timer clock given here (of 'period' per tick), the
+ * last one before word i + 1: every sample sees its word for a full tick,
+ * as with SW_I2C_Wave_Play.
+ */
+#define SW_I2C_WAVE_SAMPLE_CLK(period)  ((period) - 1)
+
+/* Timer + DMA player, sw_i2c_port_at32_wave.c */
+void SW_I2C_AT32_Wave_Init(void);
+sw_i2c_status_e SW_I2C_AT32_Wave_Run(sw_i2c_t *d, sw_i2c_wave_t *w);
+
+#endif /* _SW_I2C_WAVE_H_ */